@@ -2,6 +2,7 @@
 #include <sstream>
 #include <benchmark/benchmark.h>
 #include "benchmarks/utilities.h"
+#include "purify/NodeAwareReduction.h"
 #include "purify/directories.h"
 #include "purify/operators.h"
 #include "purify/pfitsio.h"
@@ -261,6 +262,45 @@ BENCHMARK_DEFINE_F(DegridOperatorAdjointFixtureMPI, Apply)(benchmark::State &sta
                           sizeof(t_complex));
 }
 
+// ----------------- Reduction of the image benchmarks -----------------------//
+
+class AllSumAllFixturePar : public ::benchmark::Fixture {
+ public:
+  void SetUp(const ::benchmark::State &state) {
+    m_image = Vector<t_complex>::Random(state.range(0) * state.range(0));
+    if (not m_reduction) m_reduction = std::make_shared<const NodeAwareReduction>(m_world, true);
+  }
+
+  void TearDown(const ::benchmark::State &state) {}
+
+  sopt::mpi::Communicator m_world;
+  Vector<t_complex> m_image;
+  std::shared_ptr<const NodeAwareReduction> m_reduction;
+};
+
+BENCHMARK_DEFINE_F(AllSumAllFixturePar, Flat)(benchmark::State &state) {
+  // Benchmark the sum of the image over all ranks with a single all reduce
+  while (state.KeepRunning()) {
+    auto start = std::chrono::high_resolution_clock::now();
+    m_image = m_world.all_sum_all<Vector<t_complex>>(m_image);
+    auto end = std::chrono::high_resolution_clock::now();
+    state.SetIterationTime(b_utilities::duration(start, end, m_world));
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * m_image.size() * sizeof(t_complex));
+}
+
+BENCHMARK_DEFINE_F(AllSumAllFixturePar, NodeAware)(benchmark::State &state) {
+  // Benchmark the sum of the image through shared memory and the node leaders
+  state.counters["nodes"] = m_reduction->nodes();
+  while (state.KeepRunning()) {
+    auto start = std::chrono::high_resolution_clock::now();
+    m_image = m_reduction->all_sum_all(m_image);
+    auto end = std::chrono::high_resolution_clock::now();
+    state.SetIterationTime(b_utilities::duration(start, end, m_world));
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * m_image.size() * sizeof(t_complex));
+}
+
 // -------------- Register benchmarks -------------------------//
 /*
 BENCHMARK_REGISTER_F(DegridOperatorCtorFixturePar, Distr)
@@ -332,3 +372,20 @@ BENCHMARK_REGISTER_F(DegridOperatorAdjointFixtureMPI, Apply)
     ->Repetitions(10)
     //->ReportAggregatesOnly(true)
     ->Unit(benchmark::kMillisecond);
+
+// run with 1 to 64 compute nodes to compare the reductions as the number of nodes grows
+BENCHMARK_REGISTER_F(AllSumAllFixturePar, Flat)
+    ->Args({256})
+    ->Args({1024})
+    ->Args({4096})
+    ->UseManualTime()
+    ->Repetitions(10)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_REGISTER_F(AllSumAllFixturePar, NodeAware)
+    ->Args({256})
+    ->Args({1024})
+    ->Args({4096})
+    ->UseManualTime()
+    ->Repetitions(10)
+    ->Unit(benchmark::kMillisecond);
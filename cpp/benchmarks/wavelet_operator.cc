@@ -2,6 +2,9 @@
 #include <benchmark/benchmark.h>
 #include "benchmarks/utilities.h"
 #include "purify/wavelet_operator_factory.h"
+#ifdef PURIFY_OPENMP
+#include <omp.h>
+#endif
 
 using namespace purify;
 
@@ -132,4 +135,61 @@ BENCHMARK_REGISTER_F(WaveletOperatorAdjointFixture, Apply)
     ->ReportAggregatesOnly(true)
     ->Unit(benchmark::kMillisecond);
 
+// ----------------- OpenMP thread scaling -----------------------//
+
+#ifdef PURIFY_OPENMP
+// range(0) is the image size and range(1) the number of threads
+void openmp_wavelet_operator(benchmark::State& state, const bool adjoint) {
+  t_uint m_imsizex = state.range(0);
+  t_uint m_imsizey = state.range(0);
+  const std::vector<std::tuple<std::string, t_uint>> m_wavelets{
+      std::make_tuple("Dirac", 3u), std::make_tuple("DB1", 3u), std::make_tuple("DB2", 3u),
+      std::make_tuple("DB3", 3u),   std::make_tuple("DB4", 3u), std::make_tuple("DB5", 3u),
+      std::make_tuple("DB6", 3u),   std::make_tuple("DB7", 3u), std::make_tuple("DB8", 3u)};
+  const t_int threads = omp_get_max_threads();
+  omp_set_num_threads(state.range(1));
+  auto const m_Psi = factory::wavelet_operator_factory<Vector<t_complex>>(
+      factory::distributed_wavelet_operator::openmp_sara, m_wavelets, m_imsizey, m_imsizex);
+
+  Vector<t_complex> temp;
+  Vector<t_complex> const x = Vector<t_complex>::Random(
+      (adjoint ? 1 : m_wavelets.size()) * m_imsizex * m_imsizey);
+
+  while (state.KeepRunning()) {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (adjoint)
+      temp = m_Psi->adjoint() * x;
+    else
+      temp = *m_Psi * x;
+    auto end = std::chrono::high_resolution_clock::now();
+    state.SetIterationTime(b_utilities::duration(start, end));
+  }
+  omp_set_num_threads(threads);
+}
+
+void openmp_wavelet_operator_apply(benchmark::State& state) {
+  openmp_wavelet_operator(state, false);
+}
+
+void openmp_wavelet_operator_adjoint(benchmark::State& state) {
+  openmp_wavelet_operator(state, true);
+}
+
+BENCHMARK(openmp_wavelet_operator_apply)
+    ->RangeMultiplier(2)
+    ->Ranges({{1024, 1024 << 2}, {1, 16}})
+    ->UseManualTime()
+    ->Repetitions(10)
+    ->ReportAggregatesOnly(true)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(openmp_wavelet_operator_adjoint)
+    ->RangeMultiplier(2)
+    ->Ranges({{1024, 1024 << 2}, {1, 16}})
+    ->UseManualTime()
+    ->Repetitions(10)
+    ->ReportAggregatesOnly(true)
+    ->Unit(benchmark::kMillisecond);
+#endif
+
 BENCHMARK_MAIN();
@@ -0,0 +1,56 @@
+#include "purify/config.h"
+
+#include "purify/types.h"
+#include <string>
+#include <vector>
+#include "purify/binary_visibilities.h"
+#include "purify/logging.h"
+#include "purify/read_measurements.h"
+using namespace purify;
+
+//! Converts .vis, .uvfits or .ms measurements into one binary visibility file (.bvis)
+int main(int argc, const char **argv) {
+  purify::logging::initialize();
+  purify::logging::set_level("info");
+
+  std::vector<std::string> inputs;
+  std::string output = "";
+  bool w_term = false;
+  stokes pol = stokes::I;
+  // the units of .vis files, which are stored in the header of the binary file
+  utilities::vis_units units = utilities::vis_units::lambda;
+  for (t_int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--w_term")
+      w_term = true;
+    else if (arg == "--stokes" and i + 1 < argc)
+      pol = stokes_string.at(argv[++i]);
+    else if (arg == "--units" and i + 1 < argc) {
+      const std::string units_string = argv[++i];
+      if (units_string == "lambda")
+        units = utilities::vis_units::lambda;
+      else if (units_string == "radians")
+        units = utilities::vis_units::radians;
+      else if (units_string == "pixels")
+        units = utilities::vis_units::pixels;
+      else {
+        PURIFY_HIGH_LOG("Visibility units \"{}\" not recognised.", units_string);
+        return 1;
+      }
+    } else if (arg == "-o" and i + 1 < argc)
+      output = argv[++i];
+    else
+      inputs.push_back(arg);
+  }
+  if (inputs.size() == 0 or output == "") {
+    PURIFY_HIGH_LOG(
+        "Usage: {} -o output.bvis [--w_term] [--stokes I] [--units lambda|radians|pixels] "
+        "measurements.(vis|uvfits|ms) ...",
+        argv[0]);
+    return 1;
+  }
+  const auto measurements = read_measurements::read_measurements(inputs, w_term, pol, units);
+  utilities::write_binary_visibility(measurements, output);
+  PURIFY_HIGH_LOG("Wrote {} visibilities to {}", measurements.size(), output);
+  return 0;
+}
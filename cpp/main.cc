@@ -5,11 +5,14 @@
 #include <cstddef>
 #include <ctime>
 #include <random>
+#include "purify/NodeAwareReduction.h"
 #include "purify/algorithm_factory.h"
 #include "purify/cimg.h"
+#include "purify/load_balancing.h"
 #include "purify/logging.h"
 #include "purify/measurement_operator_factory.h"
 #include "purify/pfitsio.h"
+#include "purify/psf_operator.h"
 #include "purify/read_measurements.h"
 #include "purify/update_factory.h"
 #include "purify/wavelet_operator_factory.h"
@@ -42,10 +45,23 @@ int main(int argc, const char **argv) {
         " but the configuration file expects version " + params.version() +
         ". Please updated the config version manually to be compatable with the new version.");
 
+  if (params.hermitian_fold() and not params.realValueConstraint())
+    throw std::runtime_error(
+        "Folding the measurements onto the Hermitian half plane requires realValueConstraint.");
+
   factory::distributed_measurement_operator mop_algo =
       (not params.gpu()) ? factory::distributed_measurement_operator::serial
                          : factory::distributed_measurement_operator::gpu_serial;
-  factory::distributed_wavelet_operator wop_algo = factory::distributed_wavelet_operator::serial;
+  factory::distributed_wavelet_operator serial_wop_algo =
+      factory::distributed_wavelet_operator::serial;
+  if (params.openmp_wavelets()) {
+#ifdef PURIFY_OPENMP
+    serial_wop_algo = factory::distributed_wavelet_operator::openmp_sara;
+#else
+    throw std::runtime_error("Compile with OpenMP if you want to use OpenMP wavelets.");
+#endif
+  }
+  factory::distributed_wavelet_operator wop_algo = serial_wop_algo;
   bool using_mpi = false;
   std::vector<t_int> image_index = std::vector<t_int>();
   std::vector<t_real> w_stacks = std::vector<t_real>();
@@ -67,12 +83,26 @@ int main(int argc, const char **argv) {
       mop_algo = (not params.gpu())
                      ? factory::distributed_measurement_operator::mpi_distribute_all_to_all
                      : factory::distributed_measurement_operator::gpu_mpi_distribute_all_to_all;
+    if (params.mpi_grid_slabs()) {
+      if (params.gpu() or params.mpi_all_to_all())
+        throw std::runtime_error(
+            "Distributing the FFT grid in slabs can not be combined with gpu or mpi_all_to_all.");
+      mop_algo = factory::distributed_measurement_operator::mpi_distribute_grid_slabs;
+    }
+    if (params.mpi_shared_memory()) {
+      if (params.gpu() or params.mpi_all_to_all() or params.mpi_grid_slabs())
+        throw std::runtime_error(
+            "Sharing the FFT grid in node memory can not be combined with gpu, mpi_all_to_all or "
+            "mpi_grid_slabs.");
+      mop_algo = factory::distributed_measurement_operator::mpi_distribute_shared_memory;
+    }
     wop_algo = factory::distributed_wavelet_operator::mpi_sara;
     if (params.mpiAlgorithm() == factory::algo_distribution::mpi_random_updates) {
       mop_algo = (not params.gpu()) ? factory::distributed_measurement_operator::serial
                                     : factory::distributed_measurement_operator::serial;
-      wop_algo = factory::distributed_wavelet_operator::serial;
+      wop_algo = serial_wop_algo;
     }
+    NodeAwareReduction::shared_memory_default(params.mpi_node_reduction());
     using_mpi = true;
   }
 
@@ -101,6 +131,21 @@ int main(int argc, const char **argv) {
     measurement_op_eigen_vector.real() = temp_real;
     measurement_op_eigen_vector.imag() = temp_imag;
   }
+#ifdef PURIFY_MPI
+  std::function<Vector<t_real>(const utilities::vis_params &)> w_cost = nullptr;
+  const auto mpi_plan = distribute::plan_from_string.at(params.mpi_distribution_plan());
+  if (params.wprojection() and not params.mpi_wstacking() and
+      (mpi_plan == distribute::plan::bisection or mpi_plan == distribute::plan::bisection_w)) {
+    // the w-projection kernels grow with w, so cut by kernel coefficients instead of visibilities
+    const t_real du =
+        widefield::pixel_to_lambda(params.cellsizex(), params.width(), params.oversampling());
+    const t_int Jx = params.Jx();
+    const t_int Jw = params.Jw();
+    w_cost = [du, Jx, Jw](const utilities::vis_params &uv) -> Vector<t_real> {
+      return distribute::w_support_cost(uv.w, du, Jx, Jw);
+    };
+  }
+#endif
   if (params.source() == purify::utilities::vis_source::measurements) {
     PURIFY_HIGH_LOG("Input visibilities are from files:");
     for (size_t i = 0; i < params.measurements().size(); i++)
@@ -109,9 +154,9 @@ int main(int argc, const char **argv) {
 #ifdef PURIFY_MPI
     if (using_mpi) {
       auto const world = sopt::mpi::Communicator::World();
-      uv_data = read_measurements::read_measurements(params.measurements(), world,
-                                                     distribute::plan::radial, true, stokes::I,
-                                                     params.measurements_units());
+      uv_data = read_measurements::read_measurements(
+          params.measurements(), world, mpi_plan, true, stokes::I, params.measurements_units(),
+          w_cost);
       const t_real norm =
           std::sqrt(world.all_sum_all(
                         (uv_data.weights.real().array() * uv_data.weights.real().array()).sum()) /
@@ -120,6 +165,13 @@ int main(int argc, const char **argv) {
       uv_data.weights = uv_data.weights / norm;
       // using no weights for now
       // uv_data.weights = Vector<t_complex>::Ones(uv_data.size());
+      // the averaging measures the shift of the uv track in cells, so needs units of lambda
+      if (params.baseline_averaging())
+        uv_data = utilities::baseline_dependent_averaging(
+            utilities::convert_to_lambda(uv_data, params.cellsizex(), params.cellsizey(),
+                                         params.width(), params.height(), params.oversampling()),
+            world, params.cellsizex(), params.cellsizey(), params.width(), params.height(),
+            mpi_plan, params.baseline_averaging_shift(), w_cost);
     } else
 #endif
     {
@@ -131,8 +183,20 @@ int main(int argc, const char **argv) {
       uv_data.weights = uv_data.weights / norm;
       // using no weights for now
       // uv_data.weights = Vector<t_complex>::Ones(uv_data.size());
+      // the averaging measures the shift of the uv track in cells, so needs units of lambda
+      if (params.baseline_averaging())
+        uv_data = utilities::baseline_dependent_averaging(
+            utilities::convert_to_lambda(uv_data, params.cellsizex(), params.cellsizey(),
+                                         params.width(), params.height(), params.oversampling()),
+            params.cellsizex(), params.cellsizey(), params.width(), params.height(),
+            params.baseline_averaging_shift());
     }
-    if (params.conjugate_w()) uv_data = utilities::conjugate_w(uv_data);
+    if (params.hermitian_fold())
+      uv_data = utilities::fold_hermitian(uv_data, params.conjugate_w());
+    else if (params.conjugate_w())
+      uv_data = utilities::conjugate_w(uv_data);
+    if (params.merge_duplicates())
+      uv_data = utilities::merge_duplicates(uv_data, params.merge_tolerance());
 #ifdef PURIFY_MPI
     if (params.mpi_wstacking() and
         (mop_algo == factory::distributed_measurement_operator::mpi_distribute_all_to_all or
@@ -142,11 +206,13 @@ int main(int argc, const char **argv) {
       const t_real du =
           widefield::pixel_to_lambda(params.cellsizex(), params.width(), params.oversampling());
       std::tie(uv_data, image_index, w_stacks) = utilities::w_stacking_with_all_to_all(
-          uv_data, du, params.Jx(), params.Jw(), world, params.kmeans_iters(), 0, cost);
+          uv_data, du, params.Jx(), params.Jw(), world, params.kmeans_iters(), 0, cost, 1e-5,
+          params.kmeans_optimal());
     } else if (params.mpi_wstacking()) {
       auto const world = sopt::mpi::Communicator::World();
       const auto cost = [](t_real x) -> t_real { return std::abs(x * x); };
-      uv_data = utilities::w_stacking(uv_data, world, params.kmeans_iters(), cost);
+      uv_data = utilities::w_stacking(uv_data, world, params.kmeans_iters(), cost, 1e-5,
+                                      params.kmeans_optimal());
     }
 #endif
   } else if (params.source() == purify::utilities::vis_source::simulation) {
@@ -170,16 +236,19 @@ int main(int argc, const char **argv) {
 #ifdef PURIFY_MPI
       if (using_mpi) {
         auto const world = sopt::mpi::Communicator::World();
-        uv_data = read_measurements::read_measurements(params.measurements(), world,
-                                                       distribute::plan::radial, true, stokes::I,
-                                                       params.measurements_units());
+        uv_data = read_measurements::read_measurements(
+            params.measurements(), world, mpi_plan, true, stokes::I, params.measurements_units(),
+            w_cost);
       } else
 #endif
         uv_data = read_measurements::read_measurements(params.measurements(), true, stokes::I,
                                                        params.measurements_units());
       uv_data.weights = Vector<t_complex>::Ones(uv_data.weights.size());
     }
-    if (params.conjugate_w()) uv_data = utilities::conjugate_w(uv_data);
+    if (params.hermitian_fold())
+      uv_data = utilities::fold_hermitian(uv_data, params.conjugate_w());
+    else if (params.conjugate_w())
+      uv_data = utilities::conjugate_w(uv_data);
 #ifdef PURIFY_MPI
     if (params.mpi_wstacking() and
         (mop_algo == factory::distributed_measurement_operator::mpi_distribute_all_to_all or
@@ -189,11 +258,13 @@ int main(int argc, const char **argv) {
       const t_real du =
           widefield::pixel_to_lambda(params.cellsizex(), params.width(), params.oversampling());
       std::tie(uv_data, image_index, w_stacks) = utilities::w_stacking_with_all_to_all(
-          uv_data, du, params.Jx(), params.Jw(), world, params.kmeans_iters(), 0, cost);
+          uv_data, du, params.Jx(), params.Jw(), world, params.kmeans_iters(), 0, cost, 1e-5,
+          params.kmeans_optimal());
     } else if (params.mpi_wstacking()) {
       auto const world = sopt::mpi::Communicator::World();
       const auto cost = [](t_real x) -> t_real { return std::abs(x * x); };
-      uv_data = utilities::w_stacking(uv_data, world, params.kmeans_iters(), cost);
+      uv_data = utilities::w_stacking(uv_data, world, params.kmeans_iters(), cost, 1e-5,
+                                      params.kmeans_optimal());
     }
 #endif
     std::shared_ptr<sopt::LinearTransform<Vector<t_complex>>> sky_measurements;
@@ -218,7 +289,7 @@ int main(int argc, const char **argv) {
                     mop_algo, image_index, w_stacks, uv_data, params.height(), params.width(),
                     params.cellsizey(), params.cellsizex(), params.oversampling(),
                     kernels::kernel_from_string.at(params.kernel()), params.sim_J(), params.sim_J(),
-                    params.mpi_wstacking())
+                    params.mpi_wstacking(), params.mpi_all_to_all_pipelined())
               : factory::all_to_all_measurement_operator_factory<Vector<t_complex>>(
                     mop_algo, image_index, w_stacks, uv_data, params.height(), params.width(),
                     params.cellsizey(), params.cellsizex(), params.oversampling(),
@@ -242,6 +313,34 @@ int main(int argc, const char **argv) {
     ideal_cell_y = widefield::estimate_cell_size(
         comm.all_reduce<t_real>(uv_data.v.cwiseAbs().maxCoeff(), MPI_MAX), params.height(),
         params.oversampling());
+    if (params.load_balancing_iterations() > 0) {
+      if (params.mpi_wstacking() or params.mpi_all_to_all())
+        PURIFY_HIGH_LOG("Load balancing is not used with mpi_wstacking or mpi_all_to_all.");
+      else
+        uv_data = load_balancing::rebalance(
+            uv_data, comm, params.cellsizex(), params.cellsizey(), params.height(),
+            params.width(), params.oversampling(), kernels::kernel_from_string.at(params.kernel()),
+            params.Jy(), params.Jx(), params.load_balancing_iterations(),
+            params.load_balancing_budget(), mpi_plan);
+    }
+    if (params.mpi_grid_footprint()) {
+      // grid cells scattered to and gathered from this node by the measurement operator
+      const auto uv_pixels =
+          utilities::convert_to_pixels(uv_data, params.cellsizex(), params.cellsizey(),
+                                       params.width(), params.height(), params.oversampling());
+      t_int touched_cells, shared_cells;
+      std::tie(touched_cells, shared_cells) = distribute::grid_footprint(
+          uv_pixels.u, uv_pixels.v, comm, std::floor(params.height() * params.oversampling()),
+          std::floor(params.width() * params.oversampling()), params.Jy(), params.Jx());
+      PURIFY_MEDIUM_LOG(
+          "Node {} touches {} grid cells ({} MB per application), {} of them also touched by "
+          "other nodes.",
+          comm.rank(), touched_cells, touched_cells * sizeof(t_complex) / 1e6, shared_cells);
+      const t_int total_cells = comm.all_sum_all(touched_cells);
+      if (comm.is_root())
+        PURIFY_HIGH_LOG("Using the {} distribution plan, all nodes touch {} grid cells in total.",
+                        params.mpi_distribution_plan(), total_cells);
+    }
   }
 #endif
   PURIFY_HIGH_LOG(
@@ -255,8 +354,21 @@ int main(int argc, const char **argv) {
                                                          params.oversampling()));
   // create measurement operator
   std::shared_ptr<sopt::LinearTransform<Vector<t_complex>>> measurements_transform;
-  if (mop_algo != factory::distributed_measurement_operator::mpi_distribute_all_to_all and
-      mop_algo != factory::distributed_measurement_operator::gpu_mpi_distribute_all_to_all)
+  // the PSF, dirty and residual images are calculated with the operator on batches of vectors
+  sopt::OperatorFunction<Matrix<t_complex>> direct_batch, indirect_batch;
+  const bool batched_operator =
+      not params.wprojection() and
+      (mop_algo == factory::distributed_measurement_operator::serial or
+       mop_algo == factory::distributed_measurement_operator::mpi_distribute_image);
+  if (batched_operator)
+    std::tie(measurements_transform, direct_batch, indirect_batch) =
+        factory::batch_measurement_operator_factory<Vector<t_complex>>(
+            mop_algo, uv_data, params.height(), params.width(), params.cellsizey(),
+            params.cellsizex(), params.oversampling(),
+            kernels::kernel_from_string.at(params.kernel()), params.Jy(), params.Jx(),
+            params.mpi_wstacking());
+  else if (mop_algo != factory::distributed_measurement_operator::mpi_distribute_all_to_all and
+           mop_algo != factory::distributed_measurement_operator::gpu_mpi_distribute_all_to_all)
     measurements_transform =
         (not params.wprojection())
             ? factory::measurement_operator_factory<Vector<t_complex>>(
@@ -276,12 +388,15 @@ int main(int argc, const char **argv) {
                   mop_algo, image_index, w_stacks, uv_data, params.height(), params.width(),
                   params.cellsizey(), params.cellsizex(), params.oversampling(),
                   kernels::kernel_from_string.at(params.kernel()), params.Jy(), params.Jx(),
-                  params.mpi_wstacking())
+                  params.mpi_wstacking(), params.mpi_all_to_all_pipelined())
             : factory::all_to_all_measurement_operator_factory<Vector<t_complex>>(
                   mop_algo, image_index, w_stacks, uv_data, params.height(), params.width(),
                   params.cellsizey(), params.cellsizex(), params.oversampling(),
                   kernels::kernel_from_string.at(params.kernel()), params.Jy(), params.Jw(),
                   params.mpi_wstacking(), 1e-6, 1e-6, dde_type::wkernel_radial);
+  if (not batched_operator)
+    std::tie(direct_batch, indirect_batch) =
+        operators::init_batch_from_columns<Vector<t_complex>>(measurements_transform);
   t_real operator_norm = 1.;
 #ifdef PURIFY_MPI
   if (using_mpi) {
@@ -359,7 +474,13 @@ int main(int argc, const char **argv) {
   pfitsio::header_params psf_header = def_header;
   psf_header.fits_name = out_dir + "/psf.fits";
   psf_header.pix_units = "Jy/Pixel";
-  const Vector<t_complex> psf = measurements_transform->adjoint() * (uv_data.weights / flux_scale);
+  // the PSF and the dirty image are gridded together
+  Matrix<t_complex> weights_and_vis(uv_data.size(), 2);
+  weights_and_vis.col(0) = uv_data.weights / flux_scale;
+  weights_and_vis.col(1) = uv_data.vis;
+  Matrix<t_complex> psf_and_dirty;
+  indirect_batch(psf_and_dirty, weights_and_vis);
+  const Vector<t_complex> psf = psf_and_dirty.col(0);
   const Image<t_real> psf_image =
       Image<t_complex>::Map(psf.data(), params.height(), params.width()).real();
   PURIFY_HIGH_LOG(
@@ -394,7 +515,7 @@ int main(int argc, const char **argv) {
   pfitsio::header_params dirty_header = def_header;
   dirty_header.fits_name = out_dir + "/dirty.fits";
   dirty_header.pix_units = "Jy/Beam";
-  const Vector<t_complex> dimage = measurements_transform->adjoint() * uv_data.vis;
+  const Vector<t_complex> dimage = psf_and_dirty.col(1);
   const Image<t_real> dirty_image =
       Image<t_complex>::Map(dimage.data(), params.height(), params.width()).real();
   if (params.mpiAlgorithm() != factory::algo_distribution::serial) {
@@ -417,7 +538,7 @@ int main(int argc, const char **argv) {
   {
     auto const world = sopt::mpi::Communicator::World();
     if (params.mpiAlgorithm() == factory::algo_distribution::mpi_random_updates)
-      sara = sopt::wavelets::distribute_sara(sara, world);
+      sara = load_balancing::distribute_wavelets(sara, params.height(), params.width(), world);
   }
 #endif
   auto const wavelets_transform = factory::wavelet_operator_factory<Vector<t_complex>>(
@@ -436,16 +557,59 @@ int main(int argc, const char **argv) {
             (not params.positiveValueConstraint()),
         params.relVarianceConvergence(), params.dualFBVarianceConvergence(), 50,
         params.epsilonConvergenceScaling(), operator_norm);
+  // forward backward can replace the measurement operator by the normal operator Φ†Φ, where the
+  // measurements become the dirty image
+  std::shared_ptr<sopt::LinearTransform<Vector<t_complex>>> fb_transform = measurements_transform;
+  utilities::vis_params fb_data = uv_data;
+  t_real fb_operator_norm = operator_norm;
+  const bool psf_normal_operator = params.algorithm() == "fb" and params.psf_normal_operator();
+  if (psf_normal_operator) {
+    if (params.wprojection() or params.mpi_wstacking())
+      throw std::runtime_error("The PSF normal operator does not support w-term corrections.");
+    PURIFY_HIGH_LOG("Using the PSF as the normal operator for forward backward.");
+    fb_data.vis = dimage;
+    std::shared_ptr<sopt::LinearTransform<Vector<t_complex>>> normal_operator;
+#ifdef PURIFY_MPI
+    if (using_mpi) {
+      auto const world = sopt::mpi::Communicator::World();
+      normal_operator = measurementoperator::init_psf_normal_operator_2d<Vector<t_complex>>(
+          world, uv_data, params.height(), params.width(), params.cellsizey(),
+          params.cellsizex(), params.oversampling(),
+          kernels::kernel_from_string.at(params.kernel()), params.Jy(), params.Jx());
+      fb_transform = measurementoperator::init_psf_gradient_operator_2d<Vector<t_complex>>(
+          world, normal_operator, params.height(), params.width());
+      if (not world.is_root()) fb_data.vis = Vector<t_complex>::Zero(0);
+    } else
+#endif
+    {
+      normal_operator = measurementoperator::init_psf_normal_operator_2d<Vector<t_complex>>(
+          uv_data, params.height(), params.width(), params.cellsizey(), params.cellsizex(),
+          params.oversampling(), kernels::kernel_from_string.at(params.kernel()), params.Jy(),
+          params.Jx());
+      fb_transform = measurementoperator::init_psf_gradient_operator_2d<Vector<t_complex>>(
+          normal_operator, params.height(), params.width());
+    }
+    // the step size is set from the norm of the operator that is applied, ||Φ†Φ|| = ||Φ||²
+    // the PSF is the same on every node, so the power method needs no communication
+    fb_operator_norm = std::sqrt(std::get<0>(sopt::algorithm::power_method<Vector<t_complex>>(
+        *normal_operator, params.powMethod_iter(), params.powMethod_tolerance(),
+        measurement_op_eigen_vector)));
+    PURIFY_LOW_LOG("Value of operator norm from the PSF is {}", fb_operator_norm);
+    PURIFY_HIGH_LOG(
+        "The l2 term reported during the iterations is the image space residual "
+        "||Phi^T (Phi x - y)||^2, the residuals are calculated from the visibilities at the end.");
+  }
   if (params.algorithm() == "fb")
     fb = factory::fb_factory<sopt::algorithm::ImagingForwardBackward<t_complex>>(
-        params.mpiAlgorithm(), measurements_transform, wavelets_transform, uv_data,
+        params.mpiAlgorithm(), fb_transform, wavelets_transform, fb_data,
         sigma * params.epsilonScaling() / flux_scale,
         params.stepsize() * std::pow(sigma * params.epsilonScaling() / flux_scale, 2),
         params.regularisation_parameter(), params.height(), params.width(), sara_size,
         params.iterations(), params.realValueConstraint(), params.positiveValueConstraint(),
         (params.wavelet_basis().size() < 2) and (not params.realValueConstraint()) and
             (not params.positiveValueConstraint()),
-        params.relVarianceConvergence(), params.dualFBVarianceConvergence(), 50, operator_norm);
+        params.relVarianceConvergence(), params.dualFBVarianceConvergence(), 50,
+        fb_operator_norm);
   if (params.algorithm() == "primaldual")
     primaldual = factory::primaldual_factory<sopt::algorithm::ImagingPrimalDual<t_complex>>(
         params.mpiAlgorithm(), measurements_transform, wavelets_transform, uv_data,
@@ -507,30 +671,38 @@ int main(int argc, const char **argv) {
           : Vector<t_complex>::Zero(params.height() * params.width()).eval();
   const Vector<t_complex> estimate_res =
       (*measurements_transform * estimate_image).eval() - uv_data.vis;
+  const auto residual_image_from = [&](const Vector<t_complex> &residual) -> Image<t_real> {
+    Matrix<t_complex> residual_batch;
+    indirect_batch(residual_batch, residual / beam_units);
+    return Image<t_complex>::Map(residual_batch.data(), params.height(), params.width()).real();
+  };
   if (params.algorithm() == "padmm") {
     // Apply algorithm
     auto const diagnostic = (*padmm)(std::make_tuple(estimate_image.eval(), estimate_res.eval()));
 
     // Save the rest of the output
     image = Image<t_complex>::Map(diagnostic.x.data(), params.height(), params.width()).real();
-    const Vector<t_complex> residuals =
-        measurements_transform->adjoint() * (diagnostic.residual / beam_units);
-    residual_image =
-        Image<t_complex>::Map(residuals.data(), params.height(), params.width()).real();
+    residual_image = residual_image_from(diagnostic.residual);
     purified_header.hasconverged = diagnostic.good;
     purified_header.niters = diagnostic.niters;
   }
   if (params.algorithm() == "fb") {
     // Apply algorithm
-    auto const diagnostic = (*fb)(std::make_tuple(estimate_image.eval(), estimate_res.eval()));
+    const Vector<t_complex> fb_estimate_res =
+        (*fb_transform * estimate_image).eval() - fb_data.vis;
+    auto const diagnostic = (*fb)(std::make_tuple(estimate_image.eval(), fb_estimate_res.eval()));
 
     // Save the rest of the output
     // the clean image
     image = Image<t_complex>::Map(diagnostic.x.data(), params.height(), params.width()).real();
-    const Vector<t_complex> residuals =
-        measurements_transform->adjoint() * (diagnostic.residual / beam_units);
-    residual_image =
-        Image<t_complex>::Map(residuals.data(), params.height(), params.width()).real();
+    // with the PSF normal operator the residual of the algorithm is in image space, so the
+    // visibility residual Φx - y is calculated once here
+    if (psf_normal_operator) {
+      Matrix<t_complex> model_vis;
+      direct_batch(model_vis, diagnostic.x);
+      residual_image = residual_image_from(model_vis.col(0) - uv_data.vis);
+    } else
+      residual_image = residual_image_from(diagnostic.residual);
     purified_header.hasconverged = diagnostic.good;
     purified_header.niters = diagnostic.niters;
   }
@@ -541,10 +713,7 @@ int main(int argc, const char **argv) {
 
     // Save the rest of the output
     image = Image<t_complex>::Map(diagnostic.x.data(), params.height(), params.width()).real();
-    const Vector<t_complex> residuals =
-        measurements_transform->adjoint() * (diagnostic.residual / beam_units);
-    residual_image =
-        Image<t_complex>::Map(residuals.data(), params.height(), params.width()).real();
+    residual_image = residual_image_from(diagnostic.residual);
     purified_header.hasconverged = diagnostic.good;
     purified_header.niters = diagnostic.niters;
   }
@@ -5,8 +5,12 @@
 #ifdef PURIFY_MPI
 #include "purify/types.h"
 #include <numeric>
+#include <vector>
 #include "purify/IndexMapping.h"
+#include "purify/NeighbourhoodExchange.h"
+#include "purify/SharedArray.h"
 #include "sopt/mpi/communicator.h"
+#include "sopt/mpi/types.h"
 namespace purify {
 //! Finds sizes to be recieved from each node for degridding
 //! \param[in] local_indices: indices that will be received by this process
@@ -63,13 +67,20 @@ class AllToAllSparseVector {
   AllToAllSparseVector(const IndexMapping<STORAGE_INDEX_TYPE> &_mapping,
                        const std::vector<t_int> &_send_sizes, const std::vector<t_int> &_recv_sizes,
                        const sopt::mpi::Communicator &_comm)
-      : mapping(_mapping), send_sizes(_send_sizes), recv_sizes(_recv_sizes), comm(_comm) {}
+      : mapping(_mapping),
+        send_sizes(_send_sizes),
+        recv_sizes(_recv_sizes),
+        comm(_comm),
+        pipeline_comm(duplicate(_comm)),
+        neighbourhood(send_sizes, recv_sizes, comm) {}
   AllToAllSparseVector(const IndexMapping<STORAGE_INDEX_TYPE> &_mapping,
                        const std::vector<t_int> &_recv_sizes, const sopt::mpi::Communicator &_comm)
       : mapping(_mapping),
         recv_sizes(_recv_sizes),
         send_sizes(all_to_all_send_sizes(_recv_sizes, _comm)),
-        comm(_comm) {}
+        comm(_comm),
+        pipeline_comm(duplicate(_comm)),
+        neighbourhood(send_sizes, recv_sizes, comm) {}
   AllToAllSparseVector(const std::vector<STORAGE_INDEX_TYPE> &local_indices,
                        const std::vector<t_int> &_recv_sizes, STORAGE_INDEX_TYPE ft_grid_size,
                        const STORAGE_INDEX_TYPE start, const sopt::mpi::Communicator &_comm)
@@ -107,25 +118,129 @@ class AllToAllSparseVector {
   template <class T0, class T1>
   void recv_grid(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &output) const {
     assert(input.cols() == 1);
-    Vector<typename T0::Scalar> buffer;
-    mapping(input, buffer);
-    assert(buffer.size() == std::accumulate(send_sizes.begin(), send_sizes.end(), 0));
+    typedef typename T0::Scalar Scalar;
+    // the grid points are sent straight from the grid
+    Eigen::Ref<const Vector<Scalar>> const grid(input);
     output.const_cast_derived() =
-        comm.all_to_allv<typename T0::Scalar>(buffer, send_sizes, recv_sizes);
+        neighbourhood(grid.data(), mapping.template mpi_types<Scalar>(send_sizes));
   }
 
   template <class T0, class T1>
   void send_grid(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &output) const {
     assert(input.cols() == 1);
-    auto const buffer = comm.all_to_allv<typename T0::Scalar>(input, recv_sizes, send_sizes);
+    auto const buffer = neighbourhood.adjoint(Vector<typename T0::Scalar>(input));
     mapping.adjoint(buffer, output.derived());
   }
 
+  //! Receives the grid from each node and applies `apply(node, block)` to each block on arrival
+  //! \details Blocks are processed in the order they are received, starting with the block held
+  //! by this node, so that the computation overlaps with the communication of the other blocks.
+  template <class T0, class FUNC>
+  void recv_grid_pipelined(Eigen::MatrixBase<T0> const &input, FUNC &&apply) const {
+    typedef typename T0::Scalar Scalar;
+    assert(input.cols() == 1);
+    Vector<Scalar> buffer;
+    mapping(input, buffer);
+    assert(buffer.size() == std::accumulate(send_sizes.begin(), send_sizes.end(), 0));
+    std::vector<t_int> const send_displs = displacements(send_sizes);
+    std::vector<t_int> const recv_displs = displacements(recv_sizes);
+    Vector<Scalar> received(std::accumulate(recv_sizes.begin(), recv_sizes.end(), 0));
+
+    std::vector<MPI_Request> recv_requests;
+    std::vector<t_int> sources;
+    for (t_int node = 0; node < comm.size(); node++) {
+      if (node == static_cast<t_int>(comm.rank()) or recv_sizes[node] == 0) continue;
+      recv_requests.push_back(MPI_REQUEST_NULL);
+      sources.push_back(node);
+      MPI_Irecv(received.data() + recv_displs[node], recv_sizes[node],
+                sopt::mpi::Type<Scalar>::value, node, pipeline_tag, *pipeline_comm,
+                &recv_requests.back());
+    }
+    std::vector<MPI_Request> send_requests;
+    for (t_int node = 0; node < comm.size(); node++) {
+      if (node == static_cast<t_int>(comm.rank()) or send_sizes[node] == 0) continue;
+      send_requests.push_back(MPI_REQUEST_NULL);
+      MPI_Isend(buffer.data() + send_displs[node], send_sizes[node],
+                sopt::mpi::Type<Scalar>::value, node, pipeline_tag, *pipeline_comm,
+                &send_requests.back());
+    }
+
+    if (recv_sizes[comm.rank()] > 0)
+      apply(static_cast<t_int>(comm.rank()),
+            buffer.segment(send_displs[comm.rank()], send_sizes[comm.rank()]));
+    for (std::size_t i = 0; i < recv_requests.size(); i++) {
+      int index;
+      MPI_Waitany(recv_requests.size(), recv_requests.data(), &index, MPI_STATUS_IGNORE);
+      const t_int node = sources[index];
+      apply(node, received.segment(recv_displs[node], recv_sizes[node]));
+    }
+    MPI_Waitall(send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
+  }
+
+  //! Sends the part of the grid calculated by `compute(node)` to each node as soon as it is ready
+  //! \details `compute(node)` returns the contribution of this node to the grid held by `node`,
+  //! i.e. a vector of size `recv_grid_sizes()[node]`. The block for this node is calculated last.
+  template <class T1, class FUNC>
+  void send_grid_pipelined(FUNC &&compute, Eigen::MatrixBase<T1> const &output) const {
+    typedef typename T1::Scalar Scalar;
+    std::vector<t_int> const send_displs = displacements(send_sizes);
+    Vector<Scalar> buffer = Vector<Scalar>::Zero(
+        std::accumulate(send_sizes.begin(), send_sizes.end(), 0));
+
+    std::vector<MPI_Request> recv_requests;
+    for (t_int node = 0; node < comm.size(); node++) {
+      if (node == static_cast<t_int>(comm.rank()) or send_sizes[node] == 0) continue;
+      recv_requests.push_back(MPI_REQUEST_NULL);
+      MPI_Irecv(buffer.data() + send_displs[node], send_sizes[node],
+                sopt::mpi::Type<Scalar>::value, node, pipeline_tag, *pipeline_comm,
+                &recv_requests.back());
+    }
+    // staggered order, so that not all nodes send to the same node at once
+    std::vector<Vector<Scalar>> blocks(comm.size());
+    std::vector<MPI_Request> send_requests;
+    for (t_int shift = 1; shift < comm.size(); shift++) {
+      const t_int node = (comm.rank() + shift) % comm.size();
+      if (recv_sizes[node] == 0) continue;
+      blocks[node] = compute(node);
+      assert(blocks[node].size() == recv_sizes[node]);
+      send_requests.push_back(MPI_REQUEST_NULL);
+      MPI_Isend(blocks[node].data(), recv_sizes[node], sopt::mpi::Type<Scalar>::value, node,
+                pipeline_tag, *pipeline_comm, &send_requests.back());
+    }
+    if (recv_sizes[comm.rank()] > 0)
+      buffer.segment(send_displs[comm.rank()], send_sizes[comm.rank()]) = compute(comm.rank());
+
+    MPI_Waitall(recv_requests.size(), recv_requests.data(), MPI_STATUSES_IGNORE);
+    mapping.adjoint(buffer, output.const_cast_derived());
+    MPI_Waitall(send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
+  }
+
+  //! Number of grid points received from each node
+  std::vector<t_int> const &recv_grid_sizes() const { return recv_sizes; }
+
  private:
+  //! Tag for the point to point messages of the pipelined exchange, which are sent on
+  //! pipeline_comm so that they can not match messages of the caller on comm
+  static constexpr t_int pipeline_tag = 0;
+  //! Duplicates comm, collective over comm
+  static std::shared_ptr<const MPI_Comm> duplicate(const sopt::mpi::Communicator &comm) {
+    MPI_Comm dup;
+    MPI_Comm_dup(*comm, &dup);
+    return managed_communicator(dup);
+  }
+  static std::vector<t_int> displacements(const std::vector<t_int> &sizes) {
+    std::vector<t_int> displs(sizes.size(), 0);
+    for (std::size_t i = 1; i < sizes.size(); i++) displs[i] = displs[i - 1] + sizes[i - 1];
+    return displs;
+  }
+
   IndexMapping<STORAGE_INDEX_TYPE> mapping;
   std::vector<t_int> send_sizes;
   std::vector<t_int> recv_sizes;
   sopt::mpi::Communicator comm;
+  std::shared_ptr<const MPI_Comm> pipeline_comm;
+  //! Exchanges the grid only with the nodes that share grid points
+  NeighbourhoodExchange neighbourhood;
 };
 
 }  // namespace purify
@@ -6,6 +6,7 @@
 #include "purify/types.h"
 #include <numeric>
 #include "purify/IndexMapping.h"
+#include "purify/NeighbourhoodExchange.h"
 #include "sopt/mpi/communicator.h"
 
 namespace purify {
@@ -15,7 +16,11 @@ namespace purify {
 class DistributeSparseVector {
   DistributeSparseVector(const IndexMapping<t_int> &_mapping, const std::vector<t_int> &_sizes,
                          const t_int _local_size, const sopt::mpi::Communicator &_comm)
-      : mapping(_mapping), sizes(_sizes), local_size(_local_size), comm(_comm) {}
+      : mapping(_mapping),
+        sizes(_sizes),
+        local_size(_local_size),
+        comm(_comm),
+        neighbourhood(scatter_pattern(sizes, local_size, comm)) {}
   DistributeSparseVector(const std::vector<t_int> &local_indices, std::vector<t_int> const &_sizes,
                          t_int global_size, const sopt::mpi::Communicator &_comm)
       : DistributeSparseVector(
@@ -45,37 +50,52 @@ class DistributeSparseVector {
   void scatter(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &output) const {
     assert(input.cols() == 1);
     if (not comm.is_root()) return scatter(output);
-    Vector<typename T0::Scalar> buffer;
-    mapping(input, buffer);
-    assert(buffer.size() == std::accumulate(sizes.begin(), sizes.end(), 0));
-    output.const_cast_derived() = comm.scatterv(buffer, sizes);
+    typedef typename T0::Scalar Scalar;
+    // the requested elements are sent straight from the input
+    Eigen::Ref<const Vector<Scalar>> const vector(input);
+    output.const_cast_derived() =
+        neighbourhood(vector.data(), mapping.template mpi_types<Scalar>(sizes));
   }
 
   template <class T1>
   void scatter(Eigen::MatrixBase<T1> const &output) const {
     if (comm.is_root()) throw std::runtime_error("This function should not be called by root");
-    output.const_cast_derived() = comm.scatterv<typename T1::Scalar>(local_size);
+    // same collective as root, sending nothing
+    output.const_cast_derived() = neighbourhood(static_cast<const typename T1::Scalar *>(nullptr),
+                                                std::vector<MPI_Datatype>());
   }
 
   template <class T0, class T1>
   void gather(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &output) const {
     assert(input.cols() == 1);
     if (not comm.is_root()) return gather(input);
-    auto const buffer = comm.gather<typename T0::Scalar>(input, sizes);
+    auto const buffer = neighbourhood.adjoint(Vector<typename T0::Scalar>(input));
     mapping.adjoint(buffer, output.derived());
   }
 
   template <class T1>
   void gather(Eigen::MatrixBase<T1> const &input) const {
     if (comm.is_root()) throw std::runtime_error("This function should not be called by root");
-    comm.gather<typename T1::Scalar>(input);
+    neighbourhood.adjoint(Vector<typename T1::Scalar>(input));
   }
 
  private:
+  //! Root sends to each node that asks for indices, the other nodes only receive from root
+  static NeighbourhoodExchange scatter_pattern(const std::vector<t_int> &sizes,
+                                               const t_int local_size,
+                                               const sopt::mpi::Communicator &comm) {
+    std::vector<t_int> send_sizes(comm.size(), 0);
+    std::vector<t_int> recv_sizes(comm.size(), 0);
+    if (comm.is_root()) send_sizes = sizes;
+    recv_sizes[comm.root_id()] = local_size;
+    return NeighbourhoodExchange(send_sizes, recv_sizes, comm);
+  }
+
   IndexMapping<t_int> mapping;
   std::vector<t_int> sizes;
   t_int local_size;
   sopt::mpi::Communicator comm;
+  NeighbourhoodExchange neighbourhood;
 };
 }  // namespace purify
 #endif
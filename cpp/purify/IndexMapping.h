@@ -3,16 +3,41 @@
 
 #include "purify/config.h"
 #include "purify/types.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <numeric>
 #include <set>
+#include <tuple>
+#include <utility>
 #include <vector>
+#ifdef PURIFY_MPI
+#include "sopt/mpi/types.h"
+#endif
 
 namespace purify {
+//! \brief Selects elements of a vector at given indices
+//! \details Indices are stored as runs of consecutive indices, since the non-zero columns of a
+//! gridding matrix form long contiguous runs on the FFT grid.
 template <class STORAGE_INDEX_TYPE = t_int>
 class IndexMapping {
  public:
   IndexMapping(const std::vector<STORAGE_INDEX_TYPE> &indices, const STORAGE_INDEX_TYPE N,
                const STORAGE_INDEX_TYPE start = 0)
-      : indices(indices), N(N), start(start){};
+      : size(indices.size()), start(start), N(N) {
+    for (auto const &index : indices) {
+      assert(index >= start and index < (N + start));
+      if (run_lengths.size() > 0 and index == run_starts.back() + run_lengths.back())
+        run_lengths.back()++;
+      else {
+        run_starts.push_back(index);
+        run_lengths.push_back(1);
+      }
+    }
+    run_offsets = std::vector<t_int>(run_lengths.size(), 0);
+    for (std::size_t r = 1; r < run_lengths.size(); r++)
+      run_offsets[r] = run_offsets[r - 1] + run_lengths[r - 1];
+  };
   template <class ITER>
   IndexMapping(const ITER &first, const ITER &end, const STORAGE_INDEX_TYPE N,
                const STORAGE_INDEX_TYPE start = 0)
@@ -25,35 +50,96 @@ class IndexMapping {
   template <class T0, class T1>
   void operator()(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &output) const {
     auto &derived = output.const_cast_derived();
-    derived.resize(indices.size());
-    typename T0::Index i(0);
-    for (auto const &index : indices) {
-      assert(index >= start and index < (N + start));
-      assert(derived.size() > i);
-      derived(i++) = input(index - start);
-    }
+    derived.resize(size);
+    for (std::size_t r = 0; r < run_starts.size(); r++)
+      derived.segment(run_offsets[r], run_lengths[r]) =
+          input.segment(run_starts[r] - start, run_lengths[r]);
   }
 
   //! Vector of size `N` where non-zero elements are chosen from input at given indices
   template <class T0, class T1>
   void adjoint(Eigen::MatrixBase<T0> const &input, Eigen::MatrixBase<T1> const &output) const {
-    assert(static_cast<size_t>(input.size()) == indices.size());
+    assert(input.size() == size);
     auto &derived = output.const_cast_derived();
     derived = T1::Zero(N, 1);
-    typename T0::Index i(0);
-    for (STORAGE_INDEX_TYPE const &index : indices) {
-      assert(index >= start and index < (N + start));
-      derived(index - start) += input(i++);
+    for (std::size_t r = 0; r < run_starts.size(); r++)
+      derived.segment(run_starts[r] - start, run_lengths[r]) +=
+          input.segment(run_offsets[r], run_lengths[r]);
+  }
+
+#ifdef PURIFY_MPI
+  //! \brief Datatypes that select the indices of consecutive blocks of the output directly from
+  //! the input vector
+  //! \details Block `i` covers `sizes[i]` elements of the output. The datatypes are owned by the
+  //! mapping and are created once for each element type and each set of sizes. Empty blocks are
+  //! given MPI_DATATYPE_NULL.
+  template <class T>
+  std::vector<MPI_Datatype> const &mpi_types(const std::vector<t_int> &sizes) const {
+    const MPI_Datatype element = sopt::mpi::Type<T>::value;
+    auto const key = std::make_pair(element, sizes);
+    auto const cached = datatypes->find(key);
+    if (cached != datatypes->end()) return cached->second;
+    if (std::accumulate(sizes.begin(), sizes.end(), 0) != size)
+      throw std::runtime_error("Sizes of blocks do not add up to the size of the mapping.");
+    std::vector<MPI_Datatype> types(sizes.size(), MPI_DATATYPE_NULL);
+    t_int first = 0;
+    for (std::size_t i = 0; i < sizes.size(); i++) {
+      if (sizes[i] == 0) continue;
+      const t_int last = first + sizes[i];
+      std::vector<int> lengths;
+      std::vector<MPI_Aint> displacements;
+      // first run overlapping the block
+      std::size_t r = std::upper_bound(run_offsets.begin(), run_offsets.end(), first) -
+                      run_offsets.begin() - 1;
+      for (; r < run_starts.size() and run_offsets[r] < last; r++) {
+        const t_int begin = std::max(first, run_offsets[r]);
+        const t_int end = std::min(last, run_offsets[r] + run_lengths[r]);
+        lengths.push_back(end - begin);
+        displacements.push_back(static_cast<MPI_Aint>(run_starts[r] - start + begin -
+                                                      run_offsets[r]) *
+                                static_cast<MPI_Aint>(sizeof(T)));
+      }
+      MPI_Type_create_hindexed(lengths.size(), lengths.data(), displacements.data(), element,
+                               &types[i]);
+      MPI_Type_commit(&types[i]);
+      first = last;
     }
+    return datatypes->emplace(key, std::move(types)).first->second;
   }
+#endif
 
-  t_int rows() const { return indices.size(); }
+  t_int rows() const { return size; }
   STORAGE_INDEX_TYPE cols() const { return N; }
+  //! Number of runs of consecutive indices
+  t_int runs() const { return run_starts.size(); }
 
  private:
-  std::vector<STORAGE_INDEX_TYPE> indices;
+  //! First index of each run
+  std::vector<STORAGE_INDEX_TYPE> run_starts;
+  //! Length of each run
+  std::vector<t_int> run_lengths;
+  //! Position of each run in the output
+  std::vector<t_int> run_offsets;
+  t_int size;
   STORAGE_INDEX_TYPE start;
   STORAGE_INDEX_TYPE N;
+#ifdef PURIFY_MPI
+  //! Datatypes for each element type and sizes of the blocks
+  typedef std::map<std::pair<MPI_Datatype, std::vector<t_int>>, std::vector<MPI_Datatype>>
+      datatype_cache;
+  static void free_types(datatype_cache *types) {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (not finalized)
+      for (auto &element : *types)
+        for (auto &type : element.second)
+          if (type != MPI_DATATYPE_NULL) MPI_Type_free(&type);
+    delete types;
+  }
+  //! Datatypes shared between copies of the mapping
+  std::shared_ptr<datatype_cache> datatypes =
+      std::shared_ptr<datatype_cache>(new datatype_cache(), &free_types);
+#endif
 };
 
 //! Indices of non empty outer indices
@@ -93,5 +179,35 @@ Sparse<typename T0::Scalar> compress_outer(T0 const &matrix) {
       matrix.rows(), indices.size(), matrix.nonZeros(), rows.data(), cols.data(),
       const_cast<typename T0::Scalar *>(matrix.derived().valuePtr()));
 }
+
+//! Splits the columns of a row major sparse matrix into consecutive blocks of the given widths
+//! \details Each block only holds the rows that have nonzeros in its columns, and is returned with
+//! the row of the matrix for each of its rows, so the blocks together take the memory of the
+//! matrix.
+template <class T0>
+std::vector<std::tuple<std::vector<t_int>, Sparse<typename T0::Scalar>>> split_columns(
+    T0 const &matrix, const std::vector<t_int> &widths) {
+  static_assert(T0::IsRowMajor, "Not tested for col major");
+  std::vector<t_int> ends(widths.size(), 0);
+  std::partial_sum(widths.begin(), widths.end(), ends.begin());
+  if (ends.empty() or ends.back() != matrix.cols())
+    throw std::runtime_error("Widths of blocks do not add up to the number of columns.");
+  std::vector<std::vector<t_int>> rows(widths.size());
+  std::vector<std::vector<Eigen::Triplet<typename T0::Scalar>>> triplets(widths.size());
+  for (typename T0::Index k = 0; k < matrix.outerSize(); ++k)
+    for (typename T0::InnerIterator it(matrix, k); it; ++it) {
+      const t_int block = std::upper_bound(ends.begin(), ends.end(), it.col()) - ends.begin();
+      if (rows[block].empty() or rows[block].back() != k) rows[block].push_back(k);
+      triplets[block].emplace_back(rows[block].size() - 1, it.col() - (ends[block] - widths[block]),
+                                   it.value());
+    }
+  std::vector<std::tuple<std::vector<t_int>, Sparse<typename T0::Scalar>>> blocks;
+  for (std::size_t b = 0; b < widths.size(); b++) {
+    Sparse<typename T0::Scalar> block(rows[b].size(), widths[b]);
+    block.setFromTriplets(triplets[b].begin(), triplets[b].end());
+    blocks.emplace_back(std::move(rows[b]), std::move(block));
+  }
+  return blocks;
+}
 }  // namespace purify
 #endif
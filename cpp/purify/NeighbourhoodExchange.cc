@@ -0,0 +1,37 @@
+#include "purify/NeighbourhoodExchange.h"
+#include "purify/logging.h"
+
+namespace purify {
+
+NeighbourhoodExchange::NeighbourhoodExchange(const std::vector<t_int> &send_sizes,
+                                             const std::vector<t_int> &recv_sizes,
+                                             const sopt::mpi::Communicator &comm) {
+  if (send_sizes.size() != comm.size() or recv_sizes.size() != comm.size())
+    throw std::runtime_error("Sizes of the exchange do not match the size of the communicator.");
+  // the graph is symmetric, so the same topology works in both directions
+  for (t_int node = 0; node < comm.size(); node++) {
+    if (send_sizes[node] == 0 and recv_sizes[node] == 0) continue;
+    neighbour_nodes.push_back(node);
+    send_counts.push_back(send_sizes[node]);
+    recv_counts.push_back(recv_sizes[node]);
+  }
+  send_displs = std::vector<int>(send_counts.size(), 0);
+  recv_displs = std::vector<int>(recv_counts.size(), 0);
+  for (std::size_t i = 1; i < neighbour_nodes.size(); i++) {
+    send_displs[i] = send_displs[i - 1] + send_counts[i - 1];
+    recv_displs[i] = recv_displs[i - 1] + recv_counts[i - 1];
+  }
+  MPI_Comm graph_comm;
+  MPI_Dist_graph_create_adjacent(*comm, neighbour_nodes.size(), neighbour_nodes.data(),
+                                 MPI_UNWEIGHTED, neighbour_nodes.size(), neighbour_nodes.data(),
+                                 MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &graph_comm);
+  graph = std::shared_ptr<const MPI_Comm>(new MPI_Comm(graph_comm), [](const MPI_Comm *ptr) {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (not finalized) MPI_Comm_free(const_cast<MPI_Comm *>(ptr));
+    delete ptr;
+  });
+  PURIFY_DEBUG("Node {} exchanges data with {} of {} nodes.", comm.rank(), neighbour_nodes.size(),
+               comm.size());
+}
+}  // namespace purify
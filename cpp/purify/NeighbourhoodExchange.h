@@ -0,0 +1,86 @@
+#ifndef PURIFY_NEIGHBOURHOOD_EXCHANGE_H
+#define PURIFY_NEIGHBOURHOOD_EXCHANGE_H
+
+#include "purify/config.h"
+#ifdef PURIFY_MPI
+#include "purify/types.h"
+#include <memory>
+#include <numeric>
+#include <vector>
+#include "sopt/mpi/communicator.h"
+#include "sopt/mpi/types.h"
+
+namespace purify {
+//! \brief Exchanges a vector between the nodes that actually share data
+//! \details A distributed graph topology is built from the non-zero sizes, so that the exchange
+//! uses MPI_Neighbor_alltoallv and only involves the neighbours of each node. The result is the
+//! same as an all to all over the whole communicator.
+class NeighbourhoodExchange {
+ public:
+  //! \param[in] send_sizes: number of elements sent to each node of comm
+  //! \param[in] recv_sizes: number of elements received from each node of comm
+  //! \param[in] comm: Communicator over which the vector is exchanged
+  NeighbourhoodExchange(const std::vector<t_int> &send_sizes, const std::vector<t_int> &recv_sizes,
+                        const sopt::mpi::Communicator &comm);
+
+  //! Sends `send_sizes` elements to each neighbour and receives `recv_sizes` from each
+  template <class T>
+  Vector<T> operator()(const Vector<T> &input) const {
+    return exchange(input, send_counts, send_displs, recv_counts, recv_displs);
+  }
+  //! \brief Same as operator(), but the elements sent to each node are selected from `data` by
+  //! the datatype `node_types[node]`
+  //! \details The elements are sent straight from `data`, without packing them into a buffer.
+  //! Nodes that send nothing can pass no data and no datatypes.
+  template <class T>
+  Vector<T> operator()(const T *data, const std::vector<MPI_Datatype> &node_types) const {
+    const MPI_Datatype element = sopt::mpi::Type<T>::value;
+    std::vector<int> scounts(neighbour_nodes.size(), 0);
+    std::vector<MPI_Datatype> stypes(neighbour_nodes.size(), element);
+    std::vector<MPI_Aint> sdispls(neighbour_nodes.size(), 0);
+    std::vector<MPI_Datatype> rtypes(neighbour_nodes.size(), element);
+    std::vector<MPI_Aint> rdispls(neighbour_nodes.size(), 0);
+    for (std::size_t i = 0; i < neighbour_nodes.size(); i++) {
+      if (send_counts[i] > 0) {
+        scounts[i] = 1;
+        stypes[i] = node_types.at(neighbour_nodes[i]);
+      }
+      rdispls[i] = static_cast<MPI_Aint>(recv_displs[i]) * static_cast<MPI_Aint>(sizeof(T));
+    }
+    Vector<T> output(std::accumulate(recv_counts.begin(), recv_counts.end(), 0));
+    MPI_Neighbor_alltoallw(data, scounts.data(), sdispls.data(), stypes.data(), output.data(),
+                           recv_counts.data(), rdispls.data(), rtypes.data(), *graph);
+    return output;
+  }
+  //! Exchange in the reverse direction, sending `recv_sizes` and receiving `send_sizes`
+  template <class T>
+  Vector<T> adjoint(const Vector<T> &input) const {
+    return exchange(input, recv_counts, recv_displs, send_counts, send_displs);
+  }
+
+  //! Nodes that this node exchanges data with
+  std::vector<t_int> const &neighbours() const { return neighbour_nodes; }
+
+ private:
+  template <class T>
+  Vector<T> exchange(const Vector<T> &input, const std::vector<int> &scounts,
+                     const std::vector<int> &sdispls, const std::vector<int> &rcounts,
+                     const std::vector<int> &rdispls) const {
+    assert(input.size() == std::accumulate(scounts.begin(), scounts.end(), 0));
+    Vector<T> output(std::accumulate(rcounts.begin(), rcounts.end(), 0));
+    MPI_Neighbor_alltoallv(input.data(), scounts.data(), sdispls.data(),
+                           sopt::mpi::Type<T>::value, output.data(), rcounts.data(),
+                           rdispls.data(), sopt::mpi::Type<T>::value, *graph);
+    return output;
+  }
+
+  std::vector<t_int> neighbour_nodes;
+  std::vector<int> send_counts;
+  std::vector<int> send_displs;
+  std::vector<int> recv_counts;
+  std::vector<int> recv_displs;
+  std::shared_ptr<const MPI_Comm> graph;
+};
+}  // namespace purify
+#endif
+#endif
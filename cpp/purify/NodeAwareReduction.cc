@@ -0,0 +1,22 @@
+#include "purify/NodeAwareReduction.h"
+#include "purify/logging.h"
+
+namespace purify {
+
+bool NodeAwareReduction::default_shared_memory = false;
+
+NodeAwareReduction::NodeAwareReduction(const sopt::mpi::Communicator &comm,
+                                       const bool shared_memory)
+    : comm(comm), node_comm(node_communicator(comm)) {
+  int node_rank, node_size;
+  MPI_Comm_rank(*node_comm, &node_rank);
+  MPI_Comm_size(*node_comm, &node_size);
+  MPI_Comm leader_comm;
+  MPI_Comm_split(*comm, (node_rank == 0) ? 0 : MPI_UNDEFINED, comm.rank(), &leader_comm);
+  leaders = managed_communicator(leader_comm);
+  number_of_nodes = comm.all_sum_all<t_int>((node_rank == 0) ? 1 : 0);
+  is_hierarchical = shared_memory and comm.all_reduce<t_int>(node_size, MPI_MAX) > 1;
+  PURIFY_MEDIUM_LOG("Reductions over {} ranks on {} compute nodes ({}).", comm.size(),
+                    number_of_nodes, is_hierarchical ? "hierarchical" : "flat");
+}
+}  // namespace purify
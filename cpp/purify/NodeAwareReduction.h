@@ -0,0 +1,92 @@
+#ifndef PURIFY_NODE_AWARE_REDUCTION_H
+#define PURIFY_NODE_AWARE_REDUCTION_H
+
+#include "purify/config.h"
+#ifdef PURIFY_MPI
+#include "purify/types.h"
+#include <map>
+#include <memory>
+#include <typeindex>
+#include "purify/SharedArray.h"
+#include "sopt/mpi/communicator.h"
+#include "sopt/mpi/types.h"
+
+namespace purify {
+//! \brief Sums a vector over all nodes of a communicator, one network message per compute node
+//! \details The ranks on the same compute node (as given by MPI_Comm_split_type) first add their
+//! vectors to a shared memory array, held once per compute node. The node leaders then all reduce
+//! over the network, and the result is read by every rank from shared memory. When each compute
+//! node only has one rank, or without shared_memory, this is a plain all_sum_all.
+class NodeAwareReduction {
+ public:
+  explicit NodeAwareReduction(const sopt::mpi::Communicator &comm,
+                              const bool shared_memory = shared_memory_default());
+
+  //! Whether reductions go through shared memory when it is not given, false unless set
+  static bool shared_memory_default() { return default_shared_memory; }
+  //! Sets whether reductions go through shared memory when it is not given
+  static void shared_memory_default(const bool shared_memory) {
+    default_shared_memory = shared_memory;
+  }
+
+  //! Sum of the input over all ranks of the communicator, returned on every rank
+  //! \details The ranks of a compute node reduce onto the first rank, which writes the sum over
+  //! all nodes to shared memory before a single barrier. The reduce only ends once every rank of
+  //! the node has started the next reduction, so the output is not overwritten while it is read.
+  template <class T>
+  Vector<T> all_sum_all(const Vector<T> &input) const {
+    if (not is_hierarchical) return comm.all_sum_all<Vector<T>>(input);
+    if (input.size() == 0) return input;
+    const SharedArray<T> &sum = shared_buffer<T>(input.size());
+    Vector<T> node_sum(sum.rank() == 0 ? input.size() : 0);
+    MPI_Reduce(input.data(), node_sum.data(), input.size(), sopt::mpi::Type<T>::value, MPI_SUM, 0,
+               *node_comm);
+    if (sum.rank() == 0) {
+      if (number_of_nodes > 1)
+        MPI_Allreduce(node_sum.data(), sum.data(), sum.size(), sopt::mpi::Type<T>::value, MPI_SUM,
+                      *leaders);
+      else
+        sum.vector() = node_sum;
+    }
+    sum.sync();
+    return sum.vector();
+  }
+
+  //! Sums a shared array, that holds the sum over the ranks of each compute node, over the nodes
+  //! \details The array has to be shared over node(). On return, it holds the sum over all ranks.
+  template <class T>
+  void all_sum_nodes(const SharedArray<T> &sum) const {
+    if (sum.rank() == 0 and number_of_nodes > 1)
+      MPI_Allreduce(MPI_IN_PLACE, sum.data(), sum.size(), sopt::mpi::Type<T>::value, MPI_SUM,
+                    *leaders);
+    sum.sync();
+  }
+
+  //! Whether the reduction goes through shared memory
+  bool hierarchical() const { return is_hierarchical; }
+  //! Number of compute nodes spanned by the communicator
+  t_int nodes() const { return number_of_nodes; }
+  //! Communicator of the ranks on the same compute node
+  std::shared_ptr<const MPI_Comm> const &node() const { return node_comm; }
+
+ private:
+  //! Shared array of the given size, reallocated when the size changes
+  template <class T>
+  const SharedArray<T> &shared_buffer(const std::int64_t size) const {
+    auto &buffer = buffers[std::type_index(typeid(T))];
+    if (not buffer or std::static_pointer_cast<SharedArray<T>>(buffer)->size() != size)
+      buffer = std::make_shared<SharedArray<T>>(node_comm, size);
+    return *std::static_pointer_cast<SharedArray<T>>(buffer);
+  }
+
+  sopt::mpi::Communicator comm;
+  std::shared_ptr<const MPI_Comm> node_comm;
+  std::shared_ptr<const MPI_Comm> leaders;
+  t_int number_of_nodes;
+  bool is_hierarchical;
+  mutable std::map<std::type_index, std::shared_ptr<void>> buffers;
+  static bool default_shared_memory;
+};
+}  // namespace purify
+#endif
+#endif
@@ -0,0 +1,130 @@
+#ifndef PURIFY_SHARED_ARRAY_H
+#define PURIFY_SHARED_ARRAY_H
+
+#include "purify/config.h"
+#ifdef PURIFY_MPI
+#include "purify/types.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "sopt/mpi/communicator.h"
+#include "sopt/mpi/types.h"
+
+namespace purify {
+//! Takes ownership of an MPI communicator, which is freed unless MPI was already finalized
+inline std::shared_ptr<const MPI_Comm> managed_communicator(const MPI_Comm comm) {
+  return std::shared_ptr<const MPI_Comm>(new MPI_Comm(comm), [](const MPI_Comm *comm) {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (not finalized and *comm != MPI_COMM_NULL) MPI_Comm_free(const_cast<MPI_Comm *>(comm));
+    delete comm;
+  });
+}
+
+//! Splits the communicator into the ranks that share memory on each compute node
+inline std::shared_ptr<const MPI_Comm> node_communicator(const sopt::mpi::Communicator &comm) {
+  MPI_Comm node;
+  MPI_Comm_split_type(*comm, MPI_COMM_TYPE_SHARED, comm.rank(), MPI_INFO_NULL, &node);
+  return managed_communicator(node);
+}
+
+//! \brief Array that is allocated once on each compute node and shared by the ranks of the node
+//! \details The memory belongs to the first rank of the node, and the other ranks access it
+//! directly through an MPI-3 shared memory window. Writes and reads from different ranks have to
+//! be separated by sync(). Construction is collective over the node communicator.
+template <class T>
+class SharedArray {
+ public:
+  SharedArray(const std::shared_ptr<const MPI_Comm> &node, const std::int64_t size)
+      : node(node), length(size) {
+    MPI_Comm_rank(*node, &node_rank);
+    MPI_Comm_size(*node, &node_size);
+    MPI_Win win;
+    void *local;
+    MPI_Win_allocate_shared((node_rank == 0) ? static_cast<MPI_Aint>(size * sizeof(T)) : 0,
+                            sizeof(T), MPI_INFO_NULL, *node, &local, &win);
+    MPI_Aint leader_size;
+    int disp_unit;
+    void *leader;
+    MPI_Win_shared_query(win, 0, &leader_size, &disp_unit, &leader);
+    base = static_cast<T *>(leader);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+    window = std::shared_ptr<MPI_Win>(new MPI_Win(win), [](MPI_Win *win) {
+      int finalized;
+      MPI_Finalized(&finalized);
+      if (not finalized) {
+        MPI_Win_unlock_all(*win);
+        MPI_Win_free(win);
+      }
+      delete win;
+    });
+  }
+
+  //! Pointer to the first element, the same array on every rank of the node
+  T *data() const { return base; }
+  //! Number of elements
+  std::int64_t size() const { return length; }
+  //! The array as an Eigen vector
+  Eigen::Map<Vector<T>> vector() const { return Eigen::Map<Vector<T>>(base, length); }
+  //! Rank in the node communicator
+  t_int rank() const { return node_rank; }
+  //! Number of ranks sharing the array
+  t_int ranks() const { return node_size; }
+  //! Communicator of the ranks sharing the array
+  MPI_Comm const &communicator() const { return *node; }
+
+  //! Start of the chunk of elements of rank `r`, and the size of the array for r == ranks()
+  std::int64_t chunk_start(const t_int r) const { return (length * r) / node_size; }
+
+  //! Makes writes of every rank of the node visible to all ranks of the node
+  void sync() const {
+    MPI_Win_sync(*window);
+    MPI_Barrier(*node);
+    MPI_Win_sync(*window);
+  }
+
+  //! Sets the array to zero, each rank zeroing its own chunk
+  void zero() const {
+    std::fill(base + chunk_start(node_rank), base + chunk_start(node_rank + 1), T(0));
+    sync();
+  }
+
+  //! Adds the values of every rank of the node to the array
+  //! \details The values are summed with a single reduce onto the first rank of the node, which
+  //! adds them to the array, followed by one barrier. The reduce only ends once every rank has
+  //! called add, so the array is not written while other ranks still read it from before.
+  void add(const Vector<T> &values) const {
+    assert(values.size() == length);
+    Vector<T> sum(node_rank == 0 ? length : 0);
+    MPI_Reduce(values.data(), sum.data(), length, sopt::mpi::Type<T>::value, MPI_SUM, 0, *node);
+    if (node_rank == 0) vector() += sum;
+    sync();
+  }
+  //! Adds values at sorted indices of the array, from every rank of the node
+  template <class INDEX>
+  void add(const std::vector<INDEX> &indices, const Vector<T> &values) const {
+    assert(static_cast<std::int64_t>(indices.size()) == values.size());
+    for (t_int round = 0; round < node_size; round++) {
+      const t_int chunk = (node_rank + round) % node_size;
+      const auto first = std::lower_bound(indices.begin(), indices.end(),
+                                          static_cast<INDEX>(chunk_start(chunk)));
+      const auto last = std::lower_bound(first, indices.end(),
+                                         static_cast<INDEX>(chunk_start(chunk + 1)));
+      for (auto index = first; index != last; ++index)
+        base[*index] += values(index - indices.begin());
+      sync();
+    }
+  }
+
+ private:
+  std::shared_ptr<const MPI_Comm> node;
+  std::shared_ptr<MPI_Win> window;
+  T *base;
+  std::int64_t length;
+  t_int node_rank;
+  t_int node_size;
+};
+}  // namespace purify
+#endif
+#endif
@@ -0,0 +1,320 @@
+#ifndef PURIFY_BATCH_OPERATORS_H
+#define PURIFY_BATCH_OPERATORS_H
+
+#include "purify/config.h"
+#include "purify/types.h"
+#include <array>
+#include <map>
+#include <memory>
+#include <tuple>
+#include "purify/kernels.h"
+#include "purify/logging.h"
+#include "purify/operators.h"
+#include "purify/utilities.h"
+#include <sopt/chained_operators.h>
+#include <sopt/linear_transform.h>
+
+#include <fftw3.h>
+
+#ifdef PURIFY_MPI
+#include <sopt/mpi/communicator.h>
+#endif
+
+namespace purify {
+namespace operators {
+//! \brief Operators that act on a matrix where each column is an image or a set of visibilities
+//! \details All columns share the same uv coverage, so the kernel values and grid indices are
+//! read once per visibility and applied to every column.
+
+//! Constructs the gridding operator for vectors and for batches of vectors from one gridding matrix
+template <class T, class... ARGS>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>>
+init_gridding_matrix_2d_with_batch(ARGS &&... args) {
+  typedef Matrix<typename T::Scalar> B;
+  const std::shared_ptr<const Sparse<t_complex>> interpolation_matrix =
+      std::make_shared<const Sparse<t_complex>>(
+          details::init_gridding_matrix_2d(std::forward<ARGS>(args)...));
+  const std::shared_ptr<const Sparse<t_complex>> adjoint =
+      std::make_shared<const Sparse<t_complex>>(interpolation_matrix->adjoint());
+
+  return std::make_tuple(
+      [=](T &output, const T &input) {
+        output = utilities::sparse_multiply_matrix(*interpolation_matrix, input);
+      },
+      [=](T &output, const T &input) {
+        output = utilities::sparse_multiply_matrix(*adjoint, input);
+      },
+      [=](B &output, const B &input) {
+        output = utilities::sparse_multiply_dense_matrix(*interpolation_matrix, input);
+      },
+      [=](B &output, const B &input) {
+        output = utilities::sparse_multiply_dense_matrix(*adjoint, input);
+      });
+}
+
+//! Constructs zero padding and correction operator for batches of images
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_zero_padding_2d_batch(
+    const Image<typename T::Scalar> &S, const t_real &oversample_ratio) {
+  sopt::OperatorFunction<Vector<typename T::Scalar>> directZ, indirectZ;
+  std::tie(directZ, indirectZ) =
+      init_zero_padding_2d<Vector<typename T::Scalar>>(S, oversample_ratio);
+  const t_uint ftsize =
+      std::floor(S.cols() * oversample_ratio) * std::floor(S.rows() * oversample_ratio);
+  const t_uint imsize = S.size();
+  auto direct = [=](T &output, const T &x) {
+    output = T::Zero(ftsize, x.cols());
+    for (t_int j = 0; j < x.cols(); j++) {
+      Vector<typename T::Scalar> column;
+      directZ(column, x.col(j));
+      output.col(j) = column;
+    }
+  };
+  auto indirect = [=](T &output, const T &x) {
+    output = T::Zero(imsize, x.cols());
+    for (t_int j = 0; j < x.cols(); j++) {
+      Vector<typename T::Scalar> column;
+      indirectZ(column, x.col(j));
+      output.col(j) = column;
+    }
+  };
+  return std::make_tuple(direct, indirect);
+}
+
+//! Constructs FFT operator for batches of grids, transforming all columns with one FFTW plan
+//! \details A plan is made with fftw_plan_many_dft the first time a number of columns is used.
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_FFT_2d_batch(
+    const t_uint &imsizey_, const t_uint &imsizex_, const t_real &oversample_factor_,
+    const fftw_plan fftw_plan_flag_ = fftw_plan::measure) {
+  t_int const ftsizeu_ = std::floor(imsizex_ * oversample_factor_);
+  t_int const ftsizev_ = std::floor(imsizey_ * oversample_factor_);
+  t_int plan_flag = (FFTW_MEASURE | FFTW_PRESERVE_INPUT);
+  switch (fftw_plan_flag_) {
+  case (fftw_plan::measure):
+    plan_flag = (FFTW_MEASURE | FFTW_PRESERVE_INPUT);
+    break;
+  case (fftw_plan::estimate):
+    plan_flag = (FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    break;
+  }
+
+#ifdef PURIFY_OPENMP_FFTW
+  PURIFY_LOW_LOG("Using OpenMP threading with FFTW.");
+  fftw_init_threads();
+#endif
+  const t_int dist = ftsizev_ * ftsizeu_;
+  typedef std::array<std::shared_ptr<fftw_plan_s>, 2> plan_pair;
+  const std::shared_ptr<std::map<t_int, plan_pair>> plans =
+      std::make_shared<std::map<t_int, plan_pair>>();
+  // each column of a column major matrix is one contiguous grid
+  const auto plans_for = [plans, ftsizeu_, ftsizev_, dist, plan_flag](const t_int batch)
+      -> const plan_pair & {
+    const auto found = plans->find(batch);
+    if (found != plans->end()) return found->second;
+    T src = T::Zero(dist, batch);
+    T dst = T::Zero(dist, batch);
+    const t_int n[2] = {ftsizev_, ftsizeu_};
+    const auto del = [](fftw_plan_s *plan) { fftw_destroy_plan(plan); };
+    plan_pair result;
+    const int directions[2] = {FFTW_FORWARD, FFTW_BACKWARD};
+    for (t_int i = 0; i < 2; i++) {
+      // fftw plan with threads needs to be used before each fftw_plan is created
+#ifdef PURIFY_OPENMP_FFTW
+      fftw_plan_with_nthreads(omp_get_max_threads());
+#endif
+      result[i] = std::shared_ptr<fftw_plan_s>(
+          fftw_plan_many_dft(2, n, batch, reinterpret_cast<fftw_complex *>(src.data()), nullptr,
+                             1, dist, reinterpret_cast<fftw_complex *>(dst.data()), nullptr, 1,
+                             dist, directions[i], plan_flag),
+          del);
+    }
+    return plans->emplace(batch, result).first->second;
+  };
+  auto const direct = [plans_for, dist](T &output, const T &input) {
+    assert(input.rows() == dist);
+    output = T::Zero(input.rows(), input.cols());
+    fftw_execute_dft(
+        plans_for(input.cols())[0].get(),
+        const_cast<fftw_complex *>(reinterpret_cast<const fftw_complex *>(input.data())),
+        reinterpret_cast<fftw_complex *>(output.data()));
+    output /= std::sqrt(dist);
+  };
+  auto const indirect = [plans_for, dist](T &output, const T &input) {
+    assert(input.rows() == dist);
+    output = T::Zero(input.rows(), input.cols());
+    fftw_execute_dft(
+        plans_for(input.cols())[1].get(),
+        const_cast<fftw_complex *>(reinterpret_cast<const fftw_complex *>(input.data())),
+        reinterpret_cast<fftw_complex *>(output.data()));
+    output /= std::sqrt(dist);
+  };
+  return std::make_tuple(direct, indirect);
+}
+
+//! Returns the degridding operator on vectors and on batches of vectors with the same coverage
+//! \details Both operators apply the same gridding matrix, so it is only held once.
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>>
+base_degrid_operator_2d_with_batch(
+    const Vector<t_real> &u, const Vector<t_real> &v, const Vector<t_real> &w,
+    const Vector<t_complex> &weights, const t_uint &imsizey, const t_uint &imsizex,
+    const t_real &oversample_ratio = 2, const kernels::kernel kernel = kernels::kernel::kb,
+    const t_uint Ju = 4, const t_uint Jv = 4, const fftw_plan &ft_plan = fftw_plan::measure,
+    const bool w_stacking = false, const t_real &cellx = 1, const t_real &celly = 1) {
+  typedef Matrix<typename T::Scalar> B;
+  std::function<t_real(t_real)> kernelu, kernelv, ftkernelu, ftkernelv;
+  std::tie(kernelu, kernelv, ftkernelu, ftkernelv) =
+      purify::create_kernels(kernel, Ju, Jv, imsizey, imsizex, oversample_ratio);
+  t_real const w_mean = w_stacking ? w.array().mean() : 0.;
+  sopt::OperatorFunction<T> directFZ, indirectFZ;
+  std::tie(directFZ, indirectFZ) = base_padding_and_FFT_2d<T>(
+      ftkernelu, ftkernelv, imsizey, imsizex, oversample_ratio, ft_plan, w_mean, cellx, celly);
+  const Image<t_complex> S =
+      purify::details::init_correction2d(oversample_ratio, imsizey, imsizex, ftkernelu, ftkernelv,
+                                         w_mean, cellx, celly) *
+      std::sqrt(imsizex * imsizey) * oversample_ratio;
+  PURIFY_LOW_LOG("Constructing batched FFT and Zero Padding operators: FZ");
+  sopt::OperatorFunction<B> directZ_batch, indirectZ_batch;
+  std::tie(directZ_batch, indirectZ_batch) = init_zero_padding_2d_batch<B>(S, oversample_ratio);
+  sopt::OperatorFunction<B> directFFT_batch, indirectFFT_batch;
+  std::tie(directFFT_batch, indirectFFT_batch) =
+      init_FFT_2d_batch<B>(imsizey, imsizex, oversample_ratio, ft_plan);
+  PURIFY_LOW_LOG("Constructing Weighting and Gridding Operators: WG");
+  PURIFY_MEDIUM_LOG("Number of visibilities: {}", u.size());
+  sopt::OperatorFunction<T> directG, indirectG;
+  sopt::OperatorFunction<B> directG_batch, indirectG_batch;
+  std::tie(directG, indirectG, directG_batch, indirectG_batch) =
+      init_gridding_matrix_2d_with_batch<T>(u, v, weights, imsizey, imsizex, oversample_ratio,
+                                            kernelv, kernelu, Ju, Jv);
+  auto direct = sopt::chained_operators<T>(directG, directFZ);
+  auto indirect = sopt::chained_operators<T>(indirectFZ, indirectG);
+  auto direct_batch = sopt::chained_operators<B>(
+      directG_batch, sopt::chained_operators<B>(directFFT_batch, directZ_batch));
+  auto indirect_batch = sopt::chained_operators<B>(
+      sopt::chained_operators<B>(indirectZ_batch, indirectFFT_batch), indirectG_batch);
+  PURIFY_LOW_LOG("Finished consturction of Φ.");
+  return std::make_tuple(direct, indirect, direct_batch, indirect_batch);
+}
+
+//! Applies a measurement operator to a batch one column at a time
+//! \details For operators that have no batched form, so that callers can always work on batches.
+template <class T>
+std::tuple<sopt::OperatorFunction<Matrix<typename T::Scalar>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>>
+init_batch_from_columns(const std::shared_ptr<sopt::LinearTransform<T> const> &measure_op) {
+  typedef Matrix<typename T::Scalar> B;
+  auto direct = [measure_op](B &output, const B &input) {
+    for (t_int j = 0; j < input.cols(); j++) {
+      const T column = *measure_op * input.col(j).eval();
+      if (j == 0) output = B::Zero(column.size(), input.cols());
+      output.col(j) = column;
+    }
+  };
+  auto indirect = [measure_op](B &output, const B &input) {
+    for (t_int j = 0; j < input.cols(); j++) {
+      const T column = measure_op->adjoint() * input.col(j).eval();
+      if (j == 0) output = B::Zero(column.size(), input.cols());
+      output.col(j) = column;
+    }
+  };
+  return std::make_tuple(direct, indirect);
+}
+}  // namespace operators
+
+namespace measurementoperator {
+
+//! Returns the standard degridding operator, and the operator and its adjoint on batches of
+//! vectors, which apply the same gridding matrix
+template <class T>
+std::tuple<std::shared_ptr<sopt::LinearTransform<T>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>>
+init_degrid_operator_2d_with_batch(const Vector<t_real> &u, const Vector<t_real> &v,
+                                   const Vector<t_real> &w, const Vector<t_complex> &weights,
+                                   const t_uint &imsizey, const t_uint &imsizex,
+                                   const t_real &oversample_ratio = 2,
+                                   const kernels::kernel kernel = kernels::kernel::kb,
+                                   const t_uint Ju = 4, const t_uint Jv = 4,
+                                   const bool w_stacking = false, const t_real &cellx = 1,
+                                   const t_real &celly = 1) {
+  const operators::fftw_plan ft_plan = operators::fftw_plan::measure;
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  std::array<t_int, 3> M = {0, 1, static_cast<t_int>(u.size())};
+  sopt::OperatorFunction<T> directDegrid, indirectDegrid;
+  sopt::OperatorFunction<Matrix<typename T::Scalar>> direct_batch, indirect_batch;
+  std::tie(directDegrid, indirectDegrid, direct_batch, indirect_batch) =
+      purify::operators::base_degrid_operator_2d_with_batch<T>(u, v, w, weights, imsizey, imsizex,
+                                                               oversample_ratio, kernel, Ju, Jv,
+                                                               ft_plan, w_stacking, cellx, celly);
+  return std::make_tuple(
+      std::make_shared<sopt::LinearTransform<T>>(directDegrid, M, indirectDegrid, N),
+      direct_batch, indirect_batch);
+}
+
+template <class T>
+std::tuple<std::shared_ptr<sopt::LinearTransform<T>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>>
+init_degrid_operator_2d_with_batch(const utilities::vis_params &uv_vis_input,
+                                   const t_uint &imsizey, const t_uint &imsizex,
+                                   const t_real &cell_x, const t_real &cell_y,
+                                   const t_real &oversample_ratio = 2,
+                                   const kernels::kernel kernel = kernels::kernel::kb,
+                                   const t_uint Ju = 4, const t_uint Jv = 4,
+                                   const bool w_stacking = false) {
+  const auto uv_vis = utilities::convert_to_pixels(uv_vis_input, cell_x, cell_y, imsizex, imsizey,
+                                                   oversample_ratio);
+  return init_degrid_operator_2d_with_batch<T>(uv_vis.u, uv_vis.v, uv_vis.w, uv_vis.weights,
+                                               imsizey, imsizex, oversample_ratio, kernel, Ju, Jv,
+                                               w_stacking, cell_x, cell_y);
+}
+
+#ifdef PURIFY_MPI
+//! Returns the degridding operator with mpi all sum all, and the operator and its adjoint on
+//! batches of vectors, which apply the same gridding matrix
+template <class T>
+std::tuple<std::shared_ptr<sopt::LinearTransform<T>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>>
+init_degrid_operator_2d_with_batch(const sopt::mpi::Communicator &comm,
+                                   const utilities::vis_params &uv_vis_input,
+                                   const t_uint &imsizey, const t_uint &imsizex,
+                                   const t_real &cell_x, const t_real &cell_y,
+                                   const t_real &oversample_ratio = 2,
+                                   const kernels::kernel kernel = kernels::kernel::kb,
+                                   const t_uint Ju = 4, const t_uint Jv = 4,
+                                   const bool w_stacking = false) {
+  typedef Matrix<typename T::Scalar> B;
+  const auto uv_vis = utilities::convert_to_pixels(uv_vis_input, cell_x, cell_y, imsizex, imsizey,
+                                                   oversample_ratio);
+  const operators::fftw_plan ft_plan = operators::fftw_plan::measure;
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  std::array<t_int, 3> M = {0, 1, static_cast<t_int>(uv_vis.size())};
+  sopt::OperatorFunction<T> directDegrid, indirectDegrid;
+  sopt::OperatorFunction<B> direct_batch, indirect_batch;
+  std::tie(directDegrid, indirectDegrid, direct_batch, indirect_batch) =
+      purify::operators::base_degrid_operator_2d_with_batch<T>(
+          uv_vis.u, uv_vis.v, uv_vis.w, uv_vis.weights, imsizey, imsizex, oversample_ratio,
+          kernel, Ju, Jv, ft_plan, w_stacking, cell_x, cell_y);
+  const auto allsumall = purify::operators::init_all_sum_all<T>(comm);
+  auto indirect = sopt::chained_operators<T>(allsumall, indirectDegrid);
+  // the columns of a batch are summed over the nodes in one reduction
+  auto indirect_sum = [indirect_batch, allsumall](B &output, const B &input) {
+    B local;
+    indirect_batch(local, input);
+    T sum;
+    allsumall(sum, T::Map(local.data(), local.size()).eval());
+    output = B::Map(sum.data(), local.rows(), local.cols());
+  };
+  return std::make_tuple(std::make_shared<sopt::LinearTransform<T>>(directDegrid, M, indirect, N),
+                         direct_batch, indirect_sum);
+}
+#endif
+}  // namespace measurementoperator
+}  // namespace purify
+#endif
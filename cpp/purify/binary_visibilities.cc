@@ -0,0 +1,254 @@
+#include "purify/binary_visibilities.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include "purify/logging.h"
+
+namespace purify {
+namespace utilities {
+namespace {
+const char file_magic[8] = {'P', 'U', 'R', 'I', 'F', 'Y', 'B', 'V'};
+const std::uint32_t file_version = 1;
+//! reads back as a different number on a machine with the other byte order
+const std::uint32_t file_byte_order = 0x01020304;
+const std::uint64_t column_alignment = 64;
+const std::uint32_t has_time = 1;
+const std::uint32_t has_baseline = 2;
+
+struct binary_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t flags;
+  std::int32_t units;
+  std::uint64_t size;
+  std::uint64_t frequencies;
+  double ra;
+  double dec;
+  double average_frequency;
+  double phase_centre_x;
+  double phase_centre_y;
+  char reserved[48];
+};
+static_assert(sizeof(binary_header) == 128, "Header of binary visibilities must be 128 bytes.");
+
+//! Byte offsets of the columns in a file
+struct column_offsets {
+  std::uint64_t u, v, w, vis, weights, time, baseline, frequencies, end;
+};
+
+std::uint64_t aligned(const std::uint64_t bytes) {
+  return ((bytes + column_alignment - 1) / column_alignment) * column_alignment;
+}
+
+column_offsets offsets(const binary_header &header) {
+  const std::uint64_t n = header.size;
+  column_offsets result;
+  result.u = sizeof(binary_header);
+  result.v = result.u + aligned(n * sizeof(t_real));
+  result.w = result.v + aligned(n * sizeof(t_real));
+  result.vis = result.w + aligned(n * sizeof(t_real));
+  result.weights = result.vis + aligned(n * sizeof(t_complex));
+  result.time = result.weights + aligned(n * sizeof(t_complex));
+  result.baseline =
+      result.time + ((header.flags & has_time) ? aligned(n * sizeof(t_real)) : 0);
+  result.frequencies =
+      result.baseline + ((header.flags & has_baseline) ? aligned(n * sizeof(std::uint64_t)) : 0);
+  result.end = result.frequencies + aligned(header.frequencies * sizeof(t_real));
+  return result;
+}
+
+//! Checks that the header is one this version of purify can read
+void check_header(const binary_header &header, const std::string &file_name) {
+  if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0)
+    throw std::runtime_error(file_name + " is not a binary visibility file.");
+  if (header.byte_order != file_byte_order)
+    throw std::runtime_error(file_name + " was written on a machine with a different byte order.");
+  if (header.version != file_version)
+    throw std::runtime_error(file_name + " has binary visibility version " +
+                             std::to_string(header.version) + ", but version " +
+                             std::to_string(file_version) + " is expected.");
+  if (header.units < static_cast<std::int32_t>(utilities::vis_units::lambda) or
+      header.units > static_cast<std::int32_t>(utilities::vis_units::pixels))
+    throw std::runtime_error(file_name + " has unknown units " + std::to_string(header.units));
+}
+
+//! Checks the header against the file, and returns it
+binary_header check_header(const char *data, const std::uint64_t length,
+                           const std::string &file_name) {
+  if (length < sizeof(binary_header))
+    throw std::runtime_error(file_name + " is too short to be binary visibilities.");
+  binary_header header;
+  std::memcpy(&header, data, sizeof(binary_header));
+  check_header(header, file_name);
+  if (offsets(header).end > length) throw std::runtime_error(file_name + " is truncated.");
+  return header;
+}
+
+//! Copies [start, start + count) of a mapped file to output, from position onwards
+void copy_columns(const char *data, const binary_header &header, const std::int64_t start,
+                  const std::int64_t count, utilities::vis_params &output,
+                  const std::int64_t position) {
+  const column_offsets columns = offsets(header);
+  const auto reals = [data, start, count](const std::uint64_t offset) {
+    return Eigen::Map<const Vector<t_real>>(
+        reinterpret_cast<const t_real *>(data + offset) + start, count);
+  };
+  const auto complexes = [data, start, count](const std::uint64_t offset) {
+    return Eigen::Map<const Vector<t_complex>>(
+        reinterpret_cast<const t_complex *>(data + offset) + start, count);
+  };
+  output.u.segment(position, count) = reals(columns.u);
+  output.v.segment(position, count) = reals(columns.v);
+  output.w.segment(position, count) = reals(columns.w);
+  output.vis.segment(position, count) = complexes(columns.vis);
+  output.weights.segment(position, count) = complexes(columns.weights);
+  if (output.time.size() > 0) output.time.segment(position, count) = reals(columns.time);
+  if (output.baseline.size() > 0)
+    output.baseline.segment(position, count) =
+        Eigen::Map<const Eigen::Matrix<std::uint64_t, Eigen::Dynamic, 1>>(
+            reinterpret_cast<const std::uint64_t *>(data + columns.baseline) + start, count)
+            .cast<t_uint>();
+}
+
+//! Allocates the columns and copies the metadata of the header
+utilities::vis_params allocate(const char *data, const binary_header &header,
+                               const std::int64_t size, const bool time, const bool baseline) {
+  utilities::vis_params output;
+  output.u = Vector<t_real>(size);
+  output.v = Vector<t_real>(size);
+  output.w = Vector<t_real>(size);
+  output.vis = Vector<t_complex>(size);
+  output.weights = Vector<t_complex>(size);
+  if (time) output.time = Vector<t_real>(size);
+  if (baseline) output.baseline = Vector<t_uint>(size);
+  output.frequencies = Eigen::Map<const Vector<t_real>>(
+      reinterpret_cast<const t_real *>(data + offsets(header).frequencies), header.frequencies);
+  output.units = static_cast<utilities::vis_units>(header.units);
+  output.ra = header.ra;
+  output.dec = header.dec;
+  output.average_frequency = header.average_frequency;
+  output.phase_centre_x = header.phase_centre_x;
+  output.phase_centre_y = header.phase_centre_y;
+  return output;
+}
+
+//! Writes the bytes of a column, padded to the column alignment
+void write_column(std::ofstream &out, const void *data, const std::uint64_t bytes) {
+  static const char padding[column_alignment] = {};
+  out.write(static_cast<const char *>(data), bytes);
+  out.write(padding, aligned(bytes) - bytes);
+}
+}  // namespace
+
+void write_binary_visibility(const utilities::vis_params &uv_vis, const std::string &file_name) {
+  const std::uint64_t n = uv_vis.u.size();
+  if (uv_vis.v.size() != n or uv_vis.w.size() != n or uv_vis.vis.size() != n or
+      uv_vis.weights.size() != n)
+    throw std::runtime_error("Columns of the visibilities do not have the same length.");
+  // the optional columns are either missing or complete
+  if ((uv_vis.time.size() != 0 and uv_vis.time.size() != n) or
+      (uv_vis.baseline.size() != 0 and uv_vis.baseline.size() != n))
+    throw std::runtime_error("Time or baseline of the visibilities do not have the same length.");
+  binary_header header;
+  std::memset(&header, 0, sizeof(binary_header));
+  std::memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.byte_order = file_byte_order;
+  header.flags = ((uv_vis.time.size() == n and n > 0) ? has_time : 0) |
+                 ((uv_vis.baseline.size() == n and n > 0) ? has_baseline : 0);
+  header.units = static_cast<std::int32_t>(uv_vis.units);
+  header.size = n;
+  header.frequencies = uv_vis.frequencies.size();
+  header.ra = uv_vis.ra;
+  header.dec = uv_vis.dec;
+  header.average_frequency = uv_vis.average_frequency;
+  header.phase_centre_x = uv_vis.phase_centre_x;
+  header.phase_centre_y = uv_vis.phase_centre_y;
+
+  std::ofstream out(file_name, std::ios::binary);
+  if (not out) throw std::runtime_error("Could not open " + file_name + " for writing.");
+  out.write(reinterpret_cast<const char *>(&header), sizeof(binary_header));
+  write_column(out, uv_vis.u.data(), n * sizeof(t_real));
+  write_column(out, uv_vis.v.data(), n * sizeof(t_real));
+  write_column(out, uv_vis.w.data(), n * sizeof(t_real));
+  write_column(out, uv_vis.vis.data(), n * sizeof(t_complex));
+  write_column(out, uv_vis.weights.data(), n * sizeof(t_complex));
+  if (header.flags & has_time) write_column(out, uv_vis.time.data(), n * sizeof(t_real));
+  if (header.flags & has_baseline) {
+    const Eigen::Matrix<std::uint64_t, Eigen::Dynamic, 1> baseline =
+        uv_vis.baseline.cast<std::uint64_t>();
+    write_column(out, baseline.data(), n * sizeof(std::uint64_t));
+  }
+  write_column(out, uv_vis.frequencies.data(), header.frequencies * sizeof(t_real));
+  out.close();
+  if (not out) throw std::runtime_error("Could not write binary visibilities to " + file_name);
+}
+
+std::int64_t binary_visibility_size(const std::string &file_name) {
+  std::ifstream in(file_name, std::ios::binary);
+  binary_header header;
+  if (not in.read(reinterpret_cast<char *>(&header), sizeof(binary_header)))
+    throw std::runtime_error("Could not read header of binary visibilities " + file_name);
+  check_header(header, file_name);
+  return header.size;
+}
+
+utilities::vis_params read_binary_visibility(const std::string &file_name,
+                                             const std::int64_t start, const std::int64_t count) {
+  std::uint64_t length = 0;
+  const auto data = map_file(file_name, length);
+  const binary_header header = check_header(data.get(), length, file_name);
+  if (start < 0 or count < 0 or start + count > header.size)
+    throw std::runtime_error("Visibilities [" + std::to_string(start) + ", " +
+                             std::to_string(start + count) + ") are not in " + file_name);
+  auto output = allocate(data.get(), header, count, header.flags & has_time,
+                         header.flags & has_baseline);
+  copy_columns(data.get(), header, start, count, output, 0);
+  return output;
+}
+
+utilities::vis_params read_binary_visibility(const std::string &file_name) {
+  return read_binary_visibility(file_name, 0, binary_visibility_size(file_name));
+}
+
+utilities::vis_params read_binary_visibility(const std::vector<std::string> &names) {
+  if (names.size() == 0) throw std::runtime_error("No binary visibility files to read.");
+  if (names.size() == 1) return read_binary_visibility(names.front());
+  std::vector<std::int64_t> sizes;
+  for (const auto &name : names) sizes.push_back(binary_visibility_size(name));
+  std::int64_t total = 0;
+  for (const auto size : sizes) total += size;
+  utilities::vis_params output;
+  std::int64_t position = 0;
+  for (t_int i = 0; i < names.size(); i++) {
+    std::uint64_t length = 0;
+    const auto data = map_file(names.at(i), length);
+    const binary_header header = check_header(data.get(), length, names.at(i));
+    if (i == 0)
+      output = allocate(data.get(), header, total, header.flags & has_time,
+                        header.flags & has_baseline);
+    else {
+      if (header.units != static_cast<std::int32_t>(output.units))
+        throw std::runtime_error(names.at(i) + " does not have the units of " + names.at(0));
+      if (std::abs(header.ra - output.ra) > 1e-6)
+        throw std::runtime_error(names.at(i) + ": wrong RA in pointing.");
+      if (std::abs(header.dec - output.dec) > 1e-6)
+        throw std::runtime_error(names.at(i) + ": wrong DEC in pointing.");
+      if (std::abs(header.average_frequency - output.average_frequency) >
+          1e-6 * std::abs(output.average_frequency))
+        throw std::runtime_error(names.at(i) + ": wrong frequency.");
+      // optional columns are only kept when all files have them
+      if (not(header.flags & has_time)) output.time = Vector<t_real>();
+      if (not(header.flags & has_baseline)) output.baseline = Vector<t_uint>();
+    }
+    copy_columns(data.get(), header, 0, sizes[i], output, position);
+    position += sizes[i];
+  }
+  PURIFY_MEDIUM_LOG("Read {} visibilities from {} binary files.", total, names.size());
+  return output;
+}
+}  // namespace utilities
+}  // namespace purify
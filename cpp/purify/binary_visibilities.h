@@ -0,0 +1,34 @@
+#ifndef PURIFY_BINARY_VISIBILITIES_H
+#define PURIFY_BINARY_VISIBILITIES_H
+
+#include "purify/config.h"
+#include "purify/types.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "purify/uvw_utilities.h"
+
+namespace purify {
+namespace utilities {
+//! \brief Binary visibility files (.bvis) that can be memory mapped
+//! \details A 128 byte header is followed by the columns u, v, w, vis, weights, the optional
+//! time and baseline columns, and the frequencies. Each column is stored contiguously in native
+//! byte order (checked on reading), starts at a multiple of 64 bytes, and complex values are
+//! stored as pairs of doubles. The coordinates are stored in the units of the vis_params, with
+//! no reflection applied.
+
+//! Writes visibilities to a binary file
+void write_binary_visibility(const utilities::vis_params &uv_vis, const std::string &file_name);
+//! Number of visibilities in a binary file, read from the header
+std::int64_t binary_visibility_size(const std::string &file_name);
+//! Reads the visibilities [start, start + count) of a binary file
+//! \details The file is memory mapped, so only the pages of the requested visibilities are read.
+utilities::vis_params read_binary_visibility(const std::string &file_name,
+                                             const std::int64_t start, const std::int64_t count);
+//! Reads a binary visibility file
+utilities::vis_params read_binary_visibility(const std::string &file_name);
+//! Reads binary visibility files into one set of visibilities, allocated once from the headers
+utilities::vis_params read_binary_visibility(const std::vector<std::string> &names);
+}  // namespace utilities
+}  // namespace purify
+#endif
@@ -24,6 +24,21 @@ MeasurementSet &MeasurementSet::filename(std::string const &filename) {
   return i_result->second;
 }
 
+MeasurementSet MeasurementSet::row_range(std::int64_t const first, std::int64_t const count) const {
+  std::ostringstream sstr;
+  // LIMIT 0 would select all rows
+  if (count > 0)
+    sstr << "SELECT FROM $1 LIMIT " << count << " OFFSET " << first;
+  else
+    sstr << "SELECT FROM $1 WHERE F";
+  auto const rows = ::casacore::tableCommand(sstr.str(), table()).table();
+  MeasurementSet result(filename());
+  // subtables that are already open are shared
+  *result.tables_ = *tables_;
+  (*result.tables_)[filename()] = rows;
+  return result;
+}
+
 std::size_t MeasurementSet::size() const {
   if (table().nrow() == 0) return 0;
   auto const column = array_column<::casacore::Double>("CHAN_FREQ", "SPECTRAL_WINDOW");
@@ -179,55 +194,41 @@ utilities::vis_params read_measurementset(std::string const &filename,
   uv.weights.segment(uv1.size(), uv2.size()) = uv2.weights;
   return uv;
 }
-utilities::vis_params read_measurementset(std::vector<std::string> const &filename,
-                                          const stokes pol, const std::vector<t_int> &channel,
-                                          std::string const &filter) {
-  utilities::vis_params output = read_measurementset(filename.at(0), pol, channel, filter);
-  if (filename.size() == 1) return output;
-  for (int i = 1; i < filename.size(); i++)
-    output = read_measurementset(filename.at(i), output, pol, channel, filter);
-  return output;
+namespace {
+//! Channels to read, which are all channels when none are given
+std::vector<t_int> channels_to_read(MeasurementSet const &ms_file,
+                                    const std::vector<t_int> &channels_input) {
+  if (not channels_input.empty()) return channels_input;
+  PURIFY_LOW_LOG("All Channels = {}", ms_file.size());
+  Vector<t_int> temp_vector = Vector<t_int>::LinSpaced(ms_file.size(), 0, ms_file.size());
+  if (temp_vector.size() == 1)  // fixing unwanted behavior of LinSpaced when ms_file.size() = 1
+    temp_vector(0) = 0;
+  return std::vector<t_int>(temp_vector.data(), temp_vector.data() + temp_vector.size());
 }
-utilities::vis_params read_measurementset(MeasurementSet const &ms_file, const stokes polarization,
-                                          const std::vector<t_int> &channels_input,
-                                          std::string const &filter) {
-  utilities::vis_params uv_data;
-  t_uint rows = 0;
-  std::vector<t_int> channels = channels_input;
-  if (channels.empty()) {
-    PURIFY_LOW_LOG("All Channels = {}", ms_file.size());
-    Vector<t_int> temp_vector = Vector<t_int>::LinSpaced(ms_file.size(), 0, ms_file.size());
-    if (temp_vector.size() == 1)  // fixing unwanted behavior of LinSpaced when ms_file.size() = 1
-      temp_vector(0) = 0;
-    channels = std::vector<t_int>(temp_vector.data(), temp_vector.data() + temp_vector.size());
-  }
 
-  // counting number of rows
-  for (auto channel_number : channels) {
-    rows += ms_file[channel_number].size();
-  }
-
-  PURIFY_LOW_LOG("Visibilities = {}", rows);
-  uv_data.u = Vector<t_real>::Zero(rows);
-  uv_data.v = Vector<t_real>::Zero(rows);
-  uv_data.w = Vector<t_real>::Zero(rows);
-  uv_data.vis = Vector<t_complex>::Zero(rows);
-  uv_data.weights = Vector<t_complex>::Zero(rows);
-  uv_data.ra =
-      ms_file[channels[0]].right_ascension();  // convert directions from radians to degrees
-  uv_data.dec = ms_file[channels[0]].declination();
-  // calculate average frequency
-  uv_data.average_frequency = average_frequency(ms_file, filter, channels);
-
-  // add data to channel
-  t_uint row = 0;
+//! Number of visibilities in the channels
+t_uint count_rows(MeasurementSet const &ms_file, const std::vector<t_int> &channels,
+                  std::string const &filter) {
+  t_uint rows = 0;
+  for (auto channel_number : channels)
+    if (channel_number < ms_file.size())
+      rows += ms_file[std::make_tuple(channel_number, filter)].size();
+  return rows;
+}
 
+//! Reads the channels into the rows of uv_data from first_row onwards
+void read_channels(MeasurementSet const &ms_file, const stokes polarization,
+                   const std::vector<t_int> &channels, std::string const &filter,
+                   utilities::vis_params &uv_data, const t_uint first_row) {
+  t_real const ra = ms_file[channels[0]].right_ascension();
+  t_real const dec = ms_file[channels[0]].declination();
+  t_uint row = first_row;
   for (auto channel_number : channels) {
     PURIFY_DEBUG("Adding channel {} to plane...", channel_number);
     if (channel_number < ms_file.size()) {
-      auto const channel = ms_file[channel_number];
+      auto const channel = ms_file[std::make_tuple(channel_number, filter)];
       if (channel.size() > 0) {
-        if (uv_data.ra != channel.right_ascension() or uv_data.dec != channel.declination())
+        if (ra != channel.right_ascension() or dec != channel.declination())
           throw std::runtime_error("Channels contain multiple pointings.");
         Vector<t_real> const frequencies = channel.frequencies();
         uv_data.u.segment(row, channel.size()) = channel.lambda_u();
@@ -324,10 +325,80 @@ utilities::vis_params read_measurementset(MeasurementSet const &ms_file, const s
     }
   }
   // make consistent with vis file format exported from casa
-  uv_data.weights = 1. / uv_data.weights.array();
+  uv_data.weights.segment(first_row, row - first_row) =
+      1. / uv_data.weights.segment(first_row, row - first_row).array();
+}
+
+//! Visibilities of the given size with the pointing and average frequency of a measurement set
+utilities::vis_params allocate(MeasurementSet const &ms_file, const std::vector<t_int> &channels,
+                               std::string const &filter, const t_uint rows) {
+  PURIFY_LOW_LOG("Visibilities = {}", rows);
+  utilities::vis_params uv_data;
+  uv_data.u = Vector<t_real>::Zero(rows);
+  uv_data.v = Vector<t_real>::Zero(rows);
+  uv_data.w = Vector<t_real>::Zero(rows);
+  uv_data.vis = Vector<t_complex>::Zero(rows);
+  uv_data.weights = Vector<t_complex>::Zero(rows);
+  uv_data.ra =
+      ms_file[channels[0]].right_ascension();  // convert directions from radians to degrees
+  uv_data.dec = ms_file[channels[0]].declination();
+  // calculate average frequency
+  uv_data.average_frequency = average_frequency(ms_file, filter, channels);
   uv_data.units = utilities::vis_units::lambda;
   return uv_data;
 }
+}  // namespace
+
+utilities::vis_params read_measurementset(std::vector<std::string> const &filename,
+                                          const stokes pol, const std::vector<t_int> &channel,
+                                          std::string const &filter) {
+  if (filename.size() == 1) return read_measurementset(filename.at(0), pol, channel, filter);
+  // the row counts of all files are found first, so that the output is allocated once
+  std::vector<MeasurementSet> ms_files;
+  std::vector<std::vector<t_int>> channels;
+  std::vector<t_uint> rows;
+  t_uint total = 0;
+  for (auto const &name : filename) {
+    ms_files.emplace_back(name);
+    channels.push_back(channels_to_read(ms_files.back(), channel));
+    rows.push_back(count_rows(ms_files.back(), channels.back(), filter));
+    total += rows.back();
+  }
+  auto uv_data = allocate(ms_files.at(0), channels.at(0), filter, total);
+  t_uint row = 0;
+  for (t_int i = 0; i < ms_files.size(); i++) {
+    if (i > 0) {
+      if (std::abs(uv_data.ra - ms_files[i][channels[i][0]].right_ascension()) > 1e-6)
+        throw std::runtime_error(filename.at(i) + ": wrong RA in pointing.");
+      if (std::abs(uv_data.dec - ms_files[i][channels[i][0]].declination()) > 1e-6)
+        throw std::runtime_error(filename.at(i) + ": wrong DEC in pointing.");
+    }
+    read_channels(ms_files[i], pol, channels[i], filter, uv_data, row);
+    row += rows[i];
+  }
+  return uv_data;
+}
+utilities::vis_params read_measurementset(MeasurementSet const &ms_file, const stokes polarization,
+                                          const std::vector<t_int> &channels_input,
+                                          std::string const &filter) {
+  const std::vector<t_int> channels = channels_to_read(ms_file, channels_input);
+  auto uv_data = allocate(ms_file, channels, filter, count_rows(ms_file, channels, filter));
+  read_channels(ms_file, polarization, channels, filter, uv_data, 0);
+  return uv_data;
+}
+
+std::int64_t measurementset_rows(std::string const &filename) {
+  return purify::casa::MeasurementSet(filename).table().nrow();
+}
+
+utilities::vis_params read_measurementset(std::string const &filename, const stokes polarization,
+                                          const std::int64_t first_row, const std::int64_t rows) {
+  MeasurementSet const ms_file(filename);
+  if (rows > 0)
+    return read_measurementset(ms_file.row_range(first_row, rows), polarization);
+  // nothing to read, but the pointing and frequency of the measurement set are still needed
+  return allocate(ms_file, channels_to_read(ms_file, std::vector<t_int>()), "", 0);
+}
 
 std::vector<utilities::vis_params> read_measurementset_channels(std::string const &filename,
                                                                 const stokes pol,
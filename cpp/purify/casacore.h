@@ -3,6 +3,7 @@
 
 #include "purify/config.h"
 #include "purify/types.h"
+#include <cstdint>
 #include <exception>
 #include <map>
 #include <memory>
@@ -47,6 +48,10 @@ class MeasurementSet {
 
   //! \brief Gets table or subtable
   ::casacore::Table const &table(std::string const &name = "") const;
+  //! \brief Measurement set with the rows [first, first + count) of the main table
+  //! \details The rows are selected once, so that the queries on the channels only go through
+  //! them. The subtables are those of the whole measurement set.
+  MeasurementSet row_range(std::int64_t const first, std::int64_t const count) const;
 
   //! Gets scalar column from table
   template <class T>
@@ -376,6 +381,14 @@ utilities::vis_params read_measurementset(std::vector<std::string> const &filena
                                           const std::vector<t_int> &channels = std::vector<t_int>(),
                                           std::string const &filter = "");
 
+//! Number of rows in the main table of a measurement set
+std::int64_t measurementset_rows(std::string const &filename);
+//! Read the rows [first_row, first_row + rows) of the main table of a measurement set
+//! \details Each row gives one visibility in each channel that is not flagged, so that nodes can
+//! read their own share of one measurement set.
+utilities::vis_params read_measurementset(std::string const &filename, const stokes pol,
+                                          const std::int64_t first_row, const std::int64_t rows);
+
 //! Return average frequency over channels
 t_real average_frequency(const purify::casa::MeasurementSet &ms_file, std::string const &filter,
                          const std::vector<t_int> &channels);
@@ -1,4 +1,9 @@
 #include "purify/distribute.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <set>
+#include "purify/utilities.h"
 #include "purify/wide_field_utilities.h"
 
 namespace purify {
@@ -34,6 +39,13 @@ std::vector<t_int> distribute_measurements(Vector<t_real> const &u, Vector<t_rea
     plan_name = "w_term";
     break;
   }
+  case plan::bisection:
+  case plan::bisection_w: {
+    PURIFY_DEBUG("Using bisection to make {} partitions from {} visibilities.", number_of_nodes,
+                 u.size());
+    return bisection_distribution(u, v, w, number_of_nodes, Vector<t_real>(),
+                                  (distribution_plan == plan::bisection_w) ? 1. : 0.);
+  }
   default: {
     throw std::runtime_error("Distribution plan not recognised or implimented.");
     break;
@@ -98,6 +110,236 @@ Vector<t_int> equal_distribution(Vector<t_real> const &u, Vector<t_real> const &
             });
   return index;
 }
+namespace {
+//! Cuts the visibilities in [first, last) into nodes groups, starting from first_node
+void bisect(Vector<t_real> const &u, Vector<t_real> const &v, Vector<t_real> const &w,
+            Vector<t_real> const &cost, t_real const w_scale, std::vector<t_int>::iterator first,
+            std::vector<t_int>::iterator last, t_int const first_node, t_int const nodes,
+            std::vector<t_int> &groups) {
+  if (nodes < 2 or first == last) {
+    for (auto i = first; i != last; ++i) groups[*i] = first_node;
+    return;
+  }
+  const auto coordinate = [&u, &v, &w, w_scale](t_int const axis, t_int const i) -> t_real {
+    return (axis == 0) ? u(i) : ((axis == 1) ? v(i) : w(i) * w_scale);
+  };
+  // cut across the widest extent
+  t_int axis = 0;
+  t_real widest = -1;
+  for (t_int a = 0; a < 3; a++) {
+    const auto range = std::minmax_element(first, last, [&coordinate, a](t_int i, t_int j) {
+      return coordinate(a, i) < coordinate(a, j);
+    });
+    const t_real extent = coordinate(a, *range.second) - coordinate(a, *range.first);
+    if (extent > widest) {
+      widest = extent;
+      axis = a;
+    }
+  }
+  std::sort(first, last, [&coordinate, axis](t_int i, t_int j) {
+    return coordinate(axis, i) < coordinate(axis, j);
+  });
+  // the left side gets a share of the cost in proportion to its nodes
+  const t_int left_nodes = nodes / 2;
+  t_real total = 0;
+  for (auto i = first; i != last; ++i) total += cost(*i);
+  const t_real target = total * static_cast<t_real>(left_nodes) / static_cast<t_real>(nodes);
+  auto cut = first;
+  t_real sum = 0;
+  while (cut != last and sum + 0.5 * cost(*cut) < target) sum += cost(*(cut++));
+  bisect(u, v, w, cost, w_scale, first, cut, first_node, left_nodes, groups);
+  bisect(u, v, w, cost, w_scale, cut, last, first_node + left_nodes, nodes - left_nodes, groups);
+}
+}  // namespace
+
+std::vector<t_int> bisection_distribution(Vector<t_real> const &u, Vector<t_real> const &v,
+                                          Vector<t_real> const &w, t_int const number_of_nodes,
+                                          Vector<t_real> const &cost, t_real const w_scale) {
+  if (cost.size() != 0 and cost.size() != u.size())
+    throw std::runtime_error("Cost of bisection does not match the number of visibilities.");
+  std::vector<t_int> index(u.size());
+  std::iota(index.begin(), index.end(), 0);
+  std::vector<t_int> groups(u.size(), 0);
+  bisect(u, v, w, (cost.size() == u.size()) ? cost : Vector<t_real>::Ones(u.size()).eval(),
+         w_scale, index.begin(), index.end(), 0, number_of_nodes, groups);
+  return groups;
+}
+
+Vector<t_real> w_support_cost(Vector<t_real> const &w, t_real const du, t_int const min_support,
+                              t_int const max_support) {
+  Vector<t_real> cost(w.size());
+#pragma omp parallel for
+  for (t_int i = 0; i < w.size(); i++) {
+    const t_int support = widefield::w_support(w(i), du, min_support, max_support);
+    cost(i) = support * support;
+  }
+  return cost;
+}
+
+std::tuple<std::vector<t_int>, std::vector<t_int>> grid_footprint(
+    Vector<t_real> const &u, Vector<t_real> const &v, std::vector<t_int> const &groups,
+    t_int const number_of_nodes, t_int const ftsizev, t_int const ftsizeu, t_int const Jv,
+    t_int const Ju) {
+  // the nodes that touch each cell, -1 for none and number_of_nodes for more than one
+  Vector<t_int> owner = Vector<t_int>::Constant(ftsizev * ftsizeu, -1);
+  std::vector<std::set<t_int>> cells(number_of_nodes);
+  for (t_int m = 0; m < u.size(); m++) {
+    const t_int ku = std::floor(u(m) - Ju * 0.5);
+    const t_int kv = std::floor(v(m) - Jv * 0.5);
+    for (t_int ju = 1; ju < Ju + 1; ++ju)
+      for (t_int jv = 1; jv < Jv + 1; ++jv) {
+        const t_int q = utilities::mod(ku + ju, ftsizeu);
+        const t_int p = utilities::mod(kv + jv, ftsizev);
+        const t_int index = utilities::sub2ind(p, q, ftsizev, ftsizeu);
+        cells[groups[m]].insert(index);
+        if (owner(index) == -1)
+          owner(index) = groups[m];
+        else if (owner(index) != groups[m])
+          owner(index) = number_of_nodes;
+      }
+  }
+  std::vector<t_int> touched(number_of_nodes, 0);
+  std::vector<t_int> shared(number_of_nodes, 0);
+  for (t_int n = 0; n < number_of_nodes; n++) {
+    touched[n] = cells[n].size();
+    for (auto const index : cells[n])
+      if (owner(index) == number_of_nodes) shared[n]++;
+  }
+  return std::make_tuple(touched, shared);
+}
+
+namespace {
+//! Assigns each w to the centre of least cost, taking the lowest node when costs are equal
+//! \details The cost has to increase with |w - centre|, so that only the two centres either side
+//! of w are candidates. These are found by a binary search over the sorted centres.
+void assign_to_centres(const Vector<t_real> &w, const std::vector<t_real> &w_centre,
+                       const std::function<t_real(t_real)> &cost, const t_real max_cost,
+                       std::vector<t_int> &w_node) {
+  std::vector<t_int> order(w_centre.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&w_centre](t_int a, t_int b) {
+    return (w_centre[a] < w_centre[b]) or (w_centre[a] == w_centre[b] and a < b);
+  });
+  std::vector<t_real> sorted(w_centre.size());
+  for (t_int j = 0; j < order.size(); j++) sorted[j] = w_centre[order[j]];
+#pragma omp parallel for
+  for (t_int i = 0; i < w.size(); i++) {
+    const t_int upper = std::lower_bound(sorted.begin(), sorted.end(), w(i)) - sorted.begin();
+    t_real min = max_cost;
+    for (const t_int candidate : {upper - 1, upper}) {
+      if (candidate < 0 or candidate >= static_cast<t_int>(sorted.size())) continue;
+      // first of the centres with the same value has the lowest node
+      const t_int first =
+          std::lower_bound(sorted.begin(), sorted.end(), sorted[candidate]) - sorted.begin();
+      const t_real cost_val = cost(w(i) - sorted[first]);
+      if (cost_val < min or (cost_val == min and min < max_cost and order[first] < w_node[i])) {
+        min = cost_val;
+        w_node[i] = order[first];
+      }
+    }
+  }
+}
+
+//! Optimal partition of bins into contiguous clusters under the squared distance to the mean
+//! \details Dynamic programming over the bins, where the best split for each bin is found by
+//! divide and conquer, as the best split does not decrease with the bin. Returns the cluster of
+//! each bin.
+std::vector<t_int> optimal_bin_clusters(const Vector<t_real> &counts, const Vector<t_real> &sums,
+                                        const Vector<t_real> &squares, const t_int clusters) {
+  const t_int bins = counts.size();
+  // prefix sums, so that the cost of a cluster of bins is found in constant time
+  Vector<t_real> C = Vector<t_real>::Zero(bins + 1);
+  Vector<t_real> S = Vector<t_real>::Zero(bins + 1);
+  Vector<t_real> Q = Vector<t_real>::Zero(bins + 1);
+  for (t_int b = 0; b < bins; b++) {
+    C(b + 1) = C(b) + counts(b);
+    S(b + 1) = S(b) + sums(b);
+    Q(b + 1) = Q(b) + squares(b);
+  }
+  // cost of the cluster holding bins [a, b)
+  const auto sse = [&C, &S, &Q](const t_int a, const t_int b) -> t_real {
+    const t_real n = C(b) - C(a);
+    if (n <= 0) return 0;
+    const t_real s = S(b) - S(a);
+    return std::max<t_real>(0, Q(b) - Q(a) - s * s / n);
+  };
+  // cost of the first bins [0, b) in k + 1 clusters, and where the last cluster starts
+  std::vector<t_real> previous(bins + 1), current(bins + 1);
+  std::vector<std::vector<t_int>> start(clusters, std::vector<t_int>(bins + 1, 0));
+  for (t_int b = 0; b <= bins; b++) previous[b] = sse(0, b);
+  for (t_int k = 1; k < clusters; k++) {
+    const std::function<void(t_int, t_int, t_int, t_int)> solve =
+        [&](const t_int lo, const t_int hi, const t_int opt_lo, const t_int opt_hi) {
+          if (lo > hi) return;
+          const t_int b = (lo + hi) / 2;
+          t_real best = std::numeric_limits<t_real>::max();
+          t_int best_a = opt_lo;
+          for (t_int a = opt_lo; a <= std::min(b, opt_hi); a++) {
+            const t_real value = previous[a] + sse(a, b);
+            if (value < best) {
+              best = value;
+              best_a = a;
+            }
+          }
+          current[b] = best;
+          start[k][b] = best_a;
+          solve(lo, b - 1, opt_lo, best_a);
+          solve(b + 1, hi, best_a, opt_hi);
+        };
+    solve(0, bins, 0, bins);
+    std::swap(previous, current);
+  }
+  std::vector<t_int> cluster(bins, 0);
+  t_int end = bins;
+  for (t_int k = clusters - 1; k > 0; k--) {
+    const t_int a = start[k][end];
+    for (t_int b = a; b < end; b++) cluster[b] = k;
+    end = a;
+  }
+  return cluster;
+}
+
+//! Histogram of the counts, sums and sums of squares of w in bins between wmin and wmax
+Vector<t_real> w_histogram(const Vector<t_real> &w, const t_real wmin, const t_real wmax,
+                           const t_int bins, std::vector<t_int> &bin) {
+  Vector<t_real> histogram = Vector<t_real>::Zero(3 * bins);
+  bin.resize(w.size());
+  for (t_int i = 0; i < w.size(); i++) {
+    bin[i] = (wmax > wmin)
+                 ? std::min<t_int>(bins - 1, std::floor((w(i) - wmin) / (wmax - wmin) * bins))
+                 : 0;
+    histogram(bin[i]) += 1;
+    histogram(bins + bin[i]) += w(i);
+    histogram(2 * bins + bin[i]) += w(i) * w(i);
+  }
+  return histogram;
+}
+
+//! Clusters of w and their means from the global histogram
+std::tuple<std::vector<t_int>, std::vector<t_real>> clusters_from_histogram(
+    const Vector<t_real> &histogram, const std::vector<t_int> &bin, const t_int number_of_nodes) {
+  const t_int bins = histogram.size() / 3;
+  const std::vector<t_int> cluster =
+      optimal_bin_clusters(histogram.segment(0, bins), histogram.segment(bins, bins),
+                           histogram.segment(2 * bins, bins), number_of_nodes);
+  std::vector<t_real> w_sum(number_of_nodes, 0);
+  std::vector<t_real> w_count(number_of_nodes, 0);
+  for (t_int b = 0; b < bins; b++) {
+    w_count[cluster[b]] += histogram(b);
+    w_sum[cluster[b]] += histogram(bins + b);
+  }
+  std::vector<t_real> w_centre(number_of_nodes, 0);
+  for (t_int j = 0; j < number_of_nodes; j++) {
+    w_centre[j] = (w_count.at(j) > 0) ? w_sum.at(j) / w_count.at(j) : 0;
+    PURIFY_DEBUG("Node {} has {} visibilities, using w-stack w = {}.", j, w_count.at(j),
+                 w_centre.at(j));
+  }
+  std::vector<t_int> w_node(bin.size());
+  for (t_int i = 0; i < bin.size(); i++) w_node[i] = cluster[bin[i]];
+  return std::make_tuple(w_node, w_centre);
+}
+}  // namespace
+
 std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
     const Vector<t_real> &w, const t_int number_of_nodes, const t_int iters,
     const std::function<t_real(t_real)> &cost, const t_real rel_diff) {
@@ -115,15 +357,8 @@ std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
   // lopp through even nodes to reduces w-term
   for (int n = 0; n < iters; n++) {
     PURIFY_DEBUG("clustering iteration {}", n);
+    assign_to_centres(w, w_centre, cost, 2 * cost(wmax - wmin), w_node);
     for (int i = 0; i < w.size(); i++) {
-      t_real min = 2 * cost(wmax - wmin);
-      for (int node = 0; node < number_of_nodes; node++) {
-        const t_real cost_val = cost(w(i) - w_centre.at(node));
-        if (cost_val < min) {
-          min = cost_val;
-          w_node[i] = node;
-        }
-      }
       w_sum[w_node.at(i)] += w(i);
       w_count[w_node.at(i)]++;
     }
@@ -147,18 +382,240 @@ std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
 
   return std::make_tuple(w_node, w_centre);
 }
+
+std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_optimal(const Vector<t_real> &w,
+                                                                   const t_int number_of_nodes,
+                                                                   const t_int bins) {
+  const t_int number_of_bins = std::max(bins, number_of_nodes);
+  std::vector<t_int> bin;
+  const Vector<t_real> histogram =
+      w_histogram(w, w.minCoeff(), w.maxCoeff(), number_of_bins, bin);
+  return clusters_from_histogram(histogram, bin, number_of_nodes);
+}
 #ifdef PURIFY_MPI
+std::vector<t_int> distribute_measurements_parallel(utilities::vis_params const &params,
+                                                    sopt::mpi::Communicator const &comm,
+                                                    distribute::plan const distribution_plan,
+                                                    t_int const &grid_size, t_int const bins,
+                                                    Vector<t_real> const &cost) {
+  const t_int local_size = params.size();
+  if (distribution_plan == plan::bisection or distribution_plan == plan::bisection_w)
+    return bisection_distribution(params.u, params.v, params.w, comm, cost,
+                                  (distribution_plan == plan::bisection_w) ? 1. : 0., bins);
+  // key that orders the visibilities for the plan
+  Vector<t_real> key = Vector<t_real>::Zero(local_size);
+  switch (distribution_plan) {
+  case plan::none:
+    break;
+  case plan::equal: {
+    const t_real min_u = comm.all_reduce<t_real>(
+        (local_size > 0) ? params.u.minCoeff() : std::numeric_limits<t_real>::max(), MPI_MIN);
+    const t_real max_u = comm.all_reduce<t_real>(
+        (local_size > 0) ? params.u.maxCoeff() : std::numeric_limits<t_real>::lowest(), MPI_MAX);
+    const t_real min_v = comm.all_reduce<t_real>(
+        (local_size > 0) ? params.v.minCoeff() : std::numeric_limits<t_real>::max(), MPI_MIN);
+    const t_real max_v = comm.all_reduce<t_real>(
+        (local_size > 0) ? params.v.maxCoeff() : std::numeric_limits<t_real>::lowest(), MPI_MAX);
+    const Vector<t_real> scaled_u = (params.u.array() - min_u) * (grid_size - 1) / (max_u - min_u);
+    const Vector<t_real> scaled_v = (params.v.array() - min_v) * (grid_size - 1) / (max_v - min_v);
+    Vector<t_int> histogram = Vector<t_int>::Zero(grid_size * grid_size);
+    for (t_int i = 0; i < local_size; i++)
+      histogram(std::floor(scaled_u(i)) * grid_size + std::floor(scaled_v(i))) += 1;
+    histogram = comm.all_sum_all<Vector<t_int>>(histogram);
+    for (t_int i = 0; i < local_size; i++)
+      key(i) = histogram(std::floor(scaled_u(i)) * grid_size + std::floor(scaled_v(i)));
+    break;
+  }
+  case plan::radial:
+    key = (params.u.array().square() + params.v.array().square()).sqrt();
+    break;
+  case plan::w_term:
+    key = params.w;
+    break;
+  default:
+    throw std::runtime_error("Distribution plan not recognised or implimented.");
+  }
+  const t_real key_min = comm.all_reduce<t_real>(
+      (local_size > 0) ? key.minCoeff() : std::numeric_limits<t_real>::max(), MPI_MIN);
+  const t_real key_max = comm.all_reduce<t_real>(
+      (local_size > 0) ? key.maxCoeff() : std::numeric_limits<t_real>::lowest(), MPI_MAX);
+  if (cost.size() != 0 and cost.size() != local_size)
+    throw std::runtime_error("Cost of distribution does not match the number of visibilities.");
+  const Vector<t_real> weight =
+      (cost.size() == local_size) ? cost : Vector<t_real>::Ones(local_size).eval();
+  const t_int number_of_bins = (key_max > key_min) ? bins : 1;
+  std::vector<t_int> bin(local_size, 0);
+  // cost of the visibilities in each bin, which is their number without a cost
+  std::vector<t_real> counts(number_of_bins, 0);
+  for (t_int i = 0; i < local_size; i++) {
+    if (number_of_bins > 1)
+      bin[i] = std::min<t_int>(
+          number_of_bins - 1,
+          std::floor((key(i) - key_min) / (key_max - key_min) * number_of_bins));
+    counts[bin[i]] += weight(i);
+  }
+  // cost in each bin on the nodes before this one, and in total
+  std::vector<t_real> offsets(number_of_bins, 0);
+  MPI_Exscan(counts.data(), offsets.data(), number_of_bins, MPI_DOUBLE, MPI_SUM, *comm);
+  if (comm.rank() == 0) std::fill(offsets.begin(), offsets.end(), 0);
+  MPI_Allreduce(MPI_IN_PLACE, counts.data(), number_of_bins, MPI_DOUBLE, MPI_SUM, *comm);
+  std::vector<t_real> bin_starts(number_of_bins, 0);
+  for (t_int b = 1; b < number_of_bins; b++) bin_starts[b] = bin_starts[b - 1] + counts[b - 1];
+  const t_real total = bin_starts.back() + counts.back();
+  PURIFY_DEBUG("Using {} bins to make {} partitions from visibilities of cost {}.",
+               number_of_bins, comm.size(), total);
+  std::vector<t_int> groups(local_size, 0);
+  if (total <= 0) return groups;
+  for (t_int i = 0; i < local_size; i++) {
+    const t_real position = bin_starts[bin[i]] + offsets[bin[i]];
+    offsets[bin[i]] += weight(i);
+    groups[i] = std::min<t_int>(comm.size() - 1, std::floor((position * comm.size()) / total));
+  }
+  return groups;
+}
+
+std::vector<t_int> bisection_distribution(Vector<t_real> const &u, Vector<t_real> const &v,
+                                          Vector<t_real> const &w,
+                                          sopt::mpi::Communicator const &comm,
+                                          Vector<t_real> const &cost, t_real const w_scale,
+                                          t_int const bins) {
+  const t_int local_size = u.size();
+  if (cost.size() != 0 and cost.size() != local_size)
+    throw std::runtime_error("Cost of bisection does not match the number of visibilities.");
+  const Vector<t_real> weight =
+      (cost.size() == local_size) ? cost : Vector<t_real>::Ones(local_size).eval();
+  const auto coordinate = [&u, &v, &w, w_scale](t_int const axis, t_int const i) -> t_real {
+    return (axis == 0) ? u(i) : ((axis == 1) ? v(i) : w(i) * w_scale);
+  };
+  // each visibility is in the group starting at its node, and group_nodes holds the number of
+  // nodes of each group
+  std::vector<t_int> groups(local_size, 0);
+  std::vector<t_int> group_nodes(comm.size(), 0);
+  group_nodes[0] = comm.size();
+  while (true) {
+    // groups still to be cut on this level
+    std::vector<t_int> slot(comm.size(), -1);
+    std::vector<t_int> cut_groups;
+    for (t_int n = 0; n < comm.size(); n++)
+      if (group_nodes[n] > 1) {
+        slot[n] = cut_groups.size();
+        cut_groups.push_back(n);
+      }
+    if (cut_groups.empty()) break;
+    const t_int number_of_groups = cut_groups.size();
+    Vector<t_real> lower =
+        Vector<t_real>::Constant(3 * number_of_groups, std::numeric_limits<t_real>::max());
+    Vector<t_real> upper =
+        Vector<t_real>::Constant(3 * number_of_groups, std::numeric_limits<t_real>::lowest());
+    for (t_int i = 0; i < local_size; i++) {
+      const t_int s = slot[groups[i]];
+      if (s < 0) continue;
+      for (t_int a = 0; a < 3; a++) {
+        lower(3 * s + a) = std::min(lower(3 * s + a), coordinate(a, i));
+        upper(3 * s + a) = std::max(upper(3 * s + a), coordinate(a, i));
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, lower.data(), lower.size(), sopt::mpi::Type<t_real>::value,
+                  MPI_MIN, *comm);
+    MPI_Allreduce(MPI_IN_PLACE, upper.data(), upper.size(), sopt::mpi::Type<t_real>::value,
+                  MPI_MAX, *comm);
+    // cut across the widest extent of each group
+    std::vector<t_int> axis(number_of_groups, 0);
+    for (t_int s = 0; s < number_of_groups; s++)
+      for (t_int a = 1; a < 3; a++)
+        if (upper(3 * s + a) - lower(3 * s + a) >
+            upper(3 * s + axis[s]) - lower(3 * s + axis[s]))
+          axis[s] = a;
+    const t_int group_bins = std::max<t_int>(256, bins / number_of_groups);
+    std::vector<t_int> bin(local_size, 0);
+    Vector<t_real> histogram = Vector<t_real>::Zero(number_of_groups * group_bins);
+    for (t_int i = 0; i < local_size; i++) {
+      const t_int s = slot[groups[i]];
+      if (s < 0) continue;
+      const t_real extent = upper(3 * s + axis[s]) - lower(3 * s + axis[s]);
+      if (extent > 0)
+        bin[i] = std::min<t_int>(
+            group_bins - 1,
+            std::floor((coordinate(axis[s], i) - lower(3 * s + axis[s])) / extent * group_bins));
+      histogram(s * group_bins + bin[i]) += weight(i);
+    }
+    histogram = comm.all_sum_all<Vector<t_real>>(histogram);
+    // the left side gets a share of the cost in proportion to its nodes
+    std::vector<t_int> cut(number_of_groups, 0);
+    for (t_int s = 0; s < number_of_groups; s++) {
+      const t_int nodes = group_nodes[cut_groups[s]];
+      const t_real target = histogram.segment(s * group_bins, group_bins).sum() *
+                            static_cast<t_real>(nodes / 2) / static_cast<t_real>(nodes);
+      t_real sum = 0;
+      while (cut[s] < group_bins and sum + 0.5 * histogram(s * group_bins + cut[s]) < target)
+        sum += histogram(s * group_bins + cut[s]++);
+    }
+    for (t_int i = 0; i < local_size; i++) {
+      const t_int s = slot[groups[i]];
+      if (s >= 0 and bin[i] >= cut[s]) groups[i] += group_nodes[cut_groups[s]] / 2;
+    }
+    for (auto const n : cut_groups) {
+      group_nodes[n + group_nodes[n] / 2] = group_nodes[n] - group_nodes[n] / 2;
+      group_nodes[n] /= 2;
+    }
+  }
+  return groups;
+}
+
+std::tuple<t_int, t_int> grid_footprint(Vector<t_real> const &u, Vector<t_real> const &v,
+                                        sopt::mpi::Communicator const &comm, t_int const ftsizev,
+                                        t_int const ftsizeu, t_int const Jv, t_int const Ju) {
+  std::vector<t_int> cells;
+  cells.reserve(u.size() * Ju * Jv);
+  for (t_int m = 0; m < u.size(); m++) {
+    const t_int ku = std::floor(u(m) - Ju * 0.5);
+    const t_int kv = std::floor(v(m) - Jv * 0.5);
+    for (t_int ju = 1; ju < Ju + 1; ++ju)
+      for (t_int jv = 1; jv < Jv + 1; ++jv) {
+        const t_int q = utilities::mod(ku + ju, ftsizeu);
+        const t_int p = utilities::mod(kv + jv, ftsizev);
+        cells.push_back(utilities::sub2ind(p, q, ftsizev, ftsizeu));
+      }
+  }
+  std::sort(cells.begin(), cells.end());
+  cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+  // send each cell to the node that counts it
+  std::vector<t_int> send_sizes(comm.size(), 0);
+  for (auto const cell : cells) send_sizes[cell % comm.size()]++;
+  std::vector<t_int> offsets(comm.size(), 0);
+  for (t_int n = 1; n < comm.size(); n++) offsets[n] = offsets[n - 1] + send_sizes[n - 1];
+  std::vector<t_int> send(cells.size());
+  for (auto const cell : cells) send[offsets[cell % comm.size()]++] = cell;
+  const std::vector<t_int> recv_sizes =
+      comm.all_to_allv<t_int>(send_sizes, std::vector<t_int>(comm.size(), 1));
+  const std::vector<t_int> received = comm.all_to_allv<t_int>(send, send_sizes);
+  // a node sends a cell at most once, so cells received more than once are shared
+  std::vector<t_int> sorted = received;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<t_int> shared_by_node(comm.size(), 0);
+  t_int index = 0;
+  for (t_int n = 0; n < comm.size(); n++)
+    for (t_int i = 0; i < recv_sizes[n]; i++, index++) {
+      const auto range = std::equal_range(sorted.begin(), sorted.end(), received[index]);
+      if (range.second - range.first > 1) shared_by_node[n]++;
+    }
+  const std::vector<t_int> shared =
+      comm.all_to_allv<t_int>(shared_by_node, std::vector<t_int>(comm.size(), 1));
+  return std::make_tuple(static_cast<t_int>(cells.size()),
+                         std::accumulate(shared.begin(), shared.end(), 0));
+}
+
 std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
     const Vector<t_real> &w, const t_int number_of_nodes, const t_int iters,
     sopt::mpi::Communicator const &comm, const std::function<t_real(t_real)> &cost,
     const t_real rel_diff) {
   std::vector<t_int> w_node(w.size(), 0);
   std::vector<t_real> w_centre(number_of_nodes, 0);
-  std::vector<t_real> w_sum(number_of_nodes, 0);
-  std::vector<t_real> w_count(number_of_nodes, 0);
   t_real diff = 1;
-  t_real const wmin = comm.all_reduce<t_real>(w.minCoeff(), MPI_MIN);
-  t_real const wmax = comm.all_reduce<t_real>(w.maxCoeff(), MPI_MAX);
+  t_real const wmin = comm.all_reduce<t_real>(
+      (w.size() > 0) ? w.minCoeff() : std::numeric_limits<t_real>::max(), MPI_MIN);
+  t_real const wmax = comm.all_reduce<t_real>(
+      (w.size() > 0) ? w.maxCoeff() : std::numeric_limits<t_real>::lowest(), MPI_MAX);
   if (comm.is_root()) PURIFY_DEBUG("Min w = {}", wmin);
   if (comm.is_root()) PURIFY_DEBUG("Max w = {}", wmax);
   for (int i = 0; i < w_centre.size(); i++)
@@ -167,21 +624,17 @@ std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
   // lopp through even nodes to reduces w-term
   for (int n = 0; n < iters; n++) {
     if (comm.is_root()) PURIFY_DEBUG("clustering iteration {}", n);
+    assign_to_centres(w, w_centre, cost, 2 * cost(wmax - wmin), w_node);
+    // sums of w followed by counts, reduced together
+    Vector<t_real> w_sum_count = Vector<t_real>::Zero(2 * number_of_nodes);
     for (int i = 0; i < w.size(); i++) {
-      t_real min = 2 * cost(wmax - wmin);
-      for (int node = 0; node < number_of_nodes; node++) {
-        const t_real cost_val = cost(w(i) - w_centre.at(node));
-        if (cost_val < min) {
-          min = cost_val;
-          w_node[i] = node;
-        }
-      }
-      w_sum[w_node.at(i)] += w(i);
-      w_count[w_node.at(i)]++;
+      w_sum_count(w_node.at(i)) += w(i);
+      w_sum_count(number_of_nodes + w_node.at(i))++;
     }
+    w_sum_count = comm.all_sum_all<Vector<t_real>>(w_sum_count);
     for (int j = 0; j < number_of_nodes; j++) {
-      const t_real global_w_sum = comm.all_sum_all<t_real>(w_sum.at(j));
-      const t_real global_w_count = comm.all_sum_all<t_real>(w_count.at(j));
+      const t_real global_w_sum = w_sum_count(j);
+      const t_real global_w_count = w_sum_count(number_of_nodes + j);
       diff +=
           std::abs(((global_w_count > 0) ? global_w_sum / global_w_count : 0) - w_centre.at(j)) /
           std::abs(w_centre.at(j) * number_of_nodes);
@@ -189,8 +642,6 @@ std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
       if (comm.is_root())
         PURIFY_DEBUG("Node {} has {} visibilities, using w-stack w = {}.", j, global_w_count,
                      w_centre.at(j));
-      w_sum[j] = 0;
-      w_count[j] = 0;
     }
     if (diff < rel_diff) {
       if (comm.is_root()) PURIFY_DEBUG("Converged!");
@@ -204,57 +655,56 @@ std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
   return std::make_tuple(w_node, w_centre);
 }
 
+std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_optimal(
+    const Vector<t_real> &w, const t_int number_of_nodes, sopt::mpi::Communicator const &comm,
+    const t_int bins) {
+  const t_int number_of_bins = std::max(bins, number_of_nodes);
+  t_real const wmin = comm.all_reduce<t_real>(
+      (w.size() > 0) ? w.minCoeff() : std::numeric_limits<t_real>::max(), MPI_MIN);
+  t_real const wmax = comm.all_reduce<t_real>(
+      (w.size() > 0) ? w.maxCoeff() : std::numeric_limits<t_real>::lowest(), MPI_MAX);
+  std::vector<t_int> bin;
+  const Vector<t_real> histogram = comm.all_sum_all<Vector<t_real>>(
+      w_histogram(w, wmin, wmax, number_of_bins, bin));
+  return clusters_from_histogram(histogram, bin, number_of_nodes);
+}
+
 std::vector<t_int> w_support(Vector<t_real> const &w, const std::vector<t_int> &image_index,
                              const std::vector<t_real> &w_stacks, const t_real du,
                              const t_int min_support, const t_int max_support,
-                             const t_real fill_relaxation, sopt::mpi::Communicator const &comm) {
-  t_real coeff_total = 0;
+                             const t_real fill_relaxation, sopt::mpi::Communicator const &comm,
+                             const std::function<t_real(t_int)> &cost) {
+  std::vector<t_real> costs(w.size());
+#pragma omp parallel for
   for (t_int i = 0; i < w.size(); i++)
-    coeff_total += widefield::w_support(std::abs(w(i) - w_stacks.at(image_index.at(i))), du,
-                                        min_support, max_support) *
-                   widefield::w_support(std::abs(w(i) - w_stacks.at(image_index.at(i))), du,
-                                        min_support, max_support);
+    costs[i] = cost(widefield::w_support(std::abs(w(i) - w_stacks.at(image_index.at(i))), du,
+                                         min_support, max_support));
+  t_real coeff_total = 0;
+  for (t_int i = 0; i < w.size(); i++) coeff_total += costs[i];
+  // cost of the visibilities on the nodes before this one
+  t_real coeff_offset = 0;
+  MPI_Exscan(&coeff_total, &coeff_offset, 1, sopt::mpi::Type<t_real>::value, MPI_SUM, *comm);
+  if (comm.rank() == 0) coeff_offset = 0;
   const t_real coeff_average =
       comm.all_sum_all<t_real>(coeff_total) / static_cast<t_real>(comm.size());
   if (comm.is_root())
     PURIFY_DEBUG("Each node should have on average {} coefficients.", coeff_average);
-  t_real coeff_sum = 0;
-  t_int group = 0;
-  std::vector<t_int> groups(w.size(), comm.rank());
-  std::vector<t_int> coeffs(comm.size(), comm.rank());
-  long long int total = 0;
-  for (t_int rank = 0; rank < comm.size(); rank++) {
-    const auto size = comm.broadcast(w.size(), rank);
-    for (t_int i = 0; i < size; i++) {
-      if (comm.rank() == rank) {
-        const t_int cost = widefield::w_support(std::abs(w(i) - w_stacks.at(image_index.at(i))), du,
-                                                min_support, max_support) *
-                           widefield::w_support(std::abs(w(i) - w_stacks.at(image_index.at(i))), du,
-                                                min_support, max_support);
-        total += cost;
-        if (group < (comm.size() - 1))
-          if ((cost + coeff_sum) > coeff_average * (1. + fill_relaxation)) {
-            PURIFY_DEBUG("{} node should have {} coefficients.", group, coeff_sum);
-            coeff_sum = 0;
-            group++;
-          }
-        coeff_sum += cost;
-        groups[i] = group;
-      }
-    }
-    if (group > comm.size() - 1)
-      throw std::runtime_error(
-          "Error distributing visibilites to even computational load for wide field imaging. Group "
-          "number out of bounds.");
-    coeff_sum = comm.broadcast(coeff_sum, rank);
-    group = comm.broadcast(group, rank);
-
-    if (total != coeff_total and comm.rank() == rank)
-      throw std::runtime_error(
-          "Total number of coefficients calculated is not the same, loop might be broken. " +
-          std::to_string(total) + " != " + std::to_string(coeff_total));
+  const t_real capacity = coeff_average * (1. + fill_relaxation);
+  // each visibility goes to the node that holds the middle of its cost
+  std::vector<t_int> groups(w.size(), 0);
+  Vector<t_real> group_coeffs = Vector<t_real>::Zero(comm.size());
+  t_real coeff_sum = coeff_offset;
+  for (t_int i = 0; i < w.size(); i++) {
+    if (capacity > 0)
+      groups[i] = std::min<t_int>(comm.size() - 1,
+                                  std::floor((coeff_sum + 0.5 * costs[i]) / capacity));
+    coeff_sum += costs[i];
+    group_coeffs(groups[i]) += costs[i];
   }
-  if (comm.is_root()) PURIFY_DEBUG("{} node should have {} coefficients.", group, coeff_sum);
+  group_coeffs = comm.all_sum_all<Vector<t_real>>(group_coeffs);
+  if (comm.is_root())
+    for (t_int group = 0; group < comm.size(); group++)
+      PURIFY_DEBUG("{} node should have {} coefficients.", group, group_coeffs(group));
   return groups;
 }
 #endif
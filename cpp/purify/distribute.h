@@ -2,6 +2,7 @@
 #define PURIFY_DISTRIBUTE_H
 #include "purify/config.h"
 #include <iostream>
+#include <map>
 #include <stdio.h>
 #include <string>
 #ifdef PURIFY_MPI
@@ -13,7 +14,13 @@
 
 namespace purify {
 namespace distribute {
-enum class plan { none, equal, radial, w_term };
+enum class plan { none, equal, radial, w_term, bisection, bisection_w };
+const std::map<std::string, plan> plan_from_string = {{"none", plan::none},
+                                                      {"equal", plan::equal},
+                                                      {"radial", plan::radial},
+                                                      {"w_term", plan::w_term},
+                                                      {"bisection", plan::bisection},
+                                                      {"bisection_w", plan::bisection_w}};
 //! Distribute visiblities into groups
 std::vector<t_int> distribute_measurements(Vector<t_real> const &u, Vector<t_real> const &v,
                                            Vector<t_real> const &w, t_int const number_of_nodes,
@@ -27,12 +34,67 @@ inline std::vector<t_int> distribute_measurements(
   return distribute_measurements(params.u, params.v, params.w, comm.size(), distribution_plan,
                                  grid_size);
 }
+//! Distribute visibilities that are already spread over the nodes, without gathering them
+//! \details Returns the node of each local visibility. The key of the plan is binned into a global
+//! histogram, and each visibility is placed by its global position in the order of the bins, so
+//! that every node receives the same number of visibilities, or the same cost when it is given.
+std::vector<t_int> distribute_measurements_parallel(
+    utilities::vis_params const &params, sopt::mpi::Communicator const &comm,
+    distribute::plan const distribution_plan = plan::equal, t_int const &grid_size = 128,
+    t_int const bins = 65536, Vector<t_real> const &cost = Vector<t_real>());
+#endif
+//! Distribute visibilities by recursive coordinate bisection of the uv plane (a k-d tree)
+//! \details Each group is cut across its widest extent at the point that splits the cost evenly
+//! between the nodes on each side, so that every node grids a compact region of the grid and
+//! nodes only share the grid cells along the cuts. The cost of a visibility is the number of
+//! kernel coefficients (support squared) and is the same for all visibilities when empty. The
+//! extent in w is scaled by w_scale, and is not cut when w_scale is zero.
+std::vector<t_int> bisection_distribution(Vector<t_real> const &u, Vector<t_real> const &v,
+                                          Vector<t_real> const &w, t_int const number_of_nodes,
+                                          Vector<t_real> const &cost = Vector<t_real>(),
+                                          t_real const w_scale = 0);
+//! Number of kernel coefficients (support squared) of each visibility with w-projection
+//! \details w and du are in wavelengths, and the support grows with |w| from min_support up to
+//! max_support.
+Vector<t_real> w_support_cost(Vector<t_real> const &w, t_real const du, t_int const min_support,
+                              t_int const max_support);
+//! Grid cells touched by the kernels of the visibilities of each node, and how many of them are
+//! touched by other nodes too
+//! \details u and v are in pixels of the FFT grid. The touched cells of a node are what is sent
+//! to and received from it when the grid is scattered and gathered.
+std::tuple<std::vector<t_int>, std::vector<t_int>> grid_footprint(
+    Vector<t_real> const &u, Vector<t_real> const &v, std::vector<t_int> const &groups,
+    t_int const number_of_nodes, t_int const ftsizev, t_int const ftsizeu, t_int const Jv,
+    t_int const Ju);
+#ifdef PURIFY_MPI
+//! Recursive coordinate bisection of visibilities that are already spread over the nodes
+//! \details Returns the node of each local visibility. The cuts are placed using global
+//! histograms of the cost with at least bins / (groups being cut) bins per group.
+std::vector<t_int> bisection_distribution(Vector<t_real> const &u, Vector<t_real> const &v,
+                                          Vector<t_real> const &w,
+                                          sopt::mpi::Communicator const &comm,
+                                          Vector<t_real> const &cost = Vector<t_real>(),
+                                          t_real const w_scale = 0, t_int const bins = 65536);
+//! Grid cells touched by the kernels of the local visibilities, and how many of them are touched
+//! by other nodes too
+//! \details Each cell is counted on the node cell % comm.size(), so that no node holds the whole
+//! grid.
+std::tuple<t_int, t_int> grid_footprint(Vector<t_real> const &u, Vector<t_real> const &v,
+                                        sopt::mpi::Communicator const &comm, t_int const ftsizev,
+                                        t_int const ftsizeu, t_int const Jv, t_int const Ju);
 #endif
 //! patition w terms using k-means
+//! \details The cost has to increase with the distance between w and the centre.
 std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
     const Vector<t_real> &w, const t_int number_of_nodes, const t_int iters,
     const std::function<t_real(t_real)> &cost = [](t_real x) { return x * x; },
     const t_real rel_diff = 1e-3);
+//! patition w terms into the clusters with least squared distance to their means
+//! \details Exact for clusters made of whole bins of a histogram of w, found by dynamic
+//! programming. Returns a tuple (indices for group, centre mean for each group)
+std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_optimal(const Vector<t_real> &w,
+                                                                   const t_int number_of_nodes,
+                                                                   const t_int bins = 4096);
 #ifdef PURIFY_MPI
 //! patition w terms using k-means over MPI
 //! Details returns a tuple (indices for group, centre mean for each group)
@@ -41,11 +103,23 @@ std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_algo(
     sopt::mpi::Communicator const &comm,
     const std::function<t_real(t_real)> &cost = [](t_real x) { return x * x; },
     const t_real rel_diff = 1e-3);
+//! patition w terms into the clusters with least squared distance to their means over MPI
+//! \details The histogram of w is summed over the nodes, and every node finds the same clusters
+std::tuple<std::vector<t_int>, std::vector<t_real>> kmeans_optimal(
+    const Vector<t_real> &w, const t_int number_of_nodes, sopt::mpi::Communicator const &comm,
+    const t_int bins = 4096);
 //! Indicies to evenly distribute kernel coefficients values across nodes
-std::vector<t_int> w_support(Vector<t_real> const &w, const std::vector<t_int> &image_index,
-                             const std::vector<t_real> &w_stacks, const t_real du,
-                             const t_int min_support, const t_int max_support,
-                             const t_real fill_relaxation, sopt::mpi::Communicator const &comm);
+//! \details The cost of each visibility is a function of its kernel support, by default the
+//! number of coefficients. The cost of the nodes before is found with MPI_Exscan, so that each
+//! node places its visibilities in order without waiting for the others. Nodes are filled up to
+//! the average cost times (1 + fill_relaxation).
+std::vector<t_int> w_support(
+    Vector<t_real> const &w, const std::vector<t_int> &image_index,
+    const std::vector<t_real> &w_stacks, const t_real du, const t_int min_support,
+    const t_int max_support, const t_real fill_relaxation, sopt::mpi::Communicator const &comm,
+    const std::function<t_real(t_int)> &cost = [](t_int support) -> t_real {
+      return support * support;
+    });
 #endif
 //! Distribute visibilities into nodes in order of w terms (useful for w-stacking)
 Vector<t_int> w_distribution(Vector<t_real> const &u, const Vector<t_real> &v,
@@ -0,0 +1,270 @@
+#include "purify/load_balancing.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include "purify/logging.h"
+#include "purify/operators.h"
+#include <sopt/wavelets.h>
+#include <sopt/wavelets/sara.h>
+
+#ifdef PURIFY_MPI
+#include "purify/mpi_utilities.h"
+#endif
+
+namespace purify {
+namespace load_balancing {
+
+t_real gridding_time(const utilities::vis_params &uv_vis, const t_uint imsizey,
+                     const t_uint imsizex, const t_real oversample_ratio,
+                     const kernels::kernel kernel, const t_uint Ju, const t_uint Jv,
+                     const t_int applications) {
+  if (uv_vis.size() == 0 or applications < 1) return 0;
+  std::function<t_real(t_real)> kernelu, kernelv, ftkernelu, ftkernelv;
+  std::tie(kernelu, kernelv, ftkernelu, ftkernelv) =
+      purify::create_kernels(kernel, Ju, Jv, imsizey, imsizex, oversample_ratio);
+  sopt::OperatorFunction<Vector<t_complex>> directG, indirectG;
+  std::tie(directG, indirectG) = operators::init_gridding_matrix_2d<Vector<t_complex>>(
+      uv_vis.u, uv_vis.v, uv_vis.weights, imsizey, imsizex, oversample_ratio, kernelv, kernelu,
+      Ju, Jv);
+  const t_int ftsize =
+      std::floor(imsizey * oversample_ratio) * std::floor(imsizex * oversample_ratio);
+  const Vector<t_complex> grid = Vector<t_complex>::Random(ftsize);
+  const Vector<t_complex> vis = Vector<t_complex>::Random(uv_vis.size());
+  Vector<t_complex> output;
+  directG(output, grid);
+  indirectG(output, vis);
+  const auto start = std::chrono::steady_clock::now();
+  for (t_int i = 0; i < applications; i++) {
+    directG(output, grid);
+    indirectG(output, vis);
+  }
+  const std::chrono::duration<t_real> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / applications;
+}
+
+std::vector<t_int> balanced_sizes(const std::vector<t_int> &sizes, const std::vector<t_real> &times,
+                                  const t_real migration_budget) {
+  if (sizes.size() != times.size())
+    throw std::runtime_error("Number of times does not match the number of nodes.");
+  const t_int nodes = sizes.size();
+  const t_real total = std::accumulate(sizes.begin(), sizes.end(), 0.);
+  t_real measured_time = 0;
+  t_real measured_size = 0;
+  for (t_int n = 0; n < nodes; n++)
+    if (sizes[n] > 0 and times[n] > 0) {
+      measured_time += times[n];
+      measured_size += sizes[n];
+    }
+  if (measured_time <= 0 or total <= 0 or migration_budget <= 0) return sizes;
+  const t_real average_rate = measured_time / measured_size;
+  // visibilities per second of each node
+  std::vector<t_real> speed(nodes);
+  for (t_int n = 0; n < nodes; n++)
+    speed[n] = 1. / ((sizes[n] > 0 and times[n] > 0) ? times[n] / sizes[n] : average_rate);
+  const t_real total_speed = std::accumulate(speed.begin(), speed.end(), 0.);
+  std::vector<t_real> desired(nodes);
+  t_real excess = 0;
+  for (t_int n = 0; n < nodes; n++) {
+    desired[n] = total * speed[n] / total_speed;
+    excess += std::max<t_real>(0, sizes[n] - desired[n]);
+  }
+  if (excess <= 0) return sizes;
+  const t_real step = std::min<t_real>(1, migration_budget * total / excess);
+  // round down, then hand out what is left by the largest remainders
+  std::vector<t_int> targets(nodes);
+  std::vector<t_real> remainder(nodes);
+  t_int assigned = 0;
+  for (t_int n = 0; n < nodes; n++) {
+    const t_real target = sizes[n] + step * (desired[n] - sizes[n]);
+    targets[n] = std::floor(target);
+    remainder[n] = target - targets[n];
+    assigned += targets[n];
+  }
+  std::vector<t_int> order(nodes);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&remainder](t_int a, t_int b) { return remainder[a] > remainder[b]; });
+  for (t_int i = 0; assigned < static_cast<t_int>(total); i++, assigned++)
+    targets[order[i % nodes]]++;
+  return targets;
+}
+
+std::vector<t_int> greedy_assignment(const std::vector<t_real> &costs, const t_int nodes) {
+  if (nodes < 1) throw std::runtime_error("Tasks need at least one node.");
+  std::vector<t_int> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](t_int a, t_int b) { return costs[a] > costs[b]; });
+  std::vector<t_real> load(nodes, 0);
+  std::vector<t_int> assignment(costs.size());
+  for (const t_int task : order) {
+    const t_int node = std::min_element(load.begin(), load.end()) - load.begin();
+    assignment[task] = node;
+    load[node] += costs[task];
+  }
+  return assignment;
+}
+
+t_real wavelet_cost(const std::string &name, const t_uint levels, const t_uint imsizey,
+                    const t_uint imsizex) {
+  const t_real pixels = static_cast<t_real>(imsizey) * imsizex;
+  // forward and adjoint both read and write the image once
+  t_real cost = 2 * pixels;
+  if (name == "Dirac") return cost;
+  if (name.size() < 3 or name.substr(0, 2) != "DB")
+    throw std::runtime_error("No cost model for wavelet " + name);
+  const t_int taps = 2 * std::stoi(name.substr(2));
+  t_real level_pixels = pixels;
+  for (t_uint l = 0; l < levels; l++) {
+    cost += 2 * 2 * taps * level_pixels;
+    level_pixels /= 4;
+  }
+  return cost;
+}
+
+t_real wavelet_time(const std::tuple<std::string, t_uint> &wavelet, const t_uint imsizey,
+                    const t_uint imsizex, const t_int applications) {
+  if (applications < 1) return 0;
+  const std::vector<std::tuple<std::string, t_uint>> basis = {wavelet};
+  const auto sara = sopt::wavelets::SARA(basis.begin(), basis.end());
+  const auto psi = sopt::linear_transform<t_complex>(sara, imsizey, imsizex);
+  const Vector<t_complex> image = Vector<t_complex>::Random(imsizey * imsizex);
+  Vector<t_complex> coefficients = psi.adjoint() * image;
+  Vector<t_complex> output = psi * coefficients;
+  const auto start = std::chrono::steady_clock::now();
+  for (t_int i = 0; i < applications; i++) {
+    coefficients = psi.adjoint() * image;
+    output = psi * coefficients;
+  }
+  const std::chrono::duration<t_real> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / applications;
+}
+
+#ifdef PURIFY_MPI
+std::vector<std::tuple<std::string, t_uint>> distribute_wavelets(
+    const std::vector<std::tuple<std::string, t_uint>> &wavelets, const t_uint imsizey,
+    const t_uint imsizex, const sopt::mpi::Communicator &comm, const t_int applications) {
+  const t_int nodes = comm.size();
+  Vector<t_real> local_costs = Vector<t_real>::Zero(wavelets.size());
+  // each basis is timed on one node, so that all nodes agree on the costs
+  for (t_int i = 0; i < wavelets.size(); i++) {
+    if (applications > 0 and i % nodes != comm.rank()) continue;
+    local_costs(i) = (applications > 0)
+                         ? wavelet_time(wavelets[i], imsizey, imsizex, applications)
+                         : wavelet_cost(std::get<0>(wavelets[i]), std::get<1>(wavelets[i]),
+                                        imsizey, imsizex);
+  }
+  const Vector<t_real> all_costs =
+      (applications > 0) ? comm.all_sum_all<Vector<t_real>>(local_costs) : local_costs;
+  const std::vector<t_real> costs(all_costs.data(), all_costs.data() + all_costs.size());
+  const std::vector<t_int> assignment = greedy_assignment(costs, nodes);
+  std::vector<std::tuple<std::string, t_uint>> local;
+  for (t_int i = 0; i < wavelets.size(); i++)
+    if (assignment[i] == comm.rank()) local.push_back(wavelets[i]);
+  if (comm.is_root()) {
+    std::vector<t_real> load(nodes, 0);
+    std::vector<std::string> names(nodes);
+    for (t_int i = 0; i < wavelets.size(); i++) {
+      load[assignment[i]] += costs[i];
+      names[assignment[i]] += " " + std::get<0>(wavelets[i]);
+    }
+    for (t_int n = 0; n < nodes; n++)
+      PURIFY_MEDIUM_LOG("Node {} applies wavelets{} with cost {}.", n, names[n], load[n]);
+    const t_real total = std::accumulate(load.begin(), load.end(), 0.);
+    PURIFY_HIGH_LOG("Wavelet cost of the most expensive node is {} times the average.",
+                    (total > 0) ? *std::max_element(load.begin(), load.end()) * nodes / total : 1.);
+  }
+  return local;
+}
+
+utilities::vis_params rebalance(const utilities::vis_params &uv_vis,
+                                const sopt::mpi::Communicator &comm, const t_real cell_x,
+                                const t_real cell_y, const t_uint imsizey, const t_uint imsizex,
+                                const t_real oversample_ratio, const kernels::kernel kernel,
+                                const t_uint Ju, const t_uint Jv, const t_int applications,
+                                const t_real migration_budget, const distribute::plan plan) {
+  if (comm.size() == 1 or applications < 1) return uv_vis;
+  const t_real time = gridding_time(
+      utilities::convert_to_pixels(uv_vis, cell_x, cell_y, imsizex, imsizey, oversample_ratio),
+      imsizey, imsizex, oversample_ratio, kernel, Ju, Jv, applications);
+  Vector<t_int> local_size = Vector<t_int>::Zero(comm.size());
+  Vector<t_real> local_time = Vector<t_real>::Zero(comm.size());
+  local_size(comm.rank()) = uv_vis.size();
+  local_time(comm.rank()) = time;
+  const Vector<t_int> all_sizes = comm.all_sum_all<Vector<t_int>>(local_size);
+  const Vector<t_real> all_times = comm.all_sum_all<Vector<t_real>>(local_time);
+  const std::vector<t_int> sizes(all_sizes.data(), all_sizes.data() + all_sizes.size());
+  const std::vector<t_real> times(all_times.data(), all_times.data() + all_times.size());
+  t_real measured_time = 0;
+  t_real measured_size = 0;
+  for (t_int n = 0; n < comm.size(); n++)
+    if (sizes[n] > 0 and times[n] > 0) {
+      measured_time += times[n];
+      measured_size += sizes[n];
+    }
+  if (measured_time <= 0 or migration_budget <= 0) return uv_vis;
+  const t_real average_rate = measured_time / measured_size;
+  const t_real rate = (uv_vis.size() > 0 and time > 0) ? time / uv_vis.size() : average_rate;
+  const t_int budget = std::floor(migration_budget * all_sizes.sum());
+  // node of each visibility when it costs step of the way from the average to the measured rate,
+  // and the number of visibilities that change node
+  const auto partition = [&](const t_real step) -> std::tuple<std::vector<t_int>, t_int> {
+    const Vector<t_real> cost =
+        Vector<t_real>::Constant(uv_vis.size(), 1 + step * (rate / average_rate - 1));
+    const std::vector<t_int> groups =
+        distribute::distribute_measurements_parallel(uv_vis, comm, plan, 128, 65536, cost);
+    t_int moved = 0;
+    for (const t_int group : groups) moved += (group != comm.rank());
+    return std::make_tuple(groups, comm.all_sum_all(moved));
+  };
+  std::vector<t_int> groups;
+  t_int moved;
+  t_real step = 1;
+  std::tie(groups, moved) = partition(step);
+  if (moved > budget) {
+    std::vector<t_int> lower_groups;
+    t_int lower_moved;
+    std::tie(lower_groups, lower_moved) = partition(0);
+    if (lower_moved > budget) {
+      if (comm.is_root())
+        PURIFY_HIGH_LOG(
+            "Load balancing would move {} visibilities to follow the distribution plan, more than "
+            "the budget of {}, so no visibilities are moved.",
+            lower_moved, budget);
+      return uv_vis;
+    }
+    // bisect for the largest step that stays within the budget
+    t_real lower = 0;
+    t_real upper = 1;
+    for (t_int i = 0; i < 6; i++) {
+      const t_real middle = (lower + upper) / 2;
+      std::tie(groups, moved) = partition(middle);
+      if (moved <= budget) {
+        lower = middle;
+        lower_groups = groups;
+        lower_moved = moved;
+      } else
+        upper = middle;
+    }
+    step = lower;
+    groups = lower_groups;
+    moved = lower_moved;
+  }
+  if (comm.is_root()) {
+    const std::vector<t_int> targets = balanced_sizes(sizes, times, 1);
+    for (t_int n = 0; n < comm.size(); n++)
+      PURIFY_MEDIUM_LOG(
+          "Node {} gridded {} visibilities in {} s, and would hold {} visibilities when balanced.",
+          n, sizes[n], times[n], targets[n]);
+    PURIFY_HIGH_LOG(
+        "Load balancing moves {} visibilities ({} of the way to the measured costs), the slowest "
+        "node took {} s and the fastest {} s.",
+        moved, step, *std::max_element(times.begin(), times.end()),
+        *std::min_element(times.begin(), times.end()));
+  }
+  if (moved == 0) return uv_vis;
+  return utilities::regroup_and_all_to_all(uv_vis, groups, comm);
+}
+#endif
+}  // namespace load_balancing
+}  // namespace purify
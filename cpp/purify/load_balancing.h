@@ -0,0 +1,78 @@
+#ifndef PURIFY_LOAD_BALANCING_H
+#define PURIFY_LOAD_BALANCING_H
+
+#include "purify/config.h"
+#include "purify/types.h"
+#include <string>
+#include <tuple>
+#include <vector>
+#include "purify/distribute.h"
+#include "purify/kernels.h"
+#include "purify/uvw_utilities.h"
+
+#ifdef PURIFY_MPI
+#include <sopt/mpi/communicator.h>
+#endif
+
+namespace purify {
+namespace load_balancing {
+//! Seconds taken to apply the gridding operator and its adjoint to the visibilities
+//! \details Averaged over the number of applications, after one application that is not timed.
+//! The coordinates u and v are in pixels.
+t_real gridding_time(const utilities::vis_params &uv_vis, const t_uint imsizey,
+                     const t_uint imsizex, const t_real oversample_ratio,
+                     const kernels::kernel kernel, const t_uint Ju, const t_uint Jv,
+                     const t_int applications);
+
+//! Number of visibilities each node should hold for the measured times to be the same
+//! \details Each node is assumed to keep the rate (seconds per visibility) it was measured at.
+//! Nodes with no visibilities or no time get the average rate. The sizes move towards the
+//! balanced sizes by as much as migration_budget allows, where migration_budget is the largest
+//! fraction of all visibilities that may change node.
+std::vector<t_int> balanced_sizes(const std::vector<t_int> &sizes, const std::vector<t_real> &times,
+                                  const t_real migration_budget);
+
+//! Node of each task, so that the most expensive node has as little work as possible
+//! \details Greedy scheduling: tasks are taken from most to least expensive and each goes to the
+//! node with the least work so far, ties going to the lowest node. A node may get several tasks
+//! or none.
+std::vector<t_int> greedy_assignment(const std::vector<t_real> &costs, const t_int nodes);
+
+//! Estimated number of operations to apply a wavelet basis and its adjoint to an image
+//! \details Dirac copies the image. Daubechies wavelet k filters with 2k taps along both axes at
+//! each level, where each level has a quarter of the pixels of the level above.
+t_real wavelet_cost(const std::string &name, const t_uint levels, const t_uint imsizey,
+                    const t_uint imsizex);
+
+//! Seconds taken to apply a wavelet basis and its adjoint to an image
+//! \details Averaged over the number of applications, after one application that is not timed.
+t_real wavelet_time(const std::tuple<std::string, t_uint> &wavelet, const t_uint imsizey,
+                    const t_uint imsizex, const t_int applications);
+
+#ifdef PURIFY_MPI
+//! Wavelet bases this node applies when the bases are spread over comm by their cost
+//! \details Each basis is timed on one node when applications is larger than zero, otherwise
+//! its cost is estimated with wavelet_cost. The bases are assigned with greedy_assignment and the
+//! cost of each node is logged by the root node.
+std::vector<std::tuple<std::string, t_uint>> distribute_wavelets(
+    const std::vector<std::tuple<std::string, t_uint>> &wavelets, const t_uint imsizey,
+    const t_uint imsizex, const sopt::mpi::Communicator &comm, const t_int applications = 1);
+
+//! Times the gridding on each node, then moves visibilities from slower to faster nodes
+//! \details The gridding operator of the local visibilities is applied the given number of times
+//! on every node. The visibilities are distributed again with the plan, where each visibility
+//! costs the measured seconds per visibility of its node, so that the regions of the plan keep
+//! their place and only move their edges. When that moves more than migration_budget (a fraction
+//! of all visibilities), the costs are brought closer to the average until it does not. The
+//! decisions are logged by the root node.
+utilities::vis_params rebalance(const utilities::vis_params &uv_vis,
+                                const sopt::mpi::Communicator &comm, const t_real cell_x,
+                                const t_real cell_y, const t_uint imsizey, const t_uint imsizex,
+                                const t_real oversample_ratio, const kernels::kernel kernel,
+                                const t_uint Ju, const t_uint Jv, const t_int applications,
+                                const t_real migration_budget,
+                                const distribute::plan plan = distribute::plan::none);
+#endif
+}  // namespace load_balancing
+}  // namespace purify
+#endif
@@ -6,8 +6,11 @@
 #include "purify/types.h"
 #include "purify/logging.h"
 
+#include "purify/batch_operators.h"
 #include "purify/operators.h"
 #include "purify/operators_gpu.h"
+#include "purify/shared_memory_operators.h"
+#include "purify/slab_operators.h"
 #include "purify/wproj_operators.h"
 #include "purify/wproj_operators_gpu.h"
 
@@ -24,6 +27,9 @@ enum class distributed_measurement_operator {
   mpi_distribute_image,
   mpi_distribute_grid,
   mpi_distribute_all_to_all,
+  mpi_distribute_grid_slabs,
+  mpi_distribute_shared_memory,
+  mpi_distribute_image_slabs,
   gpu_serial,
   gpu_mpi_distribute_image,
   gpu_mpi_distribute_grid,
@@ -88,6 +94,24 @@ std::shared_ptr<sopt::LinearTransform<T>> measurement_operator_factory(
     PURIFY_LOW_LOG("Using distributed grid MPI measurement operator.");
     return measurementoperator::init_degrid_operator_2d_mpi<T>(world, std::forward<ARGS>(args)...);
   }
+  case (distributed_measurement_operator::mpi_distribute_grid_slabs): {
+    auto const world = sopt::mpi::Communicator::World();
+    PURIFY_LOW_LOG("Using MPI measurement operator with the FFT grid distributed in slabs.");
+    return measurementoperator::init_degrid_operator_2d_slabs<T>(world,
+                                                                 std::forward<ARGS>(args)...);
+  }
+  case (distributed_measurement_operator::mpi_distribute_image_slabs): {
+    auto const world = sopt::mpi::Communicator::World();
+    PURIFY_LOW_LOG("Using MPI measurement operator with the image and FFT grid in slabs.");
+    return measurementoperator::init_degrid_operator_2d_image_slabs<T>(
+        world, std::forward<ARGS>(args)...);
+  }
+  case (distributed_measurement_operator::mpi_distribute_shared_memory): {
+    auto const world = sopt::mpi::Communicator::World();
+    PURIFY_LOW_LOG("Using MPI measurement operator with the FFT grid in node shared memory.");
+    return measurementoperator::init_degrid_operator_2d_shared_memory<T>(
+        world, std::forward<ARGS>(args)...);
+  }
   case (distributed_measurement_operator::gpu_mpi_distribute_image): {
 #ifndef PURIFY_ARRAYFIRE
     throw std::runtime_error("Tried to use GPU operator but you did not build with ArrayFire.");
@@ -119,6 +143,32 @@ std::shared_ptr<sopt::LinearTransform<T>> measurement_operator_factory(
   }
 }
 
+//! measurement operator factory that also returns the operator and its adjoint on batches of
+//! vectors, which share the gridding matrix of the measurement operator
+template <class T, class... ARGS>
+std::tuple<std::shared_ptr<sopt::LinearTransform<T>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>,
+           sopt::OperatorFunction<Matrix<typename T::Scalar>>>
+batch_measurement_operator_factory(const distributed_measurement_operator distribute,
+                                   ARGS &&... args) {
+  switch (distribute) {
+  case (distributed_measurement_operator::serial): {
+    PURIFY_LOW_LOG("Using serial measurement operator with batches.");
+    return measurementoperator::init_degrid_operator_2d_with_batch<T>(std::forward<ARGS>(args)...);
+  }
+#ifdef PURIFY_MPI
+  case (distributed_measurement_operator::mpi_distribute_image): {
+    auto const world = sopt::mpi::Communicator::World();
+    PURIFY_LOW_LOG("Using distributed image MPI measurement operator with batches.");
+    return measurementoperator::init_degrid_operator_2d_with_batch<T>(world,
+                                                                      std::forward<ARGS>(args)...);
+  }
+#endif
+  default:
+    throw std::runtime_error("Batched measurement operator is not available for this method.");
+  }
+}
+
 }  // namespace factory
 }  // namespace purify
 #endif
@@ -1,8 +1,11 @@
 #include "purify/mpi_utilities.h"
 #include "purify/config.h"
+#include <array>
 #include <iostream>
+#include <memory>
 #include <type_traits>
 #include "purify/distribute.h"
+#include "purify/logging.h"
 
 namespace purify {
 namespace utilities {
@@ -46,6 +49,8 @@ void regroup(vis_params &uv_params, std::vector<t_int> &image_index,
     return j;
   };
 
+  const bool has_time = (uv_params.time.size() == uv_params.size());
+  const bool has_baseline = (uv_params.baseline.size() == uv_params.size());
   i = 0;
   while (i < uv_params.u.size()) {
     auto const expected_proc = expected(i);
@@ -69,88 +74,243 @@ void regroup(vis_params &uv_params, std::vector<t_int> &image_index,
     std::swap(uv_params.w(i), uv_params.w(swapper));
     std::swap(uv_params.vis(i), uv_params.vis(swapper));
     std::swap(uv_params.weights(i), uv_params.weights(swapper));
+    if (has_time) std::swap(uv_params.time(i), uv_params.time(swapper));
+    if (has_baseline) std::swap(uv_params.baseline(i), uv_params.baseline(swapper));
     std::swap(image_index[i], image_index[swapper]);
 
     ++swapper;
   }
 }
 
-vis_params regroup_and_scatter(vis_params const &params, std::vector<t_int> const &groups,
-                               sopt::mpi::Communicator const &comm) {
-  if (comm.size() == 1) return params;
-  if (comm.rank() != comm.root_id()) return scatter_visibilities(comm);
+namespace {
+//! Header sent along with the visibilities: units, ra, dec, average frequency
+typedef std::array<t_real, 4> vis_header;
+
+vis_header make_header(vis_params const &params) {
+  return vis_header{{static_cast<t_real>(static_cast<int>(params.units)), params.ra, params.dec,
+                     params.average_frequency}};
+}
+
+void set_header(vis_params &params, vis_header const &header) {
+  params.units = static_cast<utilities::vis_units>(static_cast<int>(header[0]));
+  params.ra = header[1];
+  params.dec = header[2];
+  params.average_frequency = header[3];
+}
+
+//! Number of reals in the record of one visibility
+t_int record_length(const bool has_time, const bool has_baseline, const bool has_index) {
+  return 7 + has_time + has_baseline + has_index;
+}
 
-  std::vector<t_int> sizes(comm.size());
-  std::fill(sizes.begin(), sizes.end(), 0);
+//! MPI type of one record, so that counts stay in visibilities
+std::shared_ptr<MPI_Datatype> record_type(const t_int length) {
+  const std::shared_ptr<MPI_Datatype> type(new MPI_Datatype, [](MPI_Datatype *type) {
+    MPI_Type_free(type);
+    delete type;
+  });
+  MPI_Type_contiguous(length, sopt::mpi::Type<t_real>::value, type.get());
+  MPI_Type_commit(type.get());
+  return type;
+}
+
+//! Partitions the visibilities in place so that the groups follow each other in order
+//! \details Each visibility is swapped straight into the next free place of its group, as in an
+//! American flag sort, so that no copy of the visibilities is made. Returns the number of
+//! visibilities in each group.
+std::vector<t_int> partition_by_group(vis_params &params, std::vector<t_int> *image_index,
+                                      std::vector<t_int> groups, const t_int number_of_groups) {
+  if (groups.size() != params.size())
+    throw std::runtime_error("Number of groups does not match the number of visibilities.");
+  std::vector<t_int> sizes(number_of_groups, 0);
   for (auto const &group : groups) {
-    if (group > static_cast<t_int>(comm.size()))
+    if (group < 0 or group >= number_of_groups)
       throw std::out_of_range("groups should go from 0 to comm.size()");
     ++sizes[group];
   }
+  const bool has_time = (params.time.size() == params.size());
+  const bool has_baseline = (params.baseline.size() == params.size());
+  // next place to fill in each group, and where each group ends
+  std::vector<t_int> next(number_of_groups, 0), ends(number_of_groups, 0);
+  for (t_int g = 0; g < number_of_groups; g++) {
+    next[g] = (g > 0) ? ends[g - 1] : 0;
+    ends[g] = next[g] + sizes[g];
+  }
+  for (t_int g = 0; g < number_of_groups; g++)
+    while (next[g] < ends[g]) {
+      const t_int i = next[g];
+      if (groups[i] == g) {
+        ++next[g];
+        continue;
+      }
+      const t_int j = next[groups[i]]++;
+      std::swap(groups[i], groups[j]);
+      std::swap(params.u(i), params.u(j));
+      std::swap(params.v(i), params.v(j));
+      std::swap(params.w(i), params.w(j));
+      std::swap(params.vis(i), params.vis(j));
+      std::swap(params.weights(i), params.weights(j));
+      if (has_time) std::swap(params.time(i), params.time(j));
+      if (has_baseline) std::swap(params.baseline(i), params.baseline(j));
+      if (image_index) std::swap((*image_index)[i], (*image_index)[j]);
+    }
+  return sizes;
+}
 
-  vis_params copy = params;
-  regroup(copy, groups, comm.size());
-  return scatter_visibilities(copy, sizes, comm);
+//! Packs each visibility into one record, in the order of the visibilities
+Vector<t_real> pack(vis_params const &params, const std::vector<t_int> *image_index,
+                    const bool has_time, const bool has_baseline) {
+  const t_int length = record_length(has_time, has_baseline, image_index != nullptr);
+  Vector<t_real> records(static_cast<Eigen::Index>(params.size()) * length);
+  for (t_int i = 0; i < params.size(); i++) {
+    t_real *const record = records.data() + static_cast<Eigen::Index>(i) * length;
+    record[0] = params.u(i);
+    record[1] = params.v(i);
+    record[2] = params.w(i);
+    record[3] = params.vis(i).real();
+    record[4] = params.vis(i).imag();
+    record[5] = params.weights(i).real();
+    record[6] = params.weights(i).imag();
+    t_int field = 7;
+    if (has_time) record[field++] = params.time(i);
+    if (has_baseline) record[field++] = static_cast<t_real>(params.baseline(i));
+    if (image_index) record[field++] = (*image_index)[i];
+  }
+  return records;
 }
-std::tuple<vis_params, std::vector<t_int>> regroup_and_all_to_all(
-    vis_params const &params, const std::vector<t_int> &image_index,
-    std::vector<t_int> const &groups, sopt::mpi::Communicator const &comm) {
-  if (comm.size() == 1) return std::make_tuple(params, image_index);
-  vis_params copy = params;
-  std::vector<t_int> index_copy(image_index.size());
-  std::copy(image_index.begin(), image_index.end(), index_copy.begin());
-  regroup(copy, index_copy, groups, comm.size());
-
-  std::vector<t_int> sizes(comm.size());
-  std::fill(sizes.begin(), sizes.end(), 0);
-  for (auto const &group : groups) {
-    if (group > static_cast<t_int>(comm.size()))
-      throw std::out_of_range("groups should go from 0 to comm.size()");
-    ++sizes[group];
+
+//! Unpacks records into visibilities, and into the image index when it was packed
+vis_params unpack(Vector<t_real> const &records, const bool has_time, const bool has_baseline,
+                  std::vector<t_int> *image_index) {
+  const t_int length = record_length(has_time, has_baseline, image_index != nullptr);
+  const t_int size = records.size() / length;
+  vis_params result;
+  result.u = Vector<t_real>(size);
+  result.v = Vector<t_real>(size);
+  result.w = Vector<t_real>(size);
+  result.vis = Vector<t_complex>(size);
+  result.weights = Vector<t_complex>(size);
+  if (has_time) result.time = Vector<t_real>(size);
+  if (has_baseline) result.baseline = Vector<t_uint>(size);
+  if (image_index) image_index->resize(size);
+  for (t_int i = 0; i < size; i++) {
+    const t_real *const record = records.data() + static_cast<Eigen::Index>(i) * length;
+    result.u(i) = record[0];
+    result.v(i) = record[1];
+    result.w(i) = record[2];
+    result.vis(i) = t_complex(record[3], record[4]);
+    result.weights(i) = t_complex(record[5], record[6]);
+    t_int field = 7;
+    if (has_time) result.time(i) = record[field++];
+    if (has_baseline) result.baseline(i) = static_cast<t_uint>(record[field++]);
+    if (image_index) (*image_index)[i] = static_cast<t_int>(record[field++]);
+  }
+  return result;
+}
+
+//! Sends the visibilities of each group to the node of the same rank, in one message
+//! \details The visibilities are partitioned in place and released once they are packed, and the
+//! packed records are released before the received ones are unpacked, so that at most two copies
+//! of the visibilities are held at once.
+vis_params exchange_by_group(vis_params params, std::vector<t_int> const &groups,
+                             std::vector<t_int> *image_index, sopt::mpi::Communicator const &comm) {
+  // time and baseline are only sent when every node has them
+  std::array<t_int, 2> has_fields{
+      {params.time.size() == params.size(), params.baseline.size() == params.size()}};
+  MPI_Allreduce(MPI_IN_PLACE, has_fields.data(), 2, MPI_INT, MPI_MIN, *comm);
+  const bool has_time = has_fields[0];
+  const bool has_baseline = has_fields[1];
+  vis_header header = make_header(params);
+  MPI_Bcast(header.data(), header.size(), sopt::mpi::Type<t_real>::value, comm.root_id(), *comm);
+
+  const std::vector<t_int> send_sizes =
+      partition_by_group(params, image_index, groups, comm.size());
+  Vector<t_real> send = pack(params, image_index, has_time, has_baseline);
+  params = vis_params();
+  if (image_index) std::vector<t_int>().swap(*image_index);
+  std::vector<t_int> receive_sizes(comm.size());
+  MPI_Alltoall(send_sizes.data(), 1, MPI_INT, receive_sizes.data(), 1, MPI_INT, *comm);
+  std::vector<t_int> send_displs(comm.size(), 0), receive_displs(comm.size(), 0);
+  for (t_int r = 1; r < comm.size(); r++) {
+    send_displs[r] = send_displs[r - 1] + send_sizes[r - 1];
+    receive_displs[r] = receive_displs[r - 1] + receive_sizes[r - 1];
   }
+  const t_int length = record_length(has_time, has_baseline, image_index != nullptr);
+  Vector<t_real> receive(
+      static_cast<Eigen::Index>(receive_displs.back() + receive_sizes.back()) * length);
+  const auto type = record_type(length);
+  MPI_Alltoallv(send.data(), send_sizes.data(), send_displs.data(), *type, receive.data(),
+                receive_sizes.data(), receive_displs.data(), *type, *comm);
+  send.resize(0);
+  vis_params result = unpack(receive, has_time, has_baseline, image_index);
+  set_header(result, header);
+  return result;
+}
+}  // namespace
+
+vis_params regroup_and_scatter(vis_params params, std::vector<t_int> const &groups,
+                               sopt::mpi::Communicator const &comm) {
+  if (comm.size() == 1) return params;
+  if (comm.rank() != comm.root_id()) return scatter_visibilities(comm);
+
+  const t_int has_time = (params.time.size() == params.size());
+  const t_int has_baseline = (params.baseline.size() == params.size());
+  const vis_header vis = make_header(params);
+  const std::vector<t_int> sizes = partition_by_group(params, nullptr, groups, comm.size());
+  Vector<t_real> records = pack(params, nullptr, has_time, has_baseline);
+  params = vis_params();
+  comm.scatter_one(sizes);
+  std::array<t_real, 6> header;
+  std::copy(vis.begin(), vis.end(), header.begin());
+  header[4] = has_time;
+  header[5] = has_baseline;
+  MPI_Bcast(header.data(), header.size(), sopt::mpi::Type<t_real>::value, comm.root_id(), *comm);
+  const t_int length = record_length(has_time, has_baseline, false);
+  std::vector<t_int> displs(comm.size(), 0);
+  for (t_int r = 1; r < comm.size(); r++) displs[r] = displs[r - 1] + sizes[r - 1];
+  Vector<t_real> local(static_cast<Eigen::Index>(sizes[comm.rank()]) * length);
+  const auto type = record_type(length);
+  MPI_Scatterv(records.data(), sizes.data(), displs.data(), *type, local.data(), sizes[comm.rank()],
+               *type, comm.root_id(), *comm);
+  records.resize(0);
+  vis_params result = unpack(local, has_time, has_baseline, nullptr);
+  set_header(result, vis);
+  return result;
+}
 
-  return std::make_tuple(all_to_all_visibilities(copy, sizes, comm),
-                         comm.all_to_allv(index_copy, sizes));
+std::tuple<vis_params, std::vector<t_int>> regroup_and_all_to_all(
+    vis_params params, std::vector<t_int> image_index, std::vector<t_int> const &groups,
+    sopt::mpi::Communicator const &comm) {
+  if (comm.size() == 1) return std::make_tuple(std::move(params), std::move(image_index));
+  if (image_index.size() != params.size())
+    throw std::runtime_error("Number of image indices does not match the number of visibilities.");
+  vis_params result = exchange_by_group(std::move(params), groups, &image_index, comm);
+  return std::make_tuple(std::move(result), std::move(image_index));
 }
 
-vis_params regroup_and_all_to_all(vis_params const &params, std::vector<t_int> const &groups,
+vis_params regroup_and_all_to_all(vis_params params, std::vector<t_int> const &groups,
                                   sopt::mpi::Communicator const &comm) {
-  return std::get<0>(
-      regroup_and_all_to_all(params, std::vector<t_int>(params.size(), 0), groups, comm));
+  if (comm.size() == 1) return params;
+  return exchange_by_group(std::move(params), groups, nullptr, comm);
 }
 
-vis_params all_to_all_visibilities(vis_params const &params, std::vector<t_int> const &sizes,
+vis_params all_to_all_visibilities(vis_params params, std::vector<t_int> const &sizes,
                                    sopt::mpi::Communicator const &comm) {
   if (comm.size() == 1) return params;
-  vis_params result;
-  result.u = comm.all_to_allv(params.u, sizes);
-  result.v = comm.all_to_allv(params.v, sizes);
-  result.w = comm.all_to_allv(params.w, sizes);
-  result.vis = comm.all_to_allv(params.vis, sizes);
-  result.weights = comm.all_to_allv(params.weights, sizes);
-  result.units = static_cast<utilities::vis_units>(comm.broadcast(static_cast<int>(params.units)));
-  result.ra = comm.broadcast(params.ra);
-  result.dec = comm.broadcast(params.dec);
-  result.average_frequency = comm.broadcast(params.average_frequency);
-  return result;
+  std::vector<t_int> groups;
+  groups.reserve(params.size());
+  for (t_int r = 0; r < sizes.size(); r++) groups.insert(groups.end(), sizes[r], r);
+  return exchange_by_group(std::move(params), groups, nullptr, comm);
 }
-vis_params scatter_visibilities(vis_params const &params, std::vector<t_int> const &sizes,
+
+vis_params scatter_visibilities(vis_params params, std::vector<t_int> const &sizes,
                                 sopt::mpi::Communicator const &comm) {
   if (comm.size() == 1) return params;
   if (not comm.is_root()) return scatter_visibilities(comm);
-
-  comm.scatter_one(sizes);
-  vis_params result;
-  result.u = comm.scatterv(params.u, sizes);
-  result.v = comm.scatterv(params.v, sizes);
-  result.w = comm.scatterv(params.w, sizes);
-  result.vis = comm.scatterv(params.vis, sizes);
-  result.weights = comm.scatterv(params.weights, sizes);
-  result.units = static_cast<utilities::vis_units>(comm.broadcast(static_cast<int>(params.units)));
-  result.ra = comm.broadcast(params.ra);
-  result.dec = comm.broadcast(params.dec);
-  result.average_frequency = comm.broadcast(params.average_frequency);
-  return result;
+  std::vector<t_int> groups;
+  groups.reserve(params.size());
+  for (t_int r = 0; r < sizes.size(); r++) groups.insert(groups.end(), sizes[r], r);
+  return regroup_and_scatter(std::move(params), groups, comm);
 }
 
 vis_params scatter_visibilities(sopt::mpi::Communicator const &comm) {
@@ -158,18 +318,17 @@ vis_params scatter_visibilities(sopt::mpi::Communicator const &comm) {
     throw std::runtime_error("The root node should call the *other* scatter_visibilities function");
 
   auto const local_size = comm.scatter_one<t_int>();
-  vis_params result;
-  result.u = comm.scatterv<decltype(result.u)::Scalar>(local_size);
-  result.v = comm.scatterv<decltype(result.v)::Scalar>(local_size);
-  result.w = comm.scatterv<decltype(result.w)::Scalar>(local_size);
-  result.vis = comm.scatterv<decltype(result.vis)::Scalar>(local_size);
-  result.weights = comm.scatterv<decltype(result.weights)::Scalar>(local_size);
-  result.units = static_cast<utilities::vis_units>(
-      comm.broadcast<std::remove_const<decltype(static_cast<int>(result.units))>::type>());
-  result.ra = comm.broadcast<std::remove_const<decltype(result.ra)>::type>();
-  result.dec = comm.broadcast<std::remove_const<decltype(result.dec)>::type>();
-  result.average_frequency =
-      comm.broadcast<std::remove_const<decltype(result.average_frequency)>::type>();
+  std::array<t_real, 6> header;
+  MPI_Bcast(header.data(), header.size(), sopt::mpi::Type<t_real>::value, comm.root_id(), *comm);
+  const bool has_time = header[4];
+  const bool has_baseline = header[5];
+  const t_int length = record_length(has_time, has_baseline, false);
+  Vector<t_real> local(static_cast<Eigen::Index>(local_size) * length);
+  const auto type = record_type(length);
+  MPI_Scatterv(nullptr, nullptr, nullptr, *type, local.data(), local_size, *type, comm.root_id(),
+               *comm);
+  vis_params result = unpack(local, has_time, has_baseline, nullptr);
+  set_header(result, vis_header{{header[0], header[1], header[2], header[3]}});
   return result;
 }
 
@@ -195,9 +354,11 @@ utilities::vis_params set_cell_size(const sopt::mpi::Communicator &comm,
 utilities::vis_params w_stacking(utilities::vis_params const &params,
                                  sopt::mpi::Communicator const &comm, const t_int iters,
                                  const std::function<t_real(t_real)> &cost,
-                                 const t_real k_means_rel_diff) {
+                                 const t_real k_means_rel_diff, const bool optimal_clustering) {
   const std::vector<t_int> image_index = std::get<0>(
-      distribute::kmeans_algo(params.w, comm.size(), iters, comm, cost, k_means_rel_diff));
+      optimal_clustering
+          ? distribute::kmeans_optimal(params.w, comm.size(), comm)
+          : distribute::kmeans_algo(params.w, comm.size(), iters, comm, cost, k_means_rel_diff));
   return utilities::regroup_and_all_to_all(params, image_index, comm);
 }
 std::tuple<utilities::vis_params, std::vector<t_int>, std::vector<t_real>>
@@ -205,9 +366,11 @@ w_stacking_with_all_to_all(utilities::vis_params const &params, const t_real du,
                            const t_int min_support, const t_int max_support,
                            sopt::mpi::Communicator const &comm, const t_int iters,
                            const t_real fill_relaxation, const std::function<t_real(t_real)> &cost,
-                           const t_real k_means_rel_diff) {
+                           const t_real k_means_rel_diff, const bool optimal_clustering) {
   const auto kmeans =
-      distribute::kmeans_algo(params.w, comm.size(), iters, comm, cost, k_means_rel_diff);
+      optimal_clustering
+          ? distribute::kmeans_optimal(params.w, comm.size(), comm)
+          : distribute::kmeans_algo(params.w, comm.size(), iters, comm, cost, k_means_rel_diff);
   const std::vector<t_real> &w_stacks = std::get<1>(kmeans);
   const std::vector<t_int> groups = distribute::w_support(
       params.w, std::get<0>(kmeans), w_stacks, du, min_support, max_support, fill_relaxation, comm);
@@ -218,5 +381,34 @@ w_stacking_with_all_to_all(utilities::vis_params const &params, const t_real du,
   return std::tuple<utilities::vis_params, std::vector<t_int>, std::vector<t_real>>(
       outdata, image_index, w_stacks);
 }
+utilities::vis_params baseline_dependent_averaging(
+    const utilities::vis_params &params, sopt::mpi::Communicator const &comm, const t_real cell_x,
+    const t_real cell_y, const t_uint imsizex, const t_uint imsizey, const distribute::plan plan,
+    const t_real max_shift,
+    const std::function<Vector<t_real>(const utilities::vis_params &)> &cost) {
+  if (comm.size() == 1)
+    return utilities::baseline_dependent_averaging(params, cell_x, cell_y, imsizex, imsizey,
+                                                   max_shift);
+  if (not comm.all_reduce<t_int>(params.time.size() == params.size() and
+                                     params.baseline.size() == params.size(),
+                                 MPI_MIN)) {
+    PURIFY_MEDIUM_LOG("No time or baseline information, skipping baseline dependent averaging.");
+    return params;
+  }
+  // all samples of a baseline have to be on the same node to be averaged
+  std::vector<t_int> groups(params.size());
+  for (t_uint i = 0; i < params.size(); i++) groups[i] = params.baseline(i) % comm.size();
+  utilities::vis_params averaged = utilities::baseline_dependent_averaging(
+      utilities::regroup_and_all_to_all(params, groups, comm), cell_x, cell_y, imsizex, imsizey,
+      max_shift);
+  const t_uint total = comm.all_sum_all(params.size());
+  const t_uint total_averaged = comm.all_sum_all(averaged.size());
+  PURIFY_MEDIUM_LOG("Baseline dependent averaging on all nodes reduced {} visibilities to {}.",
+                    total, total_averaged);
+  // the grouping by baseline is only for averaging, the data is distributed again with the plan
+  const std::vector<t_int> order = distribute::distribute_measurements_parallel(
+      averaged, comm, plan, 128, 65536, cost ? cost(averaged) : Vector<t_real>());
+  return utilities::regroup_and_all_to_all(std::move(averaged), order, comm);
+}
 }  // namespace utilities
 }  // namespace purify
@@ -2,7 +2,9 @@
 #define PURIFY_MPI_UTILITIES_H
 
 #include "purify/config.h"
+#include <functional>
 #include <vector>
+#include "purify/distribute.h"
 #include "purify/uvw_utilities.h"
 #include <sopt/linear_transform.h>
 
@@ -20,18 +22,22 @@ void regroup(utilities::vis_params &params, std::vector<t_int> const &groups,
 void regroup(vis_params &uv_params, std::vector<t_int> &image_index,
              std::vector<t_int> const &groups_, const t_int max_groups);
 //! \brief regroup and distributes data
-vis_params regroup_and_scatter(vis_params const &params, std::vector<t_int> const &groups,
+//! \details params is taken by value and partitioned in place, move it in when it is not needed
+//! afterwards.
+vis_params regroup_and_scatter(vis_params params, std::vector<t_int> const &groups,
                                sopt::mpi::Communicator const &comm);
 //! \brief regroup and distributes data to and from all nodes
+//! \details params is taken by value and partitioned in place, move it in when it is not needed
+//! afterwards.
 std::tuple<vis_params, std::vector<t_int>> regroup_and_all_to_all(
-    vis_params const &params, const std::vector<t_int> &image_index,
-    std::vector<t_int> const &groups, sopt::mpi::Communicator const &comm);
+    vis_params params, std::vector<t_int> image_index, std::vector<t_int> const &groups,
+    sopt::mpi::Communicator const &comm);
 //! \brief without image index
-vis_params regroup_and_all_to_all(vis_params const &params, std::vector<t_int> const &groups,
+vis_params regroup_and_all_to_all(vis_params params, std::vector<t_int> const &groups,
                                   sopt::mpi::Communicator const &comm);
 //! \brief distribute data according to input order
 //! \brief Can be called by any proc
-vis_params scatter_visibilities(vis_params const &params, std::vector<t_int> const &sizes,
+vis_params scatter_visibilities(vis_params params, std::vector<t_int> const &sizes,
                                 sopt::mpi::Communicator const &comm);
 
 //! \brief Receives data scattered from root
@@ -39,7 +45,7 @@ vis_params scatter_visibilities(vis_params const &params, std::vector<t_int> con
 vis_params scatter_visibilities(sopt::mpi::Communicator const &comm);
 //! \brief Sends and recieves data between all nodes
 //! \details Should be called by all procs
-vis_params all_to_all_visibilities(vis_params const &params, std::vector<t_int> const &sizes,
+vis_params all_to_all_visibilities(vis_params params, std::vector<t_int> const &sizes,
                                    sopt::mpi::Communicator const &comm);
 //! \brief distribute from root to all comm
 utilities::vis_params distribute_params(utilities::vis_params const &params,
@@ -49,10 +55,13 @@ utilities::vis_params set_cell_size(const sopt::mpi::Communicator &comm,
                                     utilities::vis_params const &uv_vis, const t_real &cell_x,
                                     const t_real &cell_y);
 //! \brief distribute data, sort into w-stacks using MPI, then distribute the stacks
+//! \details With optimal_clustering the w-stacks are found by distribute::kmeans_optimal instead
+//! of iterating k-means.
 utilities::vis_params w_stacking(utilities::vis_params const &params,
                                  sopt::mpi::Communicator const &comm, const t_int iters,
                                  const std::function<t_real(t_real)> &cost,
-                                 const t_real k_means_rel_diff = 1e-5);
+                                 const t_real k_means_rel_diff = 1e-5,
+                                 const bool optimal_clustering = false);
 //! \brief distribute data, sort into w-stacks using MPI, then distribute the stacks for all to all
 //! operator
 std::tuple<utilities::vis_params, std::vector<t_int>, std::vector<t_real>>
@@ -60,7 +69,16 @@ w_stacking_with_all_to_all(utilities::vis_params const &params, const t_real du,
                            const t_int min_support, const t_int max_support,
                            sopt::mpi::Communicator const &comm, const t_int iters,
                            const t_real fill_relaxation, const std::function<t_real(t_real)> &cost,
-                           const t_real k_means_rel_diff = 1e-5);
+                           const t_real k_means_rel_diff = 1e-5,
+                           const bool optimal_clustering = false);
+//! \brief moves each baseline to a single node and applies baseline dependent averaging
+//! \details The averaged visibilities are then distributed between the nodes with the plan,
+//! balancing the cost of each visibility with the bisection plans when it is given.
+utilities::vis_params baseline_dependent_averaging(
+    const utilities::vis_params &params, sopt::mpi::Communicator const &comm, const t_real cell_x,
+    const t_real cell_y, const t_uint imsizex, const t_uint imsizey, const distribute::plan plan,
+    const t_real max_shift = 0.1,
+    const std::function<Vector<t_real>(const utilities::vis_params &)> &cost = nullptr);
 #endif
 //! \brief Calculate step size using MPI (does not include factor of 1e-3)
 //! \param[in] vis: Vector of measurement data
@@ -49,6 +49,17 @@ Image<t_complex> init_correction2d(const t_real &oversample_ratio, const t_uint
                                    const std::function<t_real(t_real)> ftkernelu,
                                    const std::function<t_real(t_real)> ftkernelv,
                                    const t_real &w_mean, const t_real &cellx, const t_real &celly) {
+  return init_correction2d(oversample_ratio, imsizey_, imsizex_, ftkernelu, ftkernelv, w_mean,
+                           cellx, celly, 0, imsizey_);
+}
+
+Image<t_complex> init_correction2d(const t_real &oversample_ratio, const t_uint &imsizey_,
+                                   const t_uint &imsizex_,
+                                   const std::function<t_real(t_real)> ftkernelu,
+                                   const std::function<t_real(t_real)> ftkernelv,
+                                   const t_real &w_mean, const t_real &cellx, const t_real &celly,
+                                   const t_uint row_start, const t_uint rows) {
+  assert(row_start + rows <= imsizey_);
   const t_uint ftsizeu_ = std::floor(imsizex_ * oversample_ratio);
   const t_uint ftsizev_ = std::floor(imsizey_ * oversample_ratio);
   const t_uint x_start = std::floor(ftsizeu_ * 0.5 - imsizex_ * 0.5);
@@ -56,12 +67,13 @@ Image<t_complex> init_correction2d(const t_real &oversample_ratio, const t_uint
 
   Array<t_real> range;
   range.setLinSpaced(std::max(ftsizeu_, ftsizev_), 0.5, std::max(ftsizeu_, ftsizev_) - 0.5);
-  return ((1e0 / range.segment(y_start, imsizey_).unaryExpr(ftkernelv)).matrix() *
+  return ((1e0 / range.segment(y_start + row_start, rows).unaryExpr(ftkernelv)).matrix() *
           (1e0 / range.segment(x_start, imsizex_).unaryExpr(ftkernelu)).matrix().transpose())
              .array() *
          t_complex(1., 0.) *
-         widefield::generate_chirp(w_mean, cellx, celly, imsizex_, imsizey_).array() * imsizex_ *
-         imsizey_;
+         widefield::generate_chirp_rows(w_mean, cellx, celly, imsizex_, imsizey_, row_start, rows)
+             .array() *
+         imsizex_ * imsizey_;
 }
 
 }  // namespace details
@@ -23,6 +23,7 @@
 #include "purify/AllToAllSparseVector.h"
 #include "purify/DistributeSparseVector.h"
 #include "purify/IndexMapping.h"
+#include "purify/NodeAwareReduction.h"
 #include "purify/mpi_utilities.h"
 #include <sopt/mpi/communicator.h>
 #endif
@@ -218,6 +219,13 @@ Image<t_complex> init_correction2d(const t_real &oversample_ratio, const t_uint
                                    const std::function<t_real(t_real)> ftkernelu,
                                    const std::function<t_real(t_real)> ftkernelv,
                                    const t_real &w_mean, const t_real &cellx, const t_real &celly);
+//! Rows [row_start, row_start + rows) of the scaling image for gridding correction
+Image<t_complex> init_correction2d(const t_real &oversample_ratio, const t_uint &imsizey_,
+                                   const t_uint &imsizex_,
+                                   const std::function<t_real(t_real)> ftkernelu,
+                                   const std::function<t_real(t_real)> ftkernelv,
+                                   const t_real &w_mean, const t_real &cellx, const t_real &celly,
+                                   const t_uint row_start, const t_uint rows);
 
 //! Construct gridding matrix with mixing
 template <class T, class... ARGS>
@@ -267,15 +275,13 @@ std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_gridding_m
       });
 }
 
-//! Constructs degridding operator using MPI all to all
-template <class T, class STORAGE_INDEX_TYPE, class... ARGS>
+//! Constructs degridding operator using MPI all to all from a gridding matrix whose columns are
+//! the grids of all nodes
+template <class T, class STORAGE_INDEX_TYPE>
 std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_gridding_matrix_2d_all_to_all(
     const sopt::mpi::Communicator &comm, const STORAGE_INDEX_TYPE local_grid_size,
-    const STORAGE_INDEX_TYPE start_index, const t_uint number_of_images,
-    const std::vector<t_int> &image_index, ARGS &&... args) {
-  Sparse<t_complex, STORAGE_INDEX_TYPE> interpolation_matrix_original =
-      details::init_gridding_matrix_2d<STORAGE_INDEX_TYPE>(number_of_images, image_index,
-                                                           std::forward<ARGS>(args)...);
+    const STORAGE_INDEX_TYPE start_index,
+    const Sparse<t_complex, STORAGE_INDEX_TYPE> &interpolation_matrix_original) {
   const AllToAllSparseVector<STORAGE_INDEX_TYPE> distributor(interpolation_matrix_original,
                                                              local_grid_size, start_index, comm);
   const std::shared_ptr<const Sparse<t_complex>> interpolation_matrix =
@@ -295,6 +301,80 @@ std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_gridding_m
       });
 }
 
+//! Constructs degridding operator using MPI all to all
+template <class T, class STORAGE_INDEX_TYPE, class... ARGS>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_gridding_matrix_2d_all_to_all(
+    const sopt::mpi::Communicator &comm, const STORAGE_INDEX_TYPE local_grid_size,
+    const STORAGE_INDEX_TYPE start_index, const t_uint number_of_images,
+    const std::vector<t_int> &image_index, ARGS &&... args) {
+  return init_gridding_matrix_2d_all_to_all<T, STORAGE_INDEX_TYPE>(
+      comm, local_grid_size, start_index,
+      details::init_gridding_matrix_2d<STORAGE_INDEX_TYPE>(number_of_images, image_index,
+                                                           std::forward<ARGS>(args)...));
+}
+
+//! Constructs degridding operator using MPI all to all, where the sparse multiplication with the
+//! grid from each node overlaps with the communication of the grid from the other nodes
+template <class T, class STORAGE_INDEX_TYPE, class... ARGS>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>>
+init_gridding_matrix_2d_all_to_all_pipelined(const sopt::mpi::Communicator &comm,
+                                             const STORAGE_INDEX_TYPE local_grid_size,
+                                             const STORAGE_INDEX_TYPE start_index,
+                                             const t_uint number_of_images,
+                                             const std::vector<t_int> &image_index,
+                                             ARGS &&... args) {
+  Sparse<t_complex, STORAGE_INDEX_TYPE> interpolation_matrix_original =
+      details::init_gridding_matrix_2d<STORAGE_INDEX_TYPE>(number_of_images, image_index,
+                                                           std::forward<ARGS>(args)...);
+  const AllToAllSparseVector<STORAGE_INDEX_TYPE> distributor(interpolation_matrix_original,
+                                                             local_grid_size, start_index, comm);
+  const Sparse<t_complex> interpolation_matrix =
+      purify::compress_outer(interpolation_matrix_original);
+  // columns of the compressed matrix are ordered by the node that holds the grid point, and each
+  // block only keeps the visibilities that use grid points of its node
+  typedef std::tuple<std::vector<t_int>, Sparse<t_complex>> Block;
+  const std::shared_ptr<const std::vector<Block>> blocks =
+      std::make_shared<const std::vector<Block>>(
+          purify::split_columns(interpolation_matrix, distributor.recv_grid_sizes()));
+  std::vector<Sparse<t_complex>> adjoint_blocks_original;
+  for (auto const &block : *blocks)
+    adjoint_blocks_original.emplace_back(std::get<1>(block).adjoint());
+  const std::shared_ptr<const std::vector<Sparse<t_complex>>> adjoint_blocks =
+      std::make_shared<const std::vector<Sparse<t_complex>>>(std::move(adjoint_blocks_original));
+  const t_int rows = interpolation_matrix.rows();
+
+  return std::make_tuple(
+      [=](T &output, const T &input) {
+        assert(input.size() > 0);
+        // the product with each block is calculated as it arrives, and the products are added
+        // in the order of the nodes so that the result does not depend on the order of arrival
+        std::vector<Vector<typename T::Scalar>> products(blocks->size());
+        distributor.recv_grid_pipelined(
+            input, [&products, &blocks](const t_int node,
+                                        const Eigen::Ref<const Vector<typename T::Scalar>> &block) {
+              products[node] =
+                  utilities::sparse_multiply_matrix(std::get<1>(blocks->at(node)), block);
+            });
+        output = T::Zero(rows);
+        for (std::size_t node = 0; node < blocks->size(); node++) {
+          const std::vector<t_int> &block_rows = std::get<0>(blocks->at(node));
+#pragma omp parallel for
+          for (t_int k = 0; k < block_rows.size(); k++) output(block_rows[k]) += products[node](k);
+        }
+      },
+      [=](T &output, const T &input) {
+        distributor.send_grid_pipelined(
+            [&input, &blocks, &adjoint_blocks](const t_int node) -> Vector<typename T::Scalar> {
+              // only the visibilities with nonzeros in the block contribute
+              const std::vector<t_int> &block_rows = std::get<0>(blocks->at(node));
+              Vector<typename T::Scalar> block_input(block_rows.size());
+              for (t_int k = 0; k < block_rows.size(); k++) block_input(k) = input(block_rows[k]);
+              return utilities::sparse_multiply_matrix(adjoint_blocks->at(node), block_input);
+            },
+            output);
+      });
+}
+
 //! Construct MPI broadcast operator
 template <class T>
 sopt::OperatorFunction<T> init_broadcaster(const sopt::mpi::Communicator &comm) {
@@ -302,9 +382,14 @@ sopt::OperatorFunction<T> init_broadcaster(const sopt::mpi::Communicator &comm)
 }
 
 //! Construct MPI all sum all operator
+//! \details Reduces through shared memory on each compute node when
+//! NodeAwareReduction::shared_memory_default() is set, and with a flat all reduce otherwise.
 template <class T>
 sopt::OperatorFunction<T> init_all_sum_all(const sopt::mpi::Communicator &comm) {
-  return [=](T &output, const T &input) { output = comm.all_sum_all<T>(input).eval(); };
+  const auto reduction = std::make_shared<const NodeAwareReduction>(comm);
+  return [=](T &output, const T &input) {
+    output = reduction->all_sum_all<typename T::Scalar>(input);
+  };
 }
 #endif
 //! constructs lambdas that apply degridding matrix with adjoint
@@ -566,7 +651,8 @@ base_mpi_all_to_all_degrid_operator_2d(
     const t_uint &imsizex, const t_real oversample_ratio = 2,
     const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
     const operators::fftw_plan ft_plan = operators::fftw_plan::measure,
-    const bool w_stacking = false, const t_real cellx = 1, const t_real celly = 1) {
+    const bool w_stacking = false, const t_real cellx = 1, const t_real celly = 1,
+    const bool pipelined = false) {
   const t_uint number_of_images = comm.size();
   if (std::any_of(image_index.begin(), image_index.end(), [&number_of_images](int index) {
         return index < 0 or index > (number_of_images - 1);
@@ -587,11 +673,17 @@ base_mpi_all_to_all_degrid_operator_2d(
   const t_int local_grid_size =
       std::floor(imsizex * oversample_ratio) * std::floor(imsizex * oversample_ratio);
   std::tie(directG, indirectG) =
-      purify::operators::init_gridding_matrix_2d_all_to_all<T, std::int64_t>(
-          comm, static_cast<std::int64_t>(local_grid_size),
-          static_cast<std::int64_t>(comm.rank()) * static_cast<std::int64_t>(local_grid_size),
-          number_of_images, image_index, u, v, weights, imsizey, imsizex, oversample_ratio, kernelv,
-          kernelu, Ju, Jv);
+      pipelined
+          ? purify::operators::init_gridding_matrix_2d_all_to_all_pipelined<T, std::int64_t>(
+                comm, static_cast<std::int64_t>(local_grid_size),
+                static_cast<std::int64_t>(comm.rank()) * static_cast<std::int64_t>(local_grid_size),
+                number_of_images, image_index, u, v, weights, imsizey, imsizex, oversample_ratio,
+                kernelv, kernelu, Ju, Jv)
+          : purify::operators::init_gridding_matrix_2d_all_to_all<T, std::int64_t>(
+                comm, static_cast<std::int64_t>(local_grid_size),
+                static_cast<std::int64_t>(comm.rank()) * static_cast<std::int64_t>(local_grid_size),
+                number_of_images, image_index, u, v, weights, imsizey, imsizex, oversample_ratio,
+                kernelv, kernelu, Ju, Jv);
   auto direct = sopt::chained_operators<T>(directG, directFZ);
   auto indirect = sopt::chained_operators<T>(indirectFZ, indirectG);
   PURIFY_LOW_LOG("Finished consturction of Φ.");
@@ -713,7 +805,8 @@ std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_all_to_all(
     const Vector<t_real> &w, const Vector<t_complex> &weights, const t_uint imsizey,
     const t_uint imsizex, const t_real oversample_ratio = 2,
     const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
-    const bool w_stacking = false, const t_real cellx = 1, const t_real celly = 1) {
+    const bool w_stacking = false, const t_real cellx = 1, const t_real celly = 1,
+    const bool pipelined = false) {
   const operators::fftw_plan ft_plan = operators::fftw_plan::measure;
   std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
   std::array<t_int, 3> M = {0, 1, static_cast<t_int>(u.size())};
@@ -722,7 +815,7 @@ std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_all_to_all(
   std::tie(directDegrid, indirectDegrid) =
       purify::operators::base_mpi_all_to_all_degrid_operator_2d<T>(
           comm, image_index, w_stacks, u, v, w, weights, imsizey, imsizex, oversample_ratio, kernel,
-          Ju, Jv, ft_plan, w_stacking, cellx, celly);
+          Ju, Jv, ft_plan, w_stacking, cellx, celly, pipelined);
 
   const auto allsumall = purify::operators::init_all_sum_all<T>(comm);
   auto direct = directDegrid;
@@ -736,12 +829,13 @@ std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_all_to_all(
     const std::vector<t_real> &w_stacks, const utilities::vis_params &uv_vis_input,
     const t_uint imsizey, const t_uint imsizex, const t_real cell_x, const t_real cell_y,
     const t_real oversample_ratio = 2, const kernels::kernel kernel = kernels::kernel::kb,
-    const t_uint Ju = 4, const t_uint Jv = 4, const bool w_stacking = false) {
+    const t_uint Ju = 4, const t_uint Jv = 4, const bool w_stacking = false,
+    const bool pipelined = false) {
   const auto uv_vis = utilities::convert_to_pixels(uv_vis_input, cell_x, cell_y, imsizex, imsizey,
                                                    oversample_ratio);
   return init_degrid_operator_2d_all_to_all<T>(
       comm, image_index, w_stacks, uv_vis.u, uv_vis.v, uv_vis.w, uv_vis.weights, imsizey, imsizex,
-      oversample_ratio, kernel, Ju, Jv, w_stacking, cell_x, cell_y);
+      oversample_ratio, kernel, Ju, Jv, w_stacking, cell_x, cell_y, pipelined);
 }
 #endif
 
@@ -0,0 +1,157 @@
+#ifndef PURIFY_PSF_OPERATOR_H
+#define PURIFY_PSF_OPERATOR_H
+
+#include "purify/config.h"
+#include "purify/types.h"
+#include <array>
+#include <memory>
+#include <tuple>
+#include "purify/logging.h"
+#include "purify/operators.h"
+#include "purify/utilities.h"
+#include "purify/uvw_utilities.h"
+#include <sopt/chained_operators.h>
+#include <sopt/linear_transform.h>
+
+#ifdef PURIFY_MPI
+#include <sopt/mpi/communicator.h>
+#endif
+
+namespace purify {
+
+namespace operators {
+
+//! Constructs operator that convolves an image with a PSF sampled on an image of twice the size
+//! \details The PSF is centred at (imsizey, imsizex). The image is zero padded to twice the size
+//! so that the circular convolution of the FFT is the linear (Toeplitz) convolution.
+template <class T>
+sopt::OperatorFunction<T> init_psf_convolution_2d(const T &psf, const t_uint imsizey,
+                                                  const t_uint imsizex,
+                                                  const fftw_plan ft_plan = fftw_plan::measure) {
+  const t_uint ftsizev = 2 * imsizey;
+  const t_uint ftsizeu = 2 * imsizex;
+  if (psf.size() != ftsizev * ftsizeu)
+    throw std::runtime_error("PSF is not twice the size of the image in each dimension.");
+  sopt::OperatorFunction<T> directFFT, indirectFFT;
+  std::tie(directFFT, indirectFFT) = init_FFT_2d<T>(imsizey, imsizex, 2., ft_plan);
+  // move the centre of the PSF to the origin
+  T shifted_psf = T::Zero(ftsizev * ftsizeu);
+#pragma omp parallel for collapse(2)
+  for (t_uint j = 0; j < ftsizev; j++)
+    for (t_uint i = 0; i < ftsizeu; i++)
+      shifted_psf(utilities::sub2ind(j, i, ftsizev, ftsizeu)) =
+          psf(utilities::sub2ind((j + imsizey) % ftsizev, (i + imsizex) % ftsizeu, ftsizev,
+                                 ftsizeu));
+  T transfer;
+  directFFT(transfer, shifted_psf);
+  // the FFT operators are unitary, so the convolution picks up the square root of the grid size
+  const std::shared_ptr<const T> transfer_function = std::make_shared<const T>(
+      transfer * std::sqrt(static_cast<t_real>(ftsizev * ftsizeu)));
+  return [=](T &output, const T &input) {
+    assert(input.size() == imsizey * imsizex);
+    T padded = T::Zero(ftsizev * ftsizeu);
+#pragma omp parallel for collapse(2)
+    for (t_uint j = 0; j < imsizey; j++)
+      for (t_uint i = 0; i < imsizex; i++)
+        padded(utilities::sub2ind(j, i, ftsizev, ftsizeu)) =
+            input(utilities::sub2ind(j, i, imsizey, imsizex));
+    T spectrum;
+    directFFT(spectrum, padded);
+    spectrum = spectrum.cwiseProduct(*transfer_function);
+    indirectFFT(padded, spectrum);
+    output = T::Zero(imsizey * imsizex);
+#pragma omp parallel for collapse(2)
+    for (t_uint j = 0; j < imsizey; j++)
+      for (t_uint i = 0; i < imsizex; i++)
+        output(utilities::sub2ind(j, i, imsizey, imsizex)) =
+            padded(utilities::sub2ind(j, i, ftsizev, ftsizeu));
+  };
+}
+
+//! Calculates the PSF of the weighted measurements on an image twice the size of the image
+template <class T>
+T psf_2d(const utilities::vis_params &uv_vis, const t_uint imsizey, const t_uint imsizex,
+         const t_real cell_x, const t_real cell_y, const t_real oversample_ratio = 2,
+         const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4,
+         const t_uint Jv = 4, const bool w_stacking = false) {
+  PURIFY_LOW_LOG("Calculating PSF on a {} x {} image", 2 * imsizex, 2 * imsizey);
+  // same cell size, so the field of view is doubled
+  const auto measure_op = measurementoperator::init_degrid_operator_2d<T>(
+      uv_vis, 2 * imsizey, 2 * imsizex, cell_x, cell_y, oversample_ratio, kernel, Ju, Jv,
+      w_stacking);
+  return measure_op->adjoint() * uv_vis.weights;
+}
+}  // namespace operators
+
+namespace measurementoperator {
+
+//! Returns the normal operator Φ†Φ as a convolution with the PSF, which is calculated once
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_psf_normal_operator_2d(
+    const utilities::vis_params &uv_vis, const t_uint imsizey, const t_uint imsizex,
+    const t_real cell_x, const t_real cell_y, const t_real oversample_ratio = 2,
+    const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
+    const bool w_stacking = false) {
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  const auto normal = operators::init_psf_convolution_2d<T>(
+      operators::psf_2d<T>(uv_vis, imsizey, imsizex, cell_x, cell_y, oversample_ratio, kernel, Ju,
+                           Jv, w_stacking),
+      imsizey, imsizex);
+  return std::make_shared<sopt::LinearTransform<T>>(normal, N, normal, N);
+}
+
+//! Returns operator (Φ†Φ, I) so that a solver computing Φ'†(Φ'x - y') with y' = Φ†y obtains
+//! the gradient Φ†(Φx - y) without gridding
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_psf_gradient_operator_2d(
+    const std::shared_ptr<sopt::LinearTransform<T> const> &normal_operator, const t_uint imsizey,
+    const t_uint imsizex) {
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  const auto direct = [normal_operator](T &output, const T &input) {
+    output = *normal_operator * input;
+  };
+  const auto indirect = [](T &output, const T &input) { output = input; };
+  return std::make_shared<sopt::LinearTransform<T>>(direct, N, indirect, N);
+}
+
+#ifdef PURIFY_MPI
+//! Returns the normal operator Φ†Φ for distributed measurements, the PSF is reduced once
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_psf_normal_operator_2d(
+    const sopt::mpi::Communicator &comm, const utilities::vis_params &uv_vis,
+    const t_uint imsizey, const t_uint imsizex, const t_real cell_x, const t_real cell_y,
+    const t_real oversample_ratio = 2, const kernels::kernel kernel = kernels::kernel::kb,
+    const t_uint Ju = 4, const t_uint Jv = 4, const bool w_stacking = false) {
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  const T psf = comm.all_sum_all<T>(operators::psf_2d<T>(
+      uv_vis, imsizey, imsizex, cell_x, cell_y, oversample_ratio, kernel, Ju, Jv, w_stacking));
+  const auto normal = operators::init_psf_convolution_2d<T>(psf, imsizey, imsizex);
+  return std::make_shared<sopt::LinearTransform<T>>(normal, N, normal, N);
+}
+
+//! Returns operator (Φ†Φ, I) for solvers that sum the data fidelity over comm
+//! \details The image space residual is only held by the root node, so that it is counted once,
+//! and broadcast in the adjoint.
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_psf_gradient_operator_2d(
+    const sopt::mpi::Communicator &comm,
+    const std::shared_ptr<sopt::LinearTransform<T> const> &normal_operator, const t_uint imsizey,
+    const t_uint imsizex) {
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  std::array<t_int, 3> M = {0, 1, static_cast<t_int>(comm.is_root() ? imsizey * imsizex : 0)};
+  const auto direct = [normal_operator, comm](T &output, const T &input) {
+    if (comm.is_root())
+      output = *normal_operator * input;
+    else
+      output = T::Zero(0);
+  };
+  const auto indirect = [comm, imsizey, imsizex](T &output, const T &input) {
+    output = comm.broadcast<T>(comm.is_root() ? input : T::Zero(imsizey * imsizex).eval()).eval();
+  };
+  return std::make_shared<sopt::LinearTransform<T>>(direct, M, indirect, N);
+}
+#endif
+
+}  // namespace measurementoperator
+}  // namespace purify
+#endif
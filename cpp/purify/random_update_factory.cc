@@ -1,33 +1,76 @@
 #include "purify/random_update_factory.h"
 #include <algorithm>
 #include <random>
+#include <unordered_map>
 
 namespace purify {
 namespace random_updater {
+namespace {
+//! Finaliser of splitmix64, which maps consecutive integers to uncorrelated ones
+std::uint64_t mix(std::uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+//! Uniform number in [0, 1) for a position of the stream of an iteration
+t_real counter_uniform(const std::uint64_t seed, const std::uint64_t iteration,
+                       const std::uint64_t position) {
+  const std::uint64_t bits =
+      mix(mix(seed + 0x9e3779b97f4a7c15ull * (iteration + 1)) + 0x9e3779b97f4a7c15ull * position);
+  return (bits >> 11) * (1. / 9007199254740992.);
+}
+}  // namespace
+
+std::vector<t_int> random_selection(const std::uint64_t seed, const std::uint64_t iteration,
+                                    const t_int total, const t_int update_size) {
+  if (update_size > total)
+    throw std::runtime_error("Cannot select " + std::to_string(update_size) + " out of " +
+                             std::to_string(total) + ".");
+  // only the selected part of the Fisher-Yates shuffle is needed, and only the swapped entries
+  // of the permutation are stored, so that the cost does not grow with total
+  std::unordered_map<t_int, t_int> swapped;
+  const auto entry = [&swapped](const t_int i) {
+    const auto found = swapped.find(i);
+    return (found == swapped.end()) ? i : found->second;
+  };
+  std::vector<t_int> ind(std::max(update_size, 0));
+  for (t_int i = 0; i < update_size; i++) {
+    const t_int j = std::min<t_int>(
+        total - 1, i + std::floor(counter_uniform(seed, iteration, i) * (total - i)));
+    ind[i] = entry(j);
+    swapped[j] = entry(i);
+  }
+  return ind;
+}
+
 std::function<bool()> random_updater(const sopt::mpi::Communicator& comm, const t_int total,
                                      const t_int update_size,
                                      const std::shared_ptr<bool> update_pointer,
                                      const std::string& update_name) {
+  std::random_device rng;
+  const t_int local_seed = static_cast<t_int>(rng());
+  return random_updater(comm, total, update_size, update_pointer, update_name,
+                        static_cast<std::uint32_t>(comm.broadcast(local_seed)));
+}
+
+std::function<bool()> random_updater(const sopt::mpi::Communicator& comm, const t_int total,
+                                     const t_int update_size,
+                                     const std::shared_ptr<bool> update_pointer,
+                                     const std::string& update_name, const std::uint64_t seed) {
   if (update_size > comm.size())
     throw std::runtime_error(
         "Number of random updates cannot be greater than number of MPI processors in the "
         "communicator " +
         std::to_string(comm.size()) + " < " + std::to_string(update_size) + " .");
-  std::shared_ptr<std::vector<t_int>> ind = std::make_shared<std::vector<t_int>>(total, 0);
-  for (t_int i = 0; i < total; i++) (*ind)[i] = i;
-  std::random_device rng;
-  std::shared_ptr<std::mt19937> urng = std::make_shared<std::mt19937>(rng());
-  return [update_pointer, update_size, update_name, ind, comm, urng]() -> bool {
-    if (comm.is_root()) {
-      std::shuffle(std::begin(*ind), std::end(*ind), *urng);
-    };
-    *ind = comm.broadcast(*ind);
-    *update_pointer = false;
-    for (t_int i = 0; i < update_size; i++)
-      if (comm.rank() == ind->at(i)) {
-        SOPT_DEBUG("Process {} doing {}", comm.rank(), update_name);
-        *update_pointer = true;
-      }
+  const std::uint64_t shared_seed = seed;
+  std::shared_ptr<std::uint64_t> iteration = std::make_shared<std::uint64_t>(0);
+  return [update_pointer, update_size, update_name, total, comm, shared_seed,
+          iteration]() -> bool {
+    const std::vector<t_int> selected =
+        random_selection(shared_seed, (*iteration)++, total, update_size);
+    *update_pointer = std::find(selected.begin(), selected.end(),
+                                static_cast<t_int>(comm.rank())) != selected.end();
+    if (*update_pointer) SOPT_DEBUG("Process {} doing {}", comm.rank(), update_name);
     return *update_pointer;
   };
 }
@@ -4,6 +4,7 @@
 #include "purify/config.h"
 
 #include "purify/types.h"
+#include <cstdint>
 #include "purify/convergence_factory.h"
 #include "purify/logging.h"
 #include "purify/utilities.h"
@@ -13,7 +14,23 @@
 #include <sopt/mpi/communicator.h>
 namespace purify {
 namespace random_updater {
-//! Creates lambda that controls random updates
+//! Processes selected to update at an iteration
+//! \details The first update_size entries of a shuffle of 0, ..., total - 1. The shuffle only
+//! depends on the seed and the iteration through a counter based generator, so that every
+//! process computes the same selection without communication.
+std::vector<t_int> random_selection(const std::uint64_t seed, const std::uint64_t iteration,
+                                    const t_int total, const t_int update_size);
+
+//! Creates lambda that controls random updates from a given seed
+//! \details Each call is one iteration, and sets update_pointer if this process is selected by
+//! random_selection. The lambda does not communicate, so processes that are not selected do not
+//! wait on the others. The seed must be the same on every process.
+std::function<bool()> random_updater(const sopt::mpi::Communicator& comm, const t_int total,
+                                     const t_int update_size,
+                                     const std::shared_ptr<bool> update_pointer,
+                                     const std::string& update_name, const std::uint64_t seed);
+//! Creates lambda that controls random updates from a random seed
+//! \details The seed is drawn on the root process and broadcast once.
 std::function<bool()> random_updater(const sopt::mpi::Communicator& comm, const t_int total,
                                      const t_int update_size,
                                      const std::shared_ptr<bool> update_pointer,
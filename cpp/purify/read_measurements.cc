@@ -1,11 +1,15 @@
 #include "purify/read_measurements.h"
 
+#include "purify/binary_visibilities.h"
 #include "purify/uvfits.h"
 
 #ifdef PURIFY_CASACORE
 #include "purify/casacore.h"
 #endif
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <tuple>
 #include <boost/filesystem.hpp>
 #include <sys/stat.h>
 
@@ -14,12 +18,9 @@
 #endif
 namespace purify {
 namespace read_measurements {
-utilities::vis_params read_measurements(const std::string &name, const bool w_term,
-                                        const stokes pol, const utilities::vis_units units) {
-  return read_measurements(std::vector<std::string>{name}, w_term, pol, units);
-}
-utilities::vis_params read_measurements(const std::vector<std::string> &names, const bool w_term,
-                                        const stokes pol, const utilities::vis_units units) {
+namespace {
+//! Removes missing files from the list and checks that all files have the same format
+std::tuple<std::vector<std::string>, format> check_files(const std::vector<std::string> &names) {
   std::vector<std::string> found_files;
   format format_type = format::uvfits;
   for (t_int i = 0; i < names.size(); i++) {
@@ -42,13 +43,17 @@ utilities::vis_params read_measurements(const std::vector<std::string> &names, c
         format_check = format::vis;
         if (not file_exists(file_path.native()))
           throw std::runtime_error(names.at(i) + " is not a regular file.");
+      } else if (format_string == ".bvis") {
+        format_check = format::binary;
+        if (not file_exists(file_path.native()))
+          throw std::runtime_error(names.at(i) + " is not a regular file.");
       } else if (format_string == ".uvfits") {
         format_check = format::uvfits;
         if (not file_exists(file_path.native()))
           throw std::runtime_error(names.at(i) + " is not a regular file.");
       } else
         throw std::runtime_error("File extention for " + names.at(i) +
-                                 " not recognised. Must be .vis, .uvfits, or .ms.");
+                                 " not recognised. Must be .vis, .bvis, .uvfits, or .ms.");
       if (i == 0) format_type = format_check;
       if (i > 0 and (format_check != format_type))
         throw std::runtime_error("File extention is not the same for " + names.at(i) + " " +
@@ -57,6 +62,30 @@ utilities::vis_params read_measurements(const std::vector<std::string> &names, c
   }
 
   if (found_files.size() == 0) throw std::runtime_error("No files found, all files are missing!");
+  return std::make_tuple(found_files, format_type);
+}
+//! Applies the reading options to binary visibilities, which carry their units in the header
+void binary_options(utilities::vis_params &measurements, const bool w_term,
+                    const utilities::vis_units units) {
+  // units can not be converted without the image geometry, so the stored units are kept and
+  // converted along with the measurements when the operators are built
+  const std::string names[] = {"lambda", "radians", "pixels"};
+  if (measurements.units != units)
+    PURIFY_WARN("Binary visibilities are stored in units of {}, not {} as requested.",
+                names[static_cast<t_int>(measurements.units)], names[static_cast<t_int>(units)]);
+  if (not w_term) measurements.w = Vector<t_real>::Zero(measurements.size());
+}
+}  // namespace
+
+utilities::vis_params read_measurements(const std::string &name, const bool w_term,
+                                        const stokes pol, const utilities::vis_units units) {
+  return read_measurements(std::vector<std::string>{name}, w_term, pol, units);
+}
+utilities::vis_params read_measurements(const std::vector<std::string> &names, const bool w_term,
+                                        const stokes pol, const utilities::vis_units units) {
+  std::vector<std::string> found_files;
+  format format_type;
+  std::tie(found_files, format_type) = check_files(names);
   switch (format_type) {
   case (format::vis): {
     if (pol != stokes::I)
@@ -68,6 +97,12 @@ utilities::vis_params read_measurements(const std::vector<std::string> &names, c
     return measurements;
     break;
   }
+  case (format::binary): {
+    auto measurements = utilities::read_binary_visibility(found_files);
+    binary_options(measurements, w_term, units);
+    return measurements;
+    break;
+  }
   case (format::uvfits): {
     return pfitsio::read_uvfits(found_files, true, pol);
     break;
@@ -87,16 +122,90 @@ utilities::vis_params read_measurements(const std::vector<std::string> &names, c
 }
 
 #ifdef PURIFY_MPI
+namespace {
+//! Appends the visibilities of part to result
+void append(utilities::vis_params &result, const utilities::vis_params &part) {
+  const t_int size = result.size();
+  // time and baseline are optional, and only kept when both have them
+  const bool time = result.time.size() == size and part.time.size() == part.size();
+  const bool baseline = result.baseline.size() == size and part.baseline.size() == part.size();
+  result.u.conservativeResize(size + part.size());
+  result.v.conservativeResize(size + part.size());
+  result.w.conservativeResize(size + part.size());
+  result.vis.conservativeResize(size + part.size());
+  result.weights.conservativeResize(size + part.size());
+  result.u.tail(part.size()) = part.u;
+  result.v.tail(part.size()) = part.v;
+  result.w.tail(part.size()) = part.w;
+  result.vis.tail(part.size()) = part.vis;
+  result.weights.tail(part.size()) = part.weights;
+  if (time) {
+    result.time.conservativeResize(size + part.size());
+    result.time.tail(part.size()) = part.time;
+  } else
+    result.time = Vector<t_real>();
+  if (baseline) {
+    result.baseline.conservativeResize(size + part.size());
+    result.baseline.tail(part.size()) = part.baseline;
+  } else
+    result.baseline = Vector<t_uint>();
+}
+
+//! Reads an equal share of the records of the files on each node
+//! \details records gives the number of records in a file from its header, and read reads
+//! the records [first, first + count) of a file.
+utilities::vis_params read_share(
+    const std::vector<std::string> &names,
+    const std::function<std::int64_t(const std::string &)> &records,
+    const std::function<utilities::vis_params(const std::string &, std::int64_t, std::int64_t)>
+        &read,
+    sopt::mpi::Communicator const &comm) {
+  // the headers are read in parallel too
+  Vector<std::int64_t> counts = Vector<std::int64_t>::Zero(names.size());
+  for (t_int i = comm.rank(); i < names.size(); i += comm.size()) counts(i) = records(names.at(i));
+  counts = comm.all_sum_all<Vector<std::int64_t>>(counts);
+  const std::int64_t total = counts.sum();
+  const std::int64_t first = (total * comm.rank()) / comm.size();
+  const std::int64_t last = (total * (comm.rank() + 1)) / comm.size();
+  utilities::vis_params result;
+  bool empty = true;
+  std::int64_t file_start = 0;
+  for (t_int i = 0; i < names.size(); i++) {
+    const std::int64_t start = std::max(first, file_start);
+    const std::int64_t end = std::min(last, file_start + counts(i));
+    if (end > start) {
+      const auto part = read(names.at(i), start - file_start, end - start);
+      if (empty) {
+        result = part;
+        empty = false;
+      } else {
+        if (std::abs(result.ra - part.ra) > 1e-6 or std::abs(result.dec - part.dec) > 1e-6)
+          throw std::runtime_error(names.at(i) + ": wrong pointing.");
+        append(result, part);
+      }
+    }
+    file_start += counts(i);
+  }
+  // the pointing and frequencies are still needed when there is nothing to read
+  if (empty) result = read(names.at(0), 0, 0);
+  return result;
+}
+}  // namespace
+
 utilities::vis_params read_measurements(const std::string &name,
                                         sopt::mpi::Communicator const &comm,
                                         const distribute::plan plan, const bool w_term,
-                                        const stokes pol, const utilities::vis_units units) {
-  return read_measurements(std::vector<std::string>{name}, comm, plan, w_term, pol, units);
+                                        const stokes pol, const utilities::vis_units units,
+                                        const std::function<Vector<t_real>(
+                                            const utilities::vis_params &)> &cost) {
+  return read_measurements(std::vector<std::string>{name}, comm, plan, w_term, pol, units, cost);
 }
 utilities::vis_params read_measurements(const std::vector<std::string> &names,
                                         sopt::mpi::Communicator const &comm,
                                         const distribute::plan plan, const bool w_term,
-                                        const stokes pol, const utilities::vis_units units) {
+                                        const stokes pol, const utilities::vis_units units,
+                                        const std::function<Vector<t_real>(
+                                            const utilities::vis_params &)> &cost) {
   if (comm.size() == 1) {
     try {
       return read_measurements(names, w_term, pol, units);
@@ -104,18 +213,67 @@ utilities::vis_params read_measurements(const std::vector<std::string> &names,
       comm.abort(e.what());
     }
   }
-  if (comm.is_root()) {
-    utilities::vis_params result;
-    try {
-      result = read_measurements(names, w_term, pol, units);
-    } catch (const std::runtime_error &e) {
-      comm.abort(e.what());
+  utilities::vis_params local;
+  try {
+    std::vector<std::string> found_files;
+    format format_type;
+    std::tie(found_files, format_type) = check_files(names);
+    if (format_type == format::uvfits)
+      local = read_share(
+          found_files,
+          [](const std::string &name) -> std::int64_t { return pfitsio::read_uvfits_groups(name); },
+          [pol](const std::string &name, const std::int64_t first, const std::int64_t groups) {
+            return pfitsio::read_uvfits(name, true, pol, first, groups);
+          },
+          comm);
+    else if (format_type == format::binary) {
+      local = read_share(
+          found_files, utilities::binary_visibility_size,
+          [](const std::string &name, const std::int64_t first, const std::int64_t count) {
+            return utilities::read_binary_visibility(name, first, count);
+          },
+          comm);
+      binary_options(local, w_term, units);
+    } else if (format_type == format::ms) {
+#ifdef PURIFY_CASACORE
+      // rows of the main tables are shared out, so that one measurement set is read in parallel
+      local = read_share(found_files, casa::measurementset_rows,
+                         [pol](const std::string &name, const std::int64_t first,
+                               const std::int64_t rows) {
+                           return casa::read_measurementset(name, pol, first, rows);
+                         },
+                         comm);
+#else
+      throw std::runtime_error(
+          "You want to read a measurement set, but you did not compile with casacore.");
+#endif
+    } else {
+      if (pol != stokes::I)
+        throw std::runtime_error(
+            ".vis files are ascii, so it is assumed that it is Stokes I. But, you are trying to "
+            "choose a different type!");
+      // bytes of the text files are shared out, and each node reads the lines starting in its share
+      local = read_share(
+          found_files,
+          [](const std::string &name) -> std::int64_t {
+            struct stat buf;
+            if (stat(name.c_str(), &buf) != 0)
+              throw std::runtime_error("Could not read size of " + name);
+            return buf.st_size;
+          },
+          [w_term](const std::string &name, const std::int64_t first, const std::int64_t bytes) {
+            return utilities::read_visibility(name, w_term, first, bytes);
+          },
+          comm);
+      local.units = units;
     }
-    auto const order = distribute::distribute_measurements(result, comm, plan);
-    return utilities::regroup_and_scatter(result, order, comm);
+  } catch (const std::runtime_error &e) {
+    comm.abort(e.what());
   }
-  auto result = utilities::scatter_visibilities(comm);
-  return result;
+  PURIFY_MEDIUM_LOG("Node {} read {} visibilities.", comm.rank(), local.size());
+  auto const order = distribute::distribute_measurements_parallel(
+      local, comm, plan, 128, 65536, cost ? cost(local) : Vector<t_real>());
+  return utilities::regroup_and_all_to_all(std::move(local), order, comm);
 }
 #endif
 //! check that file path exists
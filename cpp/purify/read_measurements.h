@@ -3,6 +3,7 @@
 #include "purify/config.h"
 
 #include "purify/types.h"
+#include <functional>
 
 #include "purify/distribute.h"
 #include "purify/uvw_utilities.h"
@@ -12,7 +13,7 @@
 
 namespace purify {
 namespace read_measurements {
-enum class format { vis, uvfits, ms };
+enum class format { vis, uvfits, ms, binary };
 //! read in signle measurement file
 utilities::vis_params read_measurements(
     const std::string &name, const bool w_term = false, const stokes pol = stokes::I,
@@ -23,15 +24,19 @@ utilities::vis_params read_measurements(
     const utilities::vis_units units = utilities::vis_units::lambda);
 #ifdef PURIFY_MPI
 //! read in and distribute measurements
+//! \details cost gives the cost of each visibility read by a node, which the bisection plans
+//! balance instead of the number of visibilities.
 utilities::vis_params read_measurements(
     const std::string &name, sopt::mpi::Communicator const &comm,
     const distribute::plan plan = distribute::plan::radial, const bool w_term = false,
-    const stokes pol = stokes::I, const utilities::vis_units units = utilities::vis_units::lambda);
+    const stokes pol = stokes::I, const utilities::vis_units units = utilities::vis_units::lambda,
+    const std::function<Vector<t_real>(const utilities::vis_params &)> &cost = nullptr);
 //! read in and distribute mutliple measurements
 utilities::vis_params read_measurements(
     const std::vector<std::string> &names, sopt::mpi::Communicator const &comm,
     const distribute::plan plan = distribute::plan::radial, const bool w_term = false,
-    const stokes pol = stokes::I, const utilities::vis_units units = utilities::vis_units::lambda);
+    const stokes pol = stokes::I, const utilities::vis_units units = utilities::vis_units::lambda,
+    const std::function<Vector<t_real>(const utilities::vis_params &)> &cost = nullptr);
 #endif
 //! check that file path exists
 bool file_exists(const std::string &path);
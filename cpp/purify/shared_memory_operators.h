@@ -0,0 +1,229 @@
+#ifndef PURIFY_SHARED_MEMORY_OPERATORS_H
+#define PURIFY_SHARED_MEMORY_OPERATORS_H
+
+#include "purify/config.h"
+#ifdef PURIFY_MPI
+#include "purify/types.h"
+#include <array>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+#include "purify/IndexMapping.h"
+#include "purify/NodeAwareReduction.h"
+#include "purify/SharedArray.h"
+#include "purify/kernels.h"
+#include "purify/logging.h"
+#include "purify/operators.h"
+#include "purify/slab_operators.h"
+#include "purify/utilities.h"
+#include <sopt/linear_transform.h>
+#include <sopt/mpi/communicator.h>
+
+#include <fftw3.h>
+
+namespace purify {
+namespace operators {
+//! \brief Operators where the ranks of a compute node share one FFT grid and one image
+//! \details The oversampled grid and the image are allocated once per compute node in MPI-3
+//! shared memory. The zero padding, correction and FFT are split over the rows and columns of the
+//! grid between the ranks of the node, and each rank only holds the gridding matrix of its own
+//! visibilities. Only the node leaders sum the image over the network.
+
+//! Constructs degridding operator with the FFT grid shared by the ranks of each compute node
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>>
+base_mpi_shared_memory_degrid_operator_2d(
+    const sopt::mpi::Communicator &comm, const Vector<t_real> &u, const Vector<t_real> &v,
+    const Vector<t_real> &w, const Vector<t_complex> &weights, const t_uint &imsizey,
+    const t_uint &imsizex, const t_real oversample_ratio = 2,
+    const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
+    const fftw_plan ft_plan = fftw_plan::measure, const bool w_stacking = false,
+    const t_real &cellx = 1, const t_real &celly = 1) {
+  if (w_stacking == true)
+    throw std::runtime_error(
+        "w-term correction not supported for this measurement operator or MPI method.");
+  std::function<t_real(t_real)> kernelu, kernelv, ftkernelu, ftkernelv;
+  std::tie(kernelu, kernelv, ftkernelu, ftkernelv) =
+      purify::create_kernels(kernel, Ju, Jv, imsizey, imsizex, oversample_ratio);
+  const t_int ftsizeu = std::floor(imsizex * oversample_ratio);
+  const t_int ftsizev = std::floor(imsizey * oversample_ratio);
+  const t_int x_start = std::floor(ftsizeu * 0.5 - imsizex * 0.5);
+  const t_int y_start = std::floor(ftsizev * 0.5 - imsizey * 0.5);
+  // the normalisation of the unitary FFT is applied with the correction
+  const Image<t_complex> S =
+      purify::details::init_correction2d(oversample_ratio, imsizey, imsizex, ftkernelu, ftkernelv,
+                                         0., cellx, celly) *
+      std::sqrt(imsizex * imsizey) * oversample_ratio /
+      std::sqrt(static_cast<t_real>(ftsizev) * static_cast<t_real>(ftsizeu));
+  PURIFY_LOW_LOG("Building Measurement Operator with the FFT grid in node shared memory: WGFZDB");
+  PURIFY_MEDIUM_LOG("Image size (width, height): {} x {}", imsizex, imsizey);
+  PURIFY_MEDIUM_LOG("Oversampling Factor: {}", oversample_ratio);
+
+  const auto reduction = std::make_shared<const NodeAwareReduction>(comm);
+  const auto grid = std::make_shared<const SharedArray<t_complex>>(
+      reduction->node(), static_cast<std::int64_t>(ftsizev) * ftsizeu);
+  const auto image = std::make_shared<const SharedArray<t_complex>>(
+      reduction->node(), static_cast<std::int64_t>(imsizey) * imsizex);
+  PURIFY_MEDIUM_LOG("FFT grid shared by {} ranks on each of {} compute nodes.", grid->ranks(),
+                    reduction->nodes());
+  // rows of the image and columns of the grid transformed by this rank
+  const auto image_rows = slab_starts(imsizey, grid->ranks());
+  const auto blank_rows = slab_starts(ftsizev - imsizey, grid->ranks());
+  const auto grid_columns = slab_starts(ftsizeu, grid->ranks());
+  const t_int j_start = image_rows[grid->rank()];
+  const t_int j_end = image_rows[grid->rank() + 1];
+  const t_int k_start = blank_rows[grid->rank()];
+  const t_int k_end = blank_rows[grid->rank() + 1];
+  const t_int q_start = grid_columns[grid->rank()];
+  const t_int q_end = grid_columns[grid->rank() + 1];
+
+  t_int plan_flag = FFTW_MEASURE;
+  switch (ft_plan) {
+  case (fftw_plan::measure):
+    plan_flag = FFTW_MEASURE;
+    break;
+  case (fftw_plan::estimate):
+    plan_flag = FFTW_ESTIMATE;
+    break;
+  }
+  const auto del = [](fftw_plan_s *plan) { fftw_destroy_plan(plan); };
+  // in place plans on the part of the shared grid of this rank, so that measuring does not touch
+  // the part of any other rank
+  fftw_complex *const rows_data =
+      reinterpret_cast<fftw_complex *>(grid->data() + (y_start + j_start) * ftsizeu);
+  fftw_complex *const columns_data = reinterpret_cast<fftw_complex *>(grid->data() + q_start);
+  const auto plan_rows = [&](const t_int sign) {
+    return std::shared_ptr<fftw_plan_s>(
+        (j_end > j_start) ? fftw_plan_many_dft(1, &ftsizeu, j_end - j_start, rows_data, nullptr,
+                                               1, ftsizeu, rows_data, nullptr, 1, ftsizeu, sign,
+                                               plan_flag)
+                          : nullptr,
+        del);
+  };
+  const auto plan_columns = [&](const t_int sign) {
+    return std::shared_ptr<fftw_plan_s>(
+        (q_end > q_start) ? fftw_plan_many_dft(1, &ftsizev, q_end - q_start, columns_data,
+                                               nullptr, ftsizeu, 1, columns_data, nullptr,
+                                               ftsizeu, 1, sign, plan_flag)
+                          : nullptr,
+        del);
+  };
+  const std::shared_ptr<fftw_plan_s> rows_forward = plan_rows(FFTW_FORWARD);
+  const std::shared_ptr<fftw_plan_s> rows_inverse = plan_rows(FFTW_BACKWARD);
+  grid->sync();
+  const std::shared_ptr<fftw_plan_s> columns_forward = plan_columns(FFTW_FORWARD);
+  const std::shared_ptr<fftw_plan_s> columns_inverse = plan_columns(FFTW_BACKWARD);
+  grid->sync();
+
+  PURIFY_MEDIUM_LOG("FoV (width, height): {} deg x {} deg", imsizex * cellx / (60. * 60.),
+                    imsizey * celly / (60. * 60.));
+  PURIFY_LOW_LOG("Constructing Weighting and Gridding Operators: WG");
+  PURIFY_MEDIUM_LOG("Number of visibilities: {}", u.size());
+  const Sparse<t_complex> interpolation_matrix = details::init_gridding_matrix_2d(
+      u, v, weights, imsizey, imsizex, oversample_ratio, kernelv, kernelu, Ju, Jv);
+  // grid points touched by the visibilities of this rank, in increasing order
+  const auto indices = non_empty_outers<Sparse<t_complex>, t_int>(interpolation_matrix);
+  const std::shared_ptr<const std::vector<t_int>> touched =
+      std::make_shared<const std::vector<t_int>>(indices.begin(), indices.end());
+  const std::shared_ptr<const Sparse<t_complex>> G =
+      std::make_shared<const Sparse<t_complex>>(compress_outer(interpolation_matrix));
+  const std::shared_ptr<const Sparse<t_complex>> G_adjoint =
+      std::make_shared<const Sparse<t_complex>>(G->adjoint());
+
+  auto direct = [=](T &output, const T &x) {
+    assert(x.size() == imsizex * imsizey);
+    t_complex *const data = grid->data();
+    for (t_int k = k_start; k < k_end; k++) {
+      const t_int row = (k < y_start) ? k : k + imsizey;
+      Vector<t_complex>::Map(data + row * ftsizeu, ftsizeu).setZero();
+    }
+    for (t_int j = j_start; j < j_end; j++) {
+      auto row = Vector<t_complex>::Map(data + (y_start + j) * ftsizeu, ftsizeu);
+      row.setZero();
+      for (t_int i = 0; i < imsizex; i++)
+        row(x_start + i) = S(j, i) * x(utilities::sub2ind(j, i, imsizey, imsizex));
+    }
+    if (rows_forward) fftw_execute_dft(rows_forward.get(), rows_data, rows_data);
+    grid->sync();
+    if (columns_forward) fftw_execute_dft(columns_forward.get(), columns_data, columns_data);
+    grid->sync();
+    Vector<t_complex> local(touched->size());
+    for (t_int i = 0; i < local.size(); i++) local(i) = data[(*touched)[i]];
+    // the grid is overwritten by the next application
+    grid->sync();
+    output = utilities::sparse_multiply_matrix(*G, local);
+  };
+  auto indirect = [=](T &output, const T &y) {
+    t_complex *const data = grid->data();
+    const Vector<t_complex> local = utilities::sparse_multiply_matrix(*G_adjoint, y);
+    grid->zero();
+    grid->add(*touched, local);
+    if (columns_inverse) fftw_execute_dft(columns_inverse.get(), columns_data, columns_data);
+    grid->sync();
+    // only the rows of the image are needed after the column transforms
+    if (rows_inverse) fftw_execute_dft(rows_inverse.get(), rows_data, rows_data);
+    for (t_int j = j_start; j < j_end; j++)
+      for (t_int i = 0; i < imsizex; i++)
+        image->data()[utilities::sub2ind(j, i, imsizey, imsizex)] =
+            std::conj(S(j, i)) * data[(y_start + j) * ftsizeu + x_start + i];
+    image->sync();
+    reduction->all_sum_nodes(*image);
+    output = image->vector();
+  };
+  PURIFY_LOW_LOG("Finished consturction of Φ.");
+  return std::make_tuple(direct, indirect);
+}
+}  // namespace operators
+
+namespace measurementoperator {
+//! Returns linear transform that is the weighted degridding operator with the FFT grid and image
+//! shared by the ranks of each compute node
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_shared_memory(
+    const sopt::mpi::Communicator &comm, const Vector<t_real> &u, const Vector<t_real> &v,
+    const Vector<t_real> &w, const Vector<t_complex> &weights, const t_uint &imsizey,
+    const t_uint &imsizex, const t_real &oversample_ratio = 2,
+    const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
+    const bool w_stacking = false, const t_real &cellx = 1, const t_real &celly = 1) {
+  const operators::fftw_plan ft_plan = operators::fftw_plan::measure;
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  std::array<t_int, 3> M = {0, 1, static_cast<t_int>(u.size())};
+  sopt::OperatorFunction<T> directDegrid, indirectDegrid;
+  std::tie(directDegrid, indirectDegrid) =
+      purify::operators::base_mpi_shared_memory_degrid_operator_2d<T>(
+          comm, u, v, w, weights, imsizey, imsizex, oversample_ratio, kernel, Ju, Jv, ft_plan,
+          w_stacking, cellx, celly);
+  return std::make_shared<sopt::LinearTransform<T>>(directDegrid, M, indirectDegrid, N);
+}
+
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_shared_memory(
+    const sopt::mpi::Communicator &comm, const utilities::vis_params &uv_vis_input,
+    const t_uint &imsizey, const t_uint &imsizex, const t_real &cell_x, const t_real &cell_y,
+    const t_real &oversample_ratio = 2, const kernels::kernel kernel = kernels::kernel::kb,
+    const t_uint Ju = 4, const t_uint Jv = 4, const bool w_stacking = false) {
+  const auto uv_vis = utilities::convert_to_pixels(uv_vis_input, cell_x, cell_y, imsizex, imsizey,
+                                                   oversample_ratio);
+  return init_degrid_operator_2d_shared_memory<T>(comm, uv_vis.u, uv_vis.v, uv_vis.w,
+                                                  uv_vis.weights, imsizey, imsizex,
+                                                  oversample_ratio, kernel, Ju, Jv, w_stacking,
+                                                  cell_x, cell_y);
+}
+
+//! w-projection is not available with the FFT grid in node shared memory
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_shared_memory(
+    const sopt::mpi::Communicator &comm, const utilities::vis_params &uv_vis_input,
+    const t_uint imsizey, const t_uint imsizex, const t_real cell_x, const t_real cell_y,
+    const t_real oversample_ratio, const kernels::kernel kernel, const t_uint Ju, const t_uint Jw,
+    const bool w_stacking, const t_real absolute_error, const t_real relative_error,
+    const dde_type dde) {
+  throw std::runtime_error(
+      "w-projection is not supported by the measurement operator with the FFT grid in node shared "
+      "memory.");
+}
+}  // namespace measurementoperator
+}  // namespace purify
+#endif
+#endif
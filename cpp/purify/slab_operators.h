@@ -0,0 +1,510 @@
+#ifndef PURIFY_SLAB_OPERATORS_H
+#define PURIFY_SLAB_OPERATORS_H
+
+#include "purify/config.h"
+#ifdef PURIFY_MPI
+#include "purify/types.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include "purify/AllToAllSparseVector.h"
+#include "purify/kernels.h"
+#include "purify/logging.h"
+#include "purify/operators.h"
+#include "purify/utilities.h"
+#include <sopt/chained_operators.h>
+#include <sopt/linear_transform.h>
+#include <sopt/mpi/communicator.h>
+#include <sopt/mpi/types.h>
+
+#include <fftw3.h>
+
+namespace purify {
+namespace operators {
+//! \brief Operators where the FFT grid is distributed over the nodes in slabs
+//! \details The padded image is distributed in slabs of rows of the FFT grid, and the Fourier grid
+//! in slabs of columns. Each column slab is stored transposed, so that a column of the grid is
+//! contiguous. No node holds the whole FFT grid, and the exchanges are all to all, so there is no
+//! root bottleneck. The image itself can also be distributed in slabs of rows, so that the size of
+//! the image grows with the number of nodes.
+
+//! Start of the slab of each node and the total size as the last element
+inline std::vector<t_int> slab_starts(const t_int size, const t_int nodes) {
+  std::vector<t_int> starts(nodes + 1, 0);
+  for (t_int i = 0; i < nodes + 1; i++)
+    starts[i] = static_cast<t_int>((static_cast<std::int64_t>(size) * i) / nodes);
+  return starts;
+}
+
+//! Size of the column slab of the Fourier grid held by each node (the largest slab)
+inline t_int slab_grid_size(const t_int ftsizev, const t_int ftsizeu, const t_int nodes) {
+  const auto starts = slab_starts(ftsizeu, nodes);
+  t_int width = 0;
+  for (t_int i = 0; i < nodes; i++) width = std::max(width, starts[i + 1] - starts[i]);
+  return width * ftsizev;
+}
+
+//! Moves the columns of a gridding matrix from the FFT grid to the slab distributed Fourier grid
+template <class STORAGE_INDEX_TYPE>
+Sparse<t_complex, STORAGE_INDEX_TYPE> slab_gridding_matrix(
+    const Sparse<t_complex, STORAGE_INDEX_TYPE> &interpolation_matrix, const t_int ftsizev,
+    const t_int ftsizeu, const t_int nodes) {
+  const auto column_starts = slab_starts(ftsizeu, nodes);
+  const STORAGE_INDEX_TYPE local_size = slab_grid_size(ftsizev, ftsizeu, nodes);
+  std::vector<Eigen::Triplet<t_complex, STORAGE_INDEX_TYPE>> triplets;
+  triplets.reserve(interpolation_matrix.nonZeros());
+  for (STORAGE_INDEX_TYPE k = 0; k < interpolation_matrix.outerSize(); ++k)
+    for (typename Sparse<t_complex, STORAGE_INDEX_TYPE>::InnerIterator it(interpolation_matrix, k);
+         it; ++it) {
+      const t_int p = it.col() / ftsizeu;
+      const t_int q = it.col() % ftsizeu;
+      const t_int node =
+          std::upper_bound(column_starts.begin(), column_starts.end(), q) - column_starts.begin() -
+          1;
+      triplets.emplace_back(k,
+                            static_cast<STORAGE_INDEX_TYPE>(node) * local_size +
+                                static_cast<STORAGE_INDEX_TYPE>(q - column_starts[node]) * ftsizev +
+                                p,
+                            it.value());
+    }
+  Sparse<t_complex, STORAGE_INDEX_TYPE> result(interpolation_matrix.rows(), nodes * local_size);
+  result.setFromTriplets(triplets.begin(), triplets.end());
+  return result;
+}
+
+//! Constructs zero padding and correction operator from the whole image to a slab of rows of the
+//! FFT grid
+//! \details The adjoint gathers the rows of the image from each node, so that every node holds
+//! the whole image.
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_slab_zero_padding_2d(
+    const sopt::mpi::Communicator &comm, const Image<typename T::Scalar> &S,
+    const t_real &oversample_ratio) {
+  const t_int imsizex = S.cols();
+  const t_int imsizey = S.rows();
+  const t_int ftsizeu = std::floor(imsizex * oversample_ratio);
+  const t_int ftsizev = std::floor(imsizey * oversample_ratio);
+  const t_int x_start = std::floor(ftsizeu * 0.5 - imsizex * 0.5);
+  const t_int y_start = std::floor(ftsizev * 0.5 - imsizey * 0.5);
+  const auto row_starts = slab_starts(ftsizev, comm.size());
+  const t_int v_start = row_starts[comm.rank()];
+  const t_int v_end = row_starts[comm.rank() + 1];
+  // rows of the image that fall in the slab of each node
+  std::vector<int> counts(comm.size(), 0);
+  std::vector<int> displs(comm.size(), 0);
+  for (t_int i = 0; i < comm.size(); i++) {
+    const t_int first = std::min(std::max(row_starts[i] - y_start, 0), imsizey);
+    const t_int last = std::min(std::max(row_starts[i + 1] - y_start, 0), imsizey);
+    counts[i] = (last - first) * imsizex;
+    displs[i] = first * imsizex;
+  }
+  const t_int j_start = displs[comm.rank()] / imsizex;
+  const t_int j_end = j_start + counts[comm.rank()] / imsizex;
+  auto direct = [=](T &output, const T &x) {
+    assert(x.size() == imsizex * imsizey);
+    output = T::Zero((v_end - v_start) * ftsizeu);
+#pragma omp parallel for collapse(2)
+    for (t_int j = j_start; j < j_end; j++) {
+      for (t_int i = 0; i < imsizex; i++) {
+        const t_int input_index = utilities::sub2ind(j, i, imsizey, imsizex);
+        const t_int output_index =
+            utilities::sub2ind(y_start + j - v_start, x_start + i, v_end - v_start, ftsizeu);
+        output(output_index) = S(j, i) * x(input_index);
+      }
+    }
+  };
+  auto indirect = [=](T &output, const T &x) {
+    assert(x.size() == (v_end - v_start) * ftsizeu);
+    T local = T::Zero(counts[comm.rank()]);
+#pragma omp parallel for collapse(2)
+    for (t_int j = j_start; j < j_end; j++) {
+      for (t_int i = 0; i < imsizex; i++) {
+        const t_int output_index = utilities::sub2ind(j - j_start, i, j_end - j_start, imsizex);
+        const t_int input_index =
+            utilities::sub2ind(y_start + j - v_start, x_start + i, v_end - v_start, ftsizeu);
+        local(output_index) = std::conj(S(j, i)) * x(input_index);
+      }
+    }
+    output = T::Zero(imsizey * imsizex);
+    MPI_Allgatherv(local.data(), local.size(), sopt::mpi::Type<typename T::Scalar>::value,
+                   output.data(), counts.data(), displs.data(),
+                   sopt::mpi::Type<typename T::Scalar>::value, *comm);
+  };
+  return std::make_tuple(direct, indirect);
+}
+
+//! Constructs zero padding and correction operator from a slab of rows of the image to the same
+//! rows of the FFT grid
+//! \details Node i holds the rows [starts[i], starts[i + 1]) of the image, with
+//! starts = slab_starts(imsizey, comm.size()), and the image is never gathered. S holds only
+//! the rows of the gridding correction that belong to this node.
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_image_slab_zero_padding_2d(
+    const sopt::mpi::Communicator &comm, const Image<typename T::Scalar> &S, const t_uint imsizey,
+    const t_real &oversample_ratio) {
+  const t_int imsizex = S.cols();
+  const t_int ftsizeu = std::floor(imsizex * oversample_ratio);
+  const t_int x_start = std::floor(ftsizeu * 0.5 - imsizex * 0.5);
+  const auto image_rows = slab_starts(imsizey, comm.size());
+  const t_int rows = image_rows[comm.rank() + 1] - image_rows[comm.rank()];
+  if (S.rows() != rows)
+    throw std::runtime_error("Gridding correction does not match the slab of rows of this node.");
+  auto direct = [=](T &output, const T &x) {
+    assert(x.size() == rows * imsizex);
+    output = T::Zero(rows * ftsizeu);
+#pragma omp parallel for collapse(2)
+    for (t_int j = 0; j < rows; j++) {
+      for (t_int i = 0; i < imsizex; i++) {
+        const t_int input_index = utilities::sub2ind(j, i, rows, imsizex);
+        const t_int output_index = utilities::sub2ind(j, x_start + i, rows, ftsizeu);
+        output(output_index) = S(j, i) * x(input_index);
+      }
+    }
+  };
+  auto indirect = [=](T &output, const T &x) {
+    assert(x.size() == rows * ftsizeu);
+    output = T::Zero(rows * imsizex);
+#pragma omp parallel for collapse(2)
+    for (t_int j = 0; j < rows; j++) {
+      for (t_int i = 0; i < imsizex; i++) {
+        const t_int output_index = utilities::sub2ind(j, i, rows, imsizex);
+        const t_int input_index = utilities::sub2ind(j, x_start + i, rows, ftsizeu);
+        output(output_index) = std::conj(S(j, i)) * x(input_index);
+      }
+    }
+  };
+  return std::make_tuple(direct, indirect);
+}
+
+//! Slab of rows of the image held by this node when the image is distributed in slabs
+template <class T>
+T image_slab(const sopt::mpi::Communicator &comm, const T &image, const t_uint imsizey,
+             const t_uint imsizex) {
+  assert(image.size() == imsizey * imsizex);
+  const auto image_rows = slab_starts(imsizey, comm.size());
+  return image.segment(image_rows[comm.rank()] * imsizex,
+                       (image_rows[comm.rank() + 1] - image_rows[comm.rank()]) * imsizex);
+}
+
+//! Gathers the slabs of rows of an image, so that every node holds the whole image
+template <class T>
+T gather_image_slabs(const sopt::mpi::Communicator &comm, const T &slab, const t_uint imsizey,
+                     const t_uint imsizex) {
+  const auto image_rows = slab_starts(imsizey, comm.size());
+  std::vector<int> counts(comm.size());
+  std::vector<int> displs(comm.size());
+  for (t_int i = 0; i < comm.size(); i++) {
+    counts[i] = (image_rows[i + 1] - image_rows[i]) * imsizex;
+    displs[i] = image_rows[i] * imsizex;
+  }
+  if (slab.size() != counts[comm.rank()])
+    throw std::runtime_error("Slab does not match the rows of the image held by this node.");
+  T output = T::Zero(imsizey * imsizex);
+  MPI_Allgatherv(slab.data(), slab.size(), sopt::mpi::Type<typename T::Scalar>::value,
+                 output.data(), counts.data(), displs.data(),
+                 sopt::mpi::Type<typename T::Scalar>::value, *comm);
+  return output;
+}
+
+//! Constructs the 2D FFT operator from slabs of rows of the FFT grid to slabs of columns
+//! \details The transform is split into 1D FFTs along the rows, an all to all transpose, and 1D
+//! FFTs along the columns. Node i holds the rows [row_starts[i], row_starts[i + 1]) of the FFT
+//! grid. Rows outside of [row_starts.front(), row_starts.back()) are zero, and are neither stored
+//! nor exchanged. The column slab is stored transposed and padded to
+//! slab_grid_size(ftsizev, ftsizeu, comm.size()).
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_slab_FFT_2d(
+    const sopt::mpi::Communicator &comm, const std::vector<t_int> &row_starts,
+    const t_int ftsizev, const t_int ftsizeu,
+    const fftw_plan fftw_plan_flag = fftw_plan::measure) {
+  if (static_cast<t_int>(row_starts.size()) != comm.size() + 1 or row_starts.front() < 0 or
+      row_starts.back() > ftsizev)
+    throw std::runtime_error("Rows of the FFT grid do not match the number of nodes.");
+  const auto column_starts = slab_starts(ftsizeu, comm.size());
+  const t_int rows = row_starts[comm.rank() + 1] - row_starts[comm.rank()];
+  const t_int columns = column_starts[comm.rank() + 1] - column_starts[comm.rank()];
+  const t_int local_size = slab_grid_size(ftsizev, ftsizeu, comm.size());
+  t_int plan_flag = (FFTW_MEASURE | FFTW_PRESERVE_INPUT);
+  switch (fftw_plan_flag) {
+  case (fftw_plan::measure):
+    plan_flag = (FFTW_MEASURE | FFTW_PRESERVE_INPUT);
+    break;
+  case (fftw_plan::estimate):
+    plan_flag = (FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    break;
+  }
+  // sizes of the blocks exchanged in the transpose
+  std::vector<t_int> row_block_sizes(comm.size());
+  std::vector<t_int> column_block_sizes(comm.size());
+  for (t_int i = 0; i < comm.size(); i++) {
+    row_block_sizes[i] = rows * (column_starts[i + 1] - column_starts[i]);
+    column_block_sizes[i] = columns * (row_starts[i + 1] - row_starts[i]);
+  }
+
+  const auto del = [](fftw_plan_s *plan) { fftw_destroy_plan(plan); };
+  // a node with an empty slab still needs a valid plan, it is never executed
+  const auto plan_many = [&](const t_int n, const t_int slab, const t_int sign) {
+    const t_int howmany = std::max(slab, 1);
+    Vector<t_complex> src = Vector<t_complex>::Zero(n * howmany);
+    Vector<t_complex> dst = Vector<t_complex>::Zero(n * howmany);
+#ifdef PURIFY_OPENMP_FFTW
+    fftw_plan_with_nthreads(omp_get_max_threads());
+#endif
+    return std::shared_ptr<fftw_plan_s>(
+        fftw_plan_many_dft(1, &n, howmany, reinterpret_cast<fftw_complex *>(src.data()), nullptr,
+                           1, n, reinterpret_cast<fftw_complex *>(dst.data()), nullptr, 1, n, sign,
+                           plan_flag),
+        del);
+  };
+#ifdef PURIFY_OPENMP_FFTW
+  PURIFY_LOW_LOG("Using OpenMP threading with FFTW.");
+  fftw_init_threads();
+#endif
+  const std::shared_ptr<fftw_plan_s> rows_forward = plan_many(ftsizeu, rows, FFTW_FORWARD);
+  const std::shared_ptr<fftw_plan_s> rows_inverse = plan_many(ftsizeu, rows, FFTW_BACKWARD);
+  const std::shared_ptr<fftw_plan_s> columns_forward = plan_many(ftsizev, columns, FFTW_FORWARD);
+  const std::shared_ptr<fftw_plan_s> columns_inverse = plan_many(ftsizev, columns, FFTW_BACKWARD);
+  const t_real norm = std::sqrt(static_cast<t_real>(ftsizev) * static_cast<t_real>(ftsizeu));
+
+  auto direct = [=](T &output, const T &input) {
+    assert(input.size() == rows * ftsizeu);
+    T row_transform = T::Zero(rows * ftsizeu);
+    if (rows > 0)
+      fftw_execute_dft(
+          rows_forward.get(),
+          const_cast<fftw_complex *>(reinterpret_cast<const fftw_complex *>(input.data())),
+          reinterpret_cast<fftw_complex *>(row_transform.data()));
+    // pack the columns of each node, in the order they are stored on that node
+    T send(rows * ftsizeu);
+    t_int index = 0;
+    for (t_int node = 0; node < comm.size(); node++)
+      for (t_int q = column_starts[node]; q < column_starts[node + 1]; q++)
+        for (t_int p = 0; p < rows; p++) send(index++) = row_transform(p * ftsizeu + q);
+    const T received =
+        comm.all_to_allv<typename T::Scalar>(send, row_block_sizes, column_block_sizes);
+    T transposed = T::Zero(columns * ftsizev);
+    index = 0;
+    for (t_int node = 0; node < comm.size(); node++)
+      for (t_int q = 0; q < columns; q++)
+        for (t_int p = row_starts[node]; p < row_starts[node + 1]; p++)
+          transposed(q * ftsizev + p) = received(index++);
+    output = T::Zero(local_size);
+    if (columns > 0)
+      fftw_execute_dft(columns_forward.get(),
+                       reinterpret_cast<fftw_complex *>(transposed.data()),
+                       reinterpret_cast<fftw_complex *>(output.data()));
+    output /= norm;
+  };
+  auto indirect = [=](T &output, const T &input) {
+    assert(input.size() == local_size);
+    T column_transform = T::Zero(columns * ftsizev);
+    if (columns > 0)
+      fftw_execute_dft(
+          columns_inverse.get(),
+          const_cast<fftw_complex *>(reinterpret_cast<const fftw_complex *>(input.data())),
+          reinterpret_cast<fftw_complex *>(column_transform.data()));
+    T send(columns * ftsizev);
+    t_int index = 0;
+    for (t_int node = 0; node < comm.size(); node++)
+      for (t_int q = 0; q < columns; q++)
+        for (t_int p = row_starts[node]; p < row_starts[node + 1]; p++)
+          send(index++) = column_transform(q * ftsizev + p);
+    const T received =
+        comm.all_to_allv<typename T::Scalar>(send, column_block_sizes, row_block_sizes);
+    T transposed = T::Zero(rows * ftsizeu);
+    index = 0;
+    for (t_int node = 0; node < comm.size(); node++)
+      for (t_int q = column_starts[node]; q < column_starts[node + 1]; q++)
+        for (t_int p = 0; p < rows; p++) transposed(p * ftsizeu + q) = received(index++);
+    output = T::Zero(rows * ftsizeu);
+    if (rows > 0)
+      fftw_execute_dft(rows_inverse.get(), reinterpret_cast<fftw_complex *>(transposed.data()),
+                       reinterpret_cast<fftw_complex *>(output.data()));
+    output /= norm;
+  };
+  return std::make_tuple(direct, indirect);
+}
+
+//! Constructs the 2D FFT operator from a slab of rows of the FFT grid to a slab of columns
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> init_slab_FFT_2d(
+    const sopt::mpi::Communicator &comm, const t_uint &imsizey, const t_uint &imsizex,
+    const t_real &oversample_factor, const fftw_plan fftw_plan_flag = fftw_plan::measure) {
+  const t_int ftsizeu = std::floor(imsizex * oversample_factor);
+  const t_int ftsizev = std::floor(imsizey * oversample_factor);
+  return init_slab_FFT_2d<T>(comm, slab_starts(ftsizev, comm.size()), ftsizev, ftsizeu,
+                             fftw_plan_flag);
+}
+
+//! Constructs degridding operator where the FFT grid is distributed in slabs over the nodes
+template <class T>
+std::tuple<sopt::OperatorFunction<T>, sopt::OperatorFunction<T>> base_mpi_slab_degrid_operator_2d(
+    const sopt::mpi::Communicator &comm, const Vector<t_real> &u, const Vector<t_real> &v,
+    const Vector<t_real> &w, const Vector<t_complex> &weights, const t_uint &imsizey,
+    const t_uint &imsizex, const t_real oversample_ratio = 2,
+    const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
+    const fftw_plan ft_plan = fftw_plan::measure, const bool w_stacking = false,
+    const t_real &cellx = 1, const t_real &celly = 1, const bool distributed_image = false) {
+  if (w_stacking == true)
+    throw std::runtime_error(
+        "w-term correction not supported for this measurement operator or MPI method.");
+  std::function<t_real(t_real)> kernelu, kernelv, ftkernelu, ftkernelv;
+  std::tie(kernelu, kernelv, ftkernelu, ftkernelv) =
+      purify::create_kernels(kernel, Ju, Jv, imsizey, imsizex, oversample_ratio);
+  const t_int ftsizeu = std::floor(imsizex * oversample_ratio);
+  const t_int ftsizev = std::floor(imsizey * oversample_ratio);
+  const t_int y_start = std::floor(ftsizev * 0.5 - imsizey * 0.5);
+  PURIFY_LOW_LOG("Building Measurement Operator with FFT grid distributed in slabs: WGFZDB");
+  PURIFY_MEDIUM_LOG("Image size (width, height): {} x {}", imsizex, imsizey);
+  PURIFY_MEDIUM_LOG("Oversampling Factor: {}", oversample_ratio);
+  sopt::OperatorFunction<T> directZ, indirectZ;
+  sopt::OperatorFunction<T> directFFT, indirectFFT;
+  if (distributed_image) {
+    PURIFY_MEDIUM_LOG("Image distributed in slabs of rows.");
+    // only the rows of the grid that hold the image are transformed and exchanged
+    auto row_starts = slab_starts(imsizey, comm.size());
+    // each node only builds the rows of the correction that multiply its own slab of the image
+    const Image<t_complex> S =
+        purify::details::init_correction2d(oversample_ratio, imsizey, imsizex, ftkernelu,
+                                           ftkernelv, 0., cellx, celly, row_starts[comm.rank()],
+                                           row_starts[comm.rank() + 1] - row_starts[comm.rank()]) *
+        std::sqrt(imsizex * imsizey) * oversample_ratio;
+    for (auto &row : row_starts) row += y_start;
+    std::tie(directZ, indirectZ) =
+        init_image_slab_zero_padding_2d<T>(comm, S, imsizey, oversample_ratio);
+    std::tie(directFFT, indirectFFT) =
+        init_slab_FFT_2d<T>(comm, row_starts, ftsizev, ftsizeu, ft_plan);
+  } else {
+    const Image<t_complex> S =
+        purify::details::init_correction2d(oversample_ratio, imsizey, imsizex, ftkernelu,
+                                           ftkernelv, 0., cellx, celly) *
+        std::sqrt(imsizex * imsizey) * oversample_ratio;
+    std::tie(directZ, indirectZ) = init_slab_zero_padding_2d<T>(comm, S, oversample_ratio);
+    std::tie(directFFT, indirectFFT) =
+        init_slab_FFT_2d<T>(comm, imsizey, imsizex, oversample_ratio, ft_plan);
+  }
+  PURIFY_MEDIUM_LOG("FoV (width, height): {} deg x {} deg", imsizex * cellx / (60. * 60.),
+                    imsizey * celly / (60. * 60.));
+  PURIFY_LOW_LOG("Constructing Weighting and MPI Gridding Operators: WG");
+  PURIFY_MEDIUM_LOG("Number of visibilities: {}", u.size());
+  const std::int64_t local_grid_size = slab_grid_size(ftsizev, ftsizeu, comm.size());
+  sopt::OperatorFunction<T> directG, indirectG;
+  std::tie(directG, indirectG) = init_gridding_matrix_2d_all_to_all<T, std::int64_t>(
+      comm, local_grid_size, static_cast<std::int64_t>(comm.rank()) * local_grid_size,
+      slab_gridding_matrix<std::int64_t>(
+          details::init_gridding_matrix_2d<std::int64_t>(1, std::vector<t_int>(u.size(), 0), u, v,
+                                                         weights, imsizey, imsizex,
+                                                         oversample_ratio, kernelv, kernelu, Ju,
+                                                         Jv),
+          ftsizev, ftsizeu, comm.size()));
+  auto direct = sopt::chained_operators<T>(directG, sopt::chained_operators<T>(directFFT, directZ));
+  auto indirect =
+      sopt::chained_operators<T>(sopt::chained_operators<T>(indirectZ, indirectFFT), indirectG);
+  PURIFY_LOW_LOG("Finished consturction of Φ.");
+  return std::make_tuple(direct, indirect);
+}
+}  // namespace operators
+
+namespace measurementoperator {
+//! Returns linear transform that is the weighted degridding operator with the FFT grid
+//! distributed in slabs over the nodes
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_slabs(
+    const sopt::mpi::Communicator &comm, const Vector<t_real> &u, const Vector<t_real> &v,
+    const Vector<t_real> &w, const Vector<t_complex> &weights, const t_uint &imsizey,
+    const t_uint &imsizex, const t_real &oversample_ratio = 2,
+    const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
+    const bool w_stacking = false, const t_real &cellx = 1, const t_real &celly = 1) {
+  const operators::fftw_plan ft_plan = operators::fftw_plan::measure;
+  std::array<t_int, 3> N = {0, 1, static_cast<t_int>(imsizey * imsizex)};
+  std::array<t_int, 3> M = {0, 1, static_cast<t_int>(u.size())};
+  sopt::OperatorFunction<T> directDegrid, indirectDegrid;
+  std::tie(directDegrid, indirectDegrid) = purify::operators::base_mpi_slab_degrid_operator_2d<T>(
+      comm, u, v, w, weights, imsizey, imsizex, oversample_ratio, kernel, Ju, Jv, ft_plan,
+      w_stacking, cellx, celly);
+  return std::make_shared<sopt::LinearTransform<T>>(directDegrid, M, indirectDegrid, N);
+}
+
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_slabs(
+    const sopt::mpi::Communicator &comm, const utilities::vis_params &uv_vis_input,
+    const t_uint &imsizey, const t_uint &imsizex, const t_real &cell_x, const t_real &cell_y,
+    const t_real &oversample_ratio = 2, const kernels::kernel kernel = kernels::kernel::kb,
+    const t_uint Ju = 4, const t_uint Jv = 4, const bool w_stacking = false) {
+  const auto uv_vis = utilities::convert_to_pixels(uv_vis_input, cell_x, cell_y, imsizex, imsizey,
+                                                   oversample_ratio);
+  return init_degrid_operator_2d_slabs<T>(comm, uv_vis.u, uv_vis.v, uv_vis.w, uv_vis.weights,
+                                          imsizey, imsizex, oversample_ratio, kernel, Ju, Jv,
+                                          w_stacking, cell_x, cell_y);
+}
+
+//! Returns linear transform that is the weighted degridding operator with both the image and
+//! the FFT grid distributed in slabs over the nodes
+//! \details The input and output of the operator are the rows image_slab(comm, image, imsizey,
+//! imsizex) of the image, so that no node holds the whole image or FFT grid. It only saves memory
+//! with solvers that keep their images and wavelet coefficients in the same slabs.
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_image_slabs(
+    const sopt::mpi::Communicator &comm, const Vector<t_real> &u, const Vector<t_real> &v,
+    const Vector<t_real> &w, const Vector<t_complex> &weights, const t_uint &imsizey,
+    const t_uint &imsizex, const t_real &oversample_ratio = 2,
+    const kernels::kernel kernel = kernels::kernel::kb, const t_uint Ju = 4, const t_uint Jv = 4,
+    const bool w_stacking = false, const t_real &cellx = 1, const t_real &celly = 1) {
+  const operators::fftw_plan ft_plan = operators::fftw_plan::measure;
+  const auto image_rows = operators::slab_starts(imsizey, comm.size());
+  std::array<t_int, 3> N = {
+      0, 1,
+      static_cast<t_int>((image_rows[comm.rank() + 1] - image_rows[comm.rank()]) * imsizex)};
+  std::array<t_int, 3> M = {0, 1, static_cast<t_int>(u.size())};
+  sopt::OperatorFunction<T> directDegrid, indirectDegrid;
+  std::tie(directDegrid, indirectDegrid) = purify::operators::base_mpi_slab_degrid_operator_2d<T>(
+      comm, u, v, w, weights, imsizey, imsizex, oversample_ratio, kernel, Ju, Jv, ft_plan,
+      w_stacking, cellx, celly, true);
+  return std::make_shared<sopt::LinearTransform<T>>(directDegrid, M, indirectDegrid, N);
+}
+
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_image_slabs(
+    const sopt::mpi::Communicator &comm, const utilities::vis_params &uv_vis_input,
+    const t_uint &imsizey, const t_uint &imsizex, const t_real &cell_x, const t_real &cell_y,
+    const t_real &oversample_ratio = 2, const kernels::kernel kernel = kernels::kernel::kb,
+    const t_uint Ju = 4, const t_uint Jv = 4, const bool w_stacking = false) {
+  const auto uv_vis = utilities::convert_to_pixels(uv_vis_input, cell_x, cell_y, imsizex, imsizey,
+                                                   oversample_ratio);
+  return init_degrid_operator_2d_image_slabs<T>(comm, uv_vis.u, uv_vis.v, uv_vis.w,
+                                                uv_vis.weights, imsizey, imsizex,
+                                                oversample_ratio, kernel, Ju, Jv, w_stacking,
+                                                cell_x, cell_y);
+}
+
+//! w-projection is not available with the image distributed in slabs
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_image_slabs(
+    const sopt::mpi::Communicator &comm, const utilities::vis_params &uv_vis_input,
+    const t_uint imsizey, const t_uint imsizex, const t_real cell_x, const t_real cell_y,
+    const t_real oversample_ratio, const kernels::kernel kernel, const t_uint Ju, const t_uint Jw,
+    const bool w_stacking, const t_real absolute_error, const t_real relative_error,
+    const dde_type dde) {
+  throw std::runtime_error(
+      "w-projection is not supported by the measurement operator with the image distributed in "
+      "slabs.");
+}
+
+//! w-projection is not available with the slab distributed FFT grid
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_degrid_operator_2d_slabs(
+    const sopt::mpi::Communicator &comm, const utilities::vis_params &uv_vis_input,
+    const t_uint imsizey, const t_uint imsizex, const t_real cell_x, const t_real cell_y,
+    const t_real oversample_ratio, const kernels::kernel kernel, const t_uint Ju, const t_uint Jw,
+    const bool w_stacking, const t_real absolute_error, const t_real relative_error,
+    const dde_type dde) {
+  throw std::runtime_error(
+      "w-projection is not supported by the measurement operator with the FFT grid distributed in "
+      "slabs.");
+}
+}  // namespace measurementoperator
+}  // namespace purify
+#endif
+#endif
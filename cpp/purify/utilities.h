@@ -76,6 +76,23 @@ sparse_multiply_matrix(const Eigen::SparseMatrixBase<T0> &M, const Eigen::Matrix
       y(k) += it.value() * x(it.index());
   return y;
 }
+//! Parallel multiplication of a row major sparse matrix with each column of a dense matrix
+template <class T0, class T1>
+typename std::enable_if<std::is_same<typename T0::Scalar, typename T1::Scalar>::value and
+                            T0::IsRowMajor,
+                        Matrix<typename T0::Scalar>>::type
+sparse_multiply_dense_matrix(const Eigen::SparseMatrixBase<T0> &M,
+                             const Eigen::MatrixBase<T1> &x) {
+  assert(M.cols() == x.rows());
+  Matrix<typename T0::Scalar> y = Matrix<typename T0::Scalar>::Zero(M.rows(), x.cols());
+  auto const &derived = M.derived();
+  // each index and kernel value is read once and applied to every column
+#pragma omp parallel for
+  for (t_int k = 0; k < M.outerSize(); ++k)
+    for (typename Sparse<typename T0::Scalar>::InnerIterator it(derived, k); it; ++it)
+      for (t_int j = 0; j < x.cols(); ++j) y(k, j) += it.value() * x(it.index(), j);
+  return y;
+}
 //! Reads a diagnostic file and updates parameters
 std::tuple<t_int, t_real> checkpoint_log(const std::string &diagnostic);
 //! Multiply images coefficient-wise using openmp
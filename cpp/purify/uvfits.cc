@@ -1,6 +1,9 @@
 #include "purify/uvfits.h"
 #include "purify/config.h"
 #include <fitsio.h>
+#include <algorithm>
+#include <array>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -8,45 +11,92 @@
 
 namespace purify {
 namespace pfitsio {
+namespace {
+//! Resizes the columns of the visibilities, keeping their values
+void resize(utilities::vis_params &uv_data, const t_uint size) {
+  uv_data.u.conservativeResize(size);
+  uv_data.v.conservativeResize(size);
+  uv_data.w.conservativeResize(size);
+  uv_data.time.conservativeResize(size);
+  uv_data.baseline.conservativeResize(size);
+  uv_data.vis.conservativeResize(size);
+  uv_data.weights.conservativeResize(size);
+}
+//! Keys of a uvfits header that fix the number of visibilities and the pointing
+struct uvfits_header {
+  t_int groups;
+  t_int channels;
+  t_real ra;
+  t_real dec;
+};
 
-utilities::vis_params read_uvfits(const std::vector<std::string> &names, const bool flag,
-                                  const stokes pol) {
-  utilities::vis_params output = read_uvfits(names.at(0), flag, pol);
-  if (names.size() == 1) return output;
-  for (int i = 1; i < names.size(); i++) output = read_uvfits(names.at(i), output);
-  return output;
+uvfits_header read_header(const std::string &filename) {
+  fitsfile *fptr;
+  int status = 0;
+  uvfits_header header;
+  if (fits_open_file(&fptr, filename.c_str(), READONLY, &status))
+    throw std::runtime_error("Could not open file " + filename);
+  fits_read_key(fptr, TINT, "GCOUNT", &header.groups, nullptr, &status);
+  fits_read_key(fptr, TINT, "NAXIS4", &header.channels, nullptr, &status);
+  fits_read_key(fptr, TDOUBLE, "CRVAL5", &header.ra, nullptr, &status);
+  fits_read_key(fptr, TDOUBLE, "CRVAL6", &header.dec, nullptr, &status);
+  fits_close_file(fptr, &status);
+  if (status) {
+    fits_report_error(stderr, status);
+    throw std::runtime_error("Error reading header of " + filename);
+  }
+  return header;
 }
 
-utilities::vis_params read_uvfits(const std::string &vis_name2, const utilities::vis_params &uv1,
-                                  const bool flag, const stokes pol) {
-  utilities::vis_params uv;
-  const bool w_term = not uv1.w.isZero(0);
-  const auto uv2 = read_uvfits(vis_name2, flag, pol);
-  if (std::abs(uv1.ra - uv2.ra) > 1e-6)
-    throw std::runtime_error(vis_name2 + ": wrong RA in pointing.");
-  if (std::abs(uv1.dec - uv2.dec) > 1e-6)
-    throw std::runtime_error(vis_name2 + ": wrong DEC in pointing.");
-  uv.ra = uv1.ra;
-  uv.dec = uv1.dec;
-  uv.u = Vector<t_real>::Zero(uv1.size() + uv2.size());
-  uv.v = Vector<t_real>::Zero(uv1.size() + uv2.size());
-  uv.w = Vector<t_real>::Zero(uv1.size() + uv2.size());
-  uv.vis = Vector<t_complex>::Zero(uv1.size() + uv2.size());
-  uv.weights = Vector<t_complex>::Zero(uv1.size() + uv2.size());
-  uv.u.segment(0, uv1.size()) = uv1.u;
-  uv.v.segment(0, uv1.size()) = uv1.v;
-  uv.w.segment(0, uv1.size()) = uv1.w;
-  uv.vis.segment(0, uv1.size()) = uv1.vis;
-  uv.weights.segment(0, uv1.size()) = uv1.weights;
-  uv.u.segment(uv1.size(), uv2.size()) = uv2.u;
-  uv.v.segment(uv1.size(), uv2.size()) = uv2.v;
-  uv.w.segment(uv1.size(), uv2.size()) = uv2.w;
-  uv.vis.segment(uv1.size(), uv2.size()) = uv2.vis;
-  uv.weights.segment(uv1.size(), uv2.size()) = uv2.weights;
-  return uv;
+//! Grows the columns geometrically to hold at least size visibilities, and at most limit
+void reserve(utilities::vis_params &uv_data, const t_uint size, const t_uint limit) {
+  if (size <= uv_data.size()) return;
+  resize(uv_data, std::min(limit, std::max(size, 2 * uv_data.size())));
 }
 
-utilities::vis_params read_uvfits(const std::string &filename, const bool flag, const stokes pol) {
+//! Moves the segments of a column, so that the visibilities of each channel are contiguous
+//! \details starts(k, c) and counts(k, c) are the segment of channel c in block k.
+template <class T>
+void order_by_channel(Eigen::Matrix<T, Eigen::Dynamic, 1> &column, const t_uint position,
+                      const std::vector<std::vector<t_uint>> &starts,
+                      const std::vector<std::vector<t_uint>> &counts, const t_uint size) {
+  const Eigen::Matrix<T, Eigen::Dynamic, 1> blocks = column.segment(position, size);
+  t_uint row = position;
+  for (t_uint c = 0; c < counts.front().size(); c++)
+    for (t_uint k = 0; k < counts.size(); k++) {
+      column.segment(row, counts[k][c]) = blocks.segment(starts[k][c], counts[k][c]);
+      row += counts[k][c];
+    }
+}
+
+//! Orders the visibilities from position onwards by channel, then group
+//! \details Each block is already ordered by channel, with counts[k][c] visibilities of channel c
+//! in block k. One column is copied at a time.
+void order_by_channel(utilities::vis_params &uv_data, const t_uint position,
+                      const std::vector<std::vector<t_uint>> &counts) {
+  if (counts.size() < 2) return;
+  std::vector<std::vector<t_uint>> starts(counts.size());
+  t_uint size = 0;
+  for (t_uint k = 0; k < counts.size(); k++)
+    for (const auto kept : counts[k]) {
+      starts[k].push_back(size);
+      size += kept;
+    }
+  order_by_channel(uv_data.u, position, starts, counts, size);
+  order_by_channel(uv_data.v, position, starts, counts, size);
+  order_by_channel(uv_data.w, position, starts, counts, size);
+  order_by_channel(uv_data.time, position, starts, counts, size);
+  order_by_channel(uv_data.baseline, position, starts, counts, size);
+  order_by_channel(uv_data.vis, position, starts, counts, size);
+  order_by_channel(uv_data.weights, position, starts, counts, size);
+}
+
+//! Reads the groups of a uvfits file into uv_data from position onwards
+//! \details The columns of uv_data grow as needed, and may be longer than the visibilities read.
+//! \returns position after the last visibility read
+t_uint read_uvfits(const std::string &filename, const bool flag, const stokes pol,
+                   const t_int first_group, const t_int groups, const t_uint buffer_bytes,
+                   utilities::vis_params &uv_data, const t_uint position) {
   fitsfile *fptr;
   int status = 0;
   int hdupos;
@@ -60,6 +110,11 @@ utilities::vis_params read_uvfits(const std::string &filename, const bool flag,
   PURIFY_MEDIUM_LOG("Reading uvfits {}", filename);
   if (fits_open_file(&fptr, filename.c_str(), READONLY, &status))
     throw std::runtime_error("Could not open file " + filename);
+  // closes the file when leaving, also when an error is thrown
+  const std::shared_ptr<fitsfile> file(fptr, [](fitsfile *ptr) {
+    int status = 0;
+    fits_close_file(ptr, &status);
+  });
 
   int hdutype;
   if (fits_movabs_hdu(fptr, 1, &hdutype, &status)) throw std::runtime_error("Error changing HDU.");
@@ -71,6 +126,11 @@ utilities::vis_params read_uvfits(const std::string &filename, const bool flag,
   fits_read_key(fptr, TINT, "GCOUNT", &baselines, comment.get(), &status);
   fits_read_key(fptr, TINT, "NAXIS", &naxes, comment.get(), &status);
   fits_read_key(fptr, TINT, "PCOUNT", &pcount, comment.get(), &status);
+  // a negative number of groups reads to the end of the file
+  const t_int total_groups = baselines;
+  baselines = (groups < 0) ? total_groups - first_group : groups;
+  if (first_group < 0 or baselines < 0 or first_group + baselines > total_groups)
+    throw std::runtime_error("Groups to read are outside of " + filename);
   if (naxes == 0) throw std::runtime_error("No axes in header... ");
   if (pcount == 0) throw std::runtime_error("No uvw or time coordinates in header... ");
   t_uint total = 1;
@@ -100,16 +160,14 @@ utilities::vis_params read_uvfits(const std::string &filename, const bool flag,
   PURIFY_MEDIUM_LOG("Total data per baseline: {}", total);
   if (pointings_num > 1) throw std::runtime_error("More than one pointing is not supported.");
   if (ifs > 1) throw std::runtime_error("More than one IF is not supported.");
-  PURIFY_LOW_LOG("Reading Data...");
-
-  const Matrix<t_real> coords = read_uvfits_coords(fptr, &status, baselines, pcount);
-
-  //  (real, imag, weight, pol, frequency) is the order
-  const Vector<t_real> data = read_uvfits_data(fptr, &status, naxis, baselines);
   const Vector<t_real> frequencies = read_uvfits_freq(fptr, &status, 4);
   if (frequencies.size() != channels)
     throw std::runtime_error("Number of frequencies doesn't match number of channels. " +
                              std::to_string(frequencies.size()) + "!=" + std::to_string(channels));
+  if (status) { /* print any error messages */
+    fits_report_error(stderr, status);
+    throw std::runtime_error("Error reading fits file...");
+  }
   int pol_index1;
   int pol_index2;
   Vector<t_complex> stokes_transform = Vector<t_complex>::Zero(2);
@@ -149,26 +207,160 @@ utilities::vis_params read_uvfits(const std::string &filename, const bool flag,
     stokes_transform(1) = 1. / 2;
     break;
   }
-  fits_close_file(fptr, &status);
-  if (status) { /* print any error messages */
-    fits_report_error(stderr, status);
-    throw std::runtime_error("Error reading fits file...");
+  if (pol_index1 >= pols) throw std::runtime_error("Polarisation index out of bounds.");
+  if (pol_index2 >= pols) throw std::runtime_error("Polarisation index out of bounds.");
+
+  // two buffers of groups are used, one being read while the other is flagged
+  const t_uint group_bytes = (pcount + total) * sizeof(t_real);
+  const t_int block = std::max<t_int>(
+      1, std::min<t_uint>(baselines, buffer_bytes / (2 * group_bytes)));
+  PURIFY_LOW_LOG("Reading Data in blocks of {} groups...", block);
+  std::array<Matrix<t_real>, 2> coords;
+  std::array<Vector<t_real>, 2> data;
+  const auto read_block = [fptr, &naxis, &coords, &data, pcount, first_group, block,
+                           baselines](const t_int start, const t_int buffer) {
+    int status = 0;
+    const t_int size = std::min(block, baselines - start);
+    read_uvfits_coords(fptr, &status, pcount, size, coords[buffer], first_group + start);
+    read_uvfits_data(fptr, &status, naxis, size, data[buffer], first_group + start);
+    if (status) {
+      fits_report_error(stderr, status);
+      throw std::runtime_error("Error reading fits file...");
+    }
+  };
+
+  // each block is ordered by channel, and the blocks are merged by channel at the end
+  std::vector<std::vector<t_uint>> block_counts;
+  t_uint count = position;
+  std::future<void> pending;
+  if (baselines > 0) pending = std::async(std::launch::async, read_block, 0, 0);
+  for (t_int start = 0; start < baselines; start += block) {
+    const t_int buffer = (start / block) % 2;
+    const t_int size = std::min(block, baselines - start);
+    pending.get();
+    if (start + block < baselines)
+      pending = std::async(std::launch::async, read_block, start + block, 1 - buffer);
+    reserve(uv_data, count + size * channels, position + baselines * channels);
+    block_counts.push_back(read_polarisation_with_flagging(
+        data[buffer], coords[buffer], frequencies, pol_index1, pol_index2, pols, size, channels,
+        stokes_transform,
+        [flag](const t_complex vis1, const t_complex weight1, const t_complex vis2,
+               const t_complex weight2) {
+          if (flag)
+            return (weight1.real() > 0.) and (weight2.real() > 0.) and
+                   (std::abs(vis1) > 1e-20) and (std::abs(vis2) > 1e-20) and
+                   (!std::isnan(vis1.real()) and !std::isnan(vis1.imag())) and
+                   (!std::isnan(vis2.real()) and !std::isnan(vis2.imag()));
+          else
+            return true;
+        },
+        uv_data, count));
+    for (const auto kept : block_counts.back()) count += kept;
   }
-  auto uv_data = read_polarisation_with_flagging(
-      data, coords, frequencies, pol_index1, pol_index2, pols, baselines, channels,
-      stokes_transform,
-      [flag](const t_complex vis1, const t_complex weight1, const t_complex vis2,
-             const t_complex weight2) {
-        if (flag)
-          return (weight1.real() > 0.) and (weight2.real() > 0.) and (std::abs(vis1) > 1e-20) and
-                 (std::abs(vis2) > 1e-20) and
-                 (!std::isnan(vis1.real()) and !std::isnan(vis1.imag())) and
-                 (!std::isnan(vis2.real()) and !std::isnan(vis2.imag()));
-        else
-          return true;
-      });
+  order_by_channel(uv_data, position, block_counts);
+  PURIFY_LOW_LOG("Applying flags: Keeping {} out of {} data points.", count - position,
+                 channels * baselines);
+  uv_data.frequencies = frequencies;
+  uv_data.average_frequency = frequencies.array().mean();
+  uv_data.units = utilities::vis_units::lambda;
   uv_data.ra = ra;
   uv_data.dec = dec;
+  PURIFY_MEDIUM_LOG("All Data Read!");
+  return count;
+}
+}  // namespace
+
+utilities::vis_params read_uvfits(const std::vector<std::string> &names, const bool flag,
+                                  const stokes pol) {
+  if (names.size() == 1) return read_uvfits(names.at(0), flag, pol);
+  // the output is sized for all visibilities in the headers, and trimmed after flagging
+  t_uint total = 0;
+  t_real ra = 0;
+  t_real dec = 0;
+  for (t_int i = 0; i < names.size(); i++) {
+    const auto header = read_header(names.at(i));
+    if (i == 0) {
+      ra = header.ra;
+      dec = header.dec;
+    }
+    if (std::abs(ra - header.ra) > 1e-6)
+      throw std::runtime_error(names.at(i) + ": wrong RA in pointing.");
+    if (std::abs(dec - header.dec) > 1e-6)
+      throw std::runtime_error(names.at(i) + ": wrong DEC in pointing.");
+    total += header.groups * header.channels;
+  }
+  utilities::vis_params output;
+  resize(output, total);
+  t_uint position = 0;
+  Vector<t_real> frequencies;
+  t_real average_frequency = 0;
+  for (t_int i = 0; i < names.size(); i++) {
+    position = read_uvfits(names.at(i), flag, pol, 0, -1, default_buffer_bytes, output, position);
+    if (i == 0) {
+      frequencies = output.frequencies;
+      average_frequency = output.average_frequency;
+    }
+  }
+  resize(output, position);
+  output.frequencies = frequencies;
+  output.average_frequency = average_frequency;
+  PURIFY_MEDIUM_LOG("Read {} visibilities from {} uvfits files.", position, names.size());
+  return output;
+}
+
+utilities::vis_params read_uvfits(const std::string &vis_name2, const utilities::vis_params &uv1,
+                                  const bool flag, const stokes pol) {
+  utilities::vis_params uv;
+  const bool w_term = not uv1.w.isZero(0);
+  const auto uv2 = read_uvfits(vis_name2, flag, pol);
+  if (std::abs(uv1.ra - uv2.ra) > 1e-6)
+    throw std::runtime_error(vis_name2 + ": wrong RA in pointing.");
+  if (std::abs(uv1.dec - uv2.dec) > 1e-6)
+    throw std::runtime_error(vis_name2 + ": wrong DEC in pointing.");
+  uv.ra = uv1.ra;
+  uv.dec = uv1.dec;
+  uv.u = Vector<t_real>::Zero(uv1.size() + uv2.size());
+  uv.v = Vector<t_real>::Zero(uv1.size() + uv2.size());
+  uv.w = Vector<t_real>::Zero(uv1.size() + uv2.size());
+  uv.vis = Vector<t_complex>::Zero(uv1.size() + uv2.size());
+  uv.weights = Vector<t_complex>::Zero(uv1.size() + uv2.size());
+  uv.u.segment(0, uv1.size()) = uv1.u;
+  uv.v.segment(0, uv1.size()) = uv1.v;
+  uv.w.segment(0, uv1.size()) = uv1.w;
+  uv.vis.segment(0, uv1.size()) = uv1.vis;
+  uv.weights.segment(0, uv1.size()) = uv1.weights;
+  uv.u.segment(uv1.size(), uv2.size()) = uv2.u;
+  uv.v.segment(uv1.size(), uv2.size()) = uv2.v;
+  uv.w.segment(uv1.size(), uv2.size()) = uv2.w;
+  uv.vis.segment(uv1.size(), uv2.size()) = uv2.vis;
+  uv.weights.segment(uv1.size(), uv2.size()) = uv2.weights;
+  return uv;
+}
+
+utilities::vis_params read_uvfits(const std::string &filename, const bool flag, const stokes pol) {
+  return read_uvfits(filename, flag, pol, 0, -1);
+}
+
+t_int read_uvfits_groups(const std::string &filename) {
+  fitsfile *fptr;
+  int status = 0;
+  int groups = 0;
+  if (fits_open_file(&fptr, filename.c_str(), READONLY, &status))
+    throw std::runtime_error("Could not open file " + filename);
+  fits_read_key(fptr, TINT, "GCOUNT", &groups, nullptr, &status);
+  fits_close_file(fptr, &status);
+  if (status) {
+    fits_report_error(stderr, status);
+    throw std::runtime_error("Error reading number of groups from " + filename);
+  }
+  return groups;
+}
+
+utilities::vis_params read_uvfits(const std::string &filename, const bool flag, const stokes pol,
+                                  const t_int first_group, const t_int groups,
+                                  const t_uint buffer_bytes) {
+  utilities::vis_params uv_data;
+  resize(uv_data, read_uvfits(filename, flag, pol, first_group, groups, buffer_bytes, uv_data, 0));
   return uv_data;
 }
 
@@ -281,6 +473,37 @@ utilities::vis_params read_polarisation_with_flagging(
   PURIFY_MEDIUM_LOG("All Data Read!");
   return uv_data;
 }
+std::vector<t_uint> read_polarisation_with_flagging(
+    const Vector<t_real> &data, const Matrix<t_real> &coords, const Vector<t_real> &frequencies,
+    const t_uint pol_index1, const t_uint pol_index2, const t_uint pols, const t_uint baselines,
+    const t_uint channels, const Vector<t_complex> &stokes_transform,
+    const std::function<bool(t_complex, t_complex, t_complex, t_complex)> &filter,
+    utilities::vis_params &uv_data, const t_uint position) {
+  std::vector<t_uint> counts(channels, 0);
+  t_uint count = position;
+  for (t_uint c = 0; c < channels; c++)
+    for (t_uint b = 0; b < baselines; b++) {
+      t_complex const weight1 =
+          read_weight_from_data(data, pol_index1, pols, c, channels, b, baselines);
+      t_complex const weight2 =
+          read_weight_from_data(data, pol_index2, pols, c, channels, b, baselines);
+      t_complex const vis1 = read_vis_from_data(data, pol_index1, pols, c, channels, b, baselines);
+      t_complex const vis2 = read_vis_from_data(data, pol_index2, pols, c, channels, b, baselines);
+      if (filter(vis1, weight1, vis2, weight2)) {
+        uv_data.vis(count) = vis1 * stokes_transform(0) + vis2 * stokes_transform(1);
+        uv_data.weights(count) =
+            1. / std::sqrt(1. / weight1 * stokes_transform(0) + 1. / weight2 * stokes_transform(1));
+        uv_data.u(count) = coords(0, b) * frequencies(c);
+        uv_data.v(count) = -coords(1, b) * frequencies(c);
+        uv_data.w(count) = coords(2, b) * frequencies(c);
+        uv_data.baseline(count) = static_cast<t_uint>(coords(3, b));
+        uv_data.time(count) = coords(4, b);
+        counts[c]++;
+        count++;
+      }
+    }
+  return counts;
+}
 utilities::vis_params read_polarisation(const Vector<t_real> &data, const Matrix<t_real> &coords,
                                         const Vector<t_real> &frequencies, const t_uint pol_index1,
                                         const t_uint pols, const t_uint baselines,
@@ -344,30 +567,32 @@ void read_uvfits_freq(fitsfile *fptr, int *status, Vector<t_real> &output, const
 }
 
 Vector<t_real> read_uvfits_data(fitsfile *fptr, int *status, const std::vector<int> &naxis,
-                                const int &baselines) {
+                                const int &baselines, const int &first_baseline) {
   Vector<t_real> output;
-  read_uvfits_data(fptr, status, naxis, baselines, output);
+  read_uvfits_data(fptr, status, naxis, baselines, output, first_baseline);
   return output;
 }
 
 void read_uvfits_data(fitsfile *fptr, int *status, const std::vector<int> &naxis,
-                      const int &baselines, Vector<t_real> &output) {
+                      const int &baselines, Vector<t_real> &output, const int &first_baseline) {
   long nelements = 1;
   for (int i = 2; i < naxis.size(); i++) {
     nelements *= static_cast<long>(naxis.at(i));
   }
   if (nelements == 0) throw std::runtime_error("Zero number of elements.");
   output = Vector<t_real>::Zero(naxis.at(1) * nelements * baselines);
+  if (output.size() == 0) return;
   int nulval = 0;
   int anynul = 0;
-  fits_read_col(fptr, TDOUBLE, 2, 1, 1, static_cast<long>(output.size()), &nulval, output.data(),
-                &anynul, status);
+  // reading past the end of a row continues with the next group
+  fits_read_col(fptr, TDOUBLE, 2, 1 + first_baseline, 1, static_cast<long>(output.size()), &nulval,
+                output.data(), &anynul, status);
 }
 
 Matrix<t_real> read_uvfits_coords(fitsfile *fptr, int *status, const int &groups,
-                                  const int &pcount) {
+                                  const int &pcount, const int &first_group) {
   Matrix<t_real> output;
-  read_uvfits_coords(fptr, status, pcount, groups, output);
+  read_uvfits_coords(fptr, status, pcount, groups, output, first_group);
   return output;
 }
 
@@ -392,14 +617,14 @@ t_complex read_weight_from_data(const Vector<t_real> &data, const t_uint pol, co
 }
 
 void read_uvfits_coords(fitsfile *fptr, int *status, const int &pcount, const int &groups,
-                        Matrix<t_real> &output) {
+                        Matrix<t_real> &output, const int &first_group) {
   output = Matrix<t_real>::Zero(pcount, groups);
   int nulval = 0;
   int anynul;
   // reading in parameters per baseline
   for (int i = 0; i < groups; i++)
-    fits_read_col(fptr, TDOUBLE, 1, 1 + i, 1, pcount, &nulval, output.col(i).data(), &anynul,
-                  status);
+    fits_read_col(fptr, TDOUBLE, 1, 1 + first_group + i, 1, pcount, &nulval, output.col(i).data(),
+                  &anynul, status);
 }
 
 void read_fits_keys(fitsfile *fptr, int *status) {
@@ -13,9 +13,20 @@ namespace purify {
 
 namespace pfitsio {
 
+//! Bytes of file data held in memory while streaming a uvfits file
+const t_uint default_buffer_bytes = 64 * 1024 * 1024;
 //! Read uvfits file
 utilities::vis_params read_uvfits(const std::string &filename, const bool flag = true,
                                   const stokes pol = stokes::I);
+//! Read the groups (baselines) [first_group, first_group + groups) of a uvfits file
+//! \details The groups are streamed in blocks, so that the file data held in memory is at most
+//! buffer_bytes, independent of the size of the file. The next block is read on a background
+//! thread while the last one is flagged. Visibilities are ordered by channel, then group.
+utilities::vis_params read_uvfits(const std::string &filename, const bool flag, const stokes pol,
+                                  const t_int first_group, const t_int groups,
+                                  const t_uint buffer_bytes = default_buffer_bytes);
+//! Number of groups (baselines) in a uvfits file, read from the header
+t_int read_uvfits_groups(const std::string &filename);
 //! Read uvfits files from name of vector
 utilities::vis_params read_uvfits(const std::vector<std::string> &names, const bool flag = true,
                                   const stokes pol = stokes::I);
@@ -42,6 +53,16 @@ utilities::vis_params read_polarisation_with_flagging(
     const t_uint pol_index1, const t_uint pol_index2, const t_uint pols, const t_uint baselines,
     const t_uint channels, const Vector<t_complex> stokes_transform,
     const std::function<bool(t_complex, t_complex, t_complex, t_complex)> &filter);
+//! Flags and combines polarisations of groups into uv_data, starting at position
+//! \details uv_data has to have room for channels * baselines visibilities after position. The
+//! visibilities are ordered by channel, then group.
+//! \returns number of visibilities kept in each channel
+std::vector<t_uint> read_polarisation_with_flagging(
+    const Vector<t_real> &data, const Matrix<t_real> &coords, const Vector<t_real> &frequencies,
+    const t_uint pol_index1, const t_uint pol_index2, const t_uint pols, const t_uint baselines,
+    const t_uint channels, const Vector<t_complex> &stokes_transform,
+    const std::function<bool(t_complex, t_complex, t_complex, t_complex)> &filter,
+    utilities::vis_params &uv_data, const t_uint position);
 //! Read uvfits keys out
 void read_fits_keys(fitsfile *fptr, int *status);
 //! read frequencies for each channel
@@ -49,9 +70,9 @@ Vector<t_real> read_uvfits_freq(fitsfile *fptr, int *status, const int &col);
 void read_uvfits_freq(fitsfile *fptr, int *status, Vector<t_real> &output, const int &col);
 //! read coordinates from uvfits file
 Matrix<t_real> read_uvfits_coords(fitsfile *fptr, int *status, const int &groups,
-                                  const int &pcount);
+                                  const int &pcount, const int &first_group = 0);
 void read_uvfits_coords(fitsfile *fptr, int *status, const int &groups, const int &pcount,
-                        Matrix<t_real> &output);
+                        Matrix<t_real> &output, const int &first_group = 0);
 //! read polarisation data from uvfits data
 utilities::vis_params read_polarisation(const Vector<t_real> &data, const Matrix<t_real> &coords,
                                         const Vector<t_real> &frequencies, const t_uint pol_index1,
@@ -59,9 +80,10 @@ utilities::vis_params read_polarisation(const Vector<t_real> &data, const Matrix
                                         const t_uint channels);
 //! read data from uvfits file
 Vector<t_real> read_uvfits_data(fitsfile *fptr, int *status, const std::vector<int> &naxis,
-                                const int &baselines);
+                                const int &baselines, const int &first_baseline = 0);
 void read_uvfits_data(fitsfile *fptr, int *status, const std::vector<int> &naxis,
-                      const int &baselines, Vector<t_real> &output);
+                      const int &baselines, Vector<t_real> &output,
+                      const int &first_baseline = 0);
 //! read value from data
 t_real read_value_from_data(const Vector<t_real> &data, const t_uint col, const t_uint pol,
                             const t_uint pols, const t_uint chan, const t_uint chans,
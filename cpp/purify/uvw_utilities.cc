@@ -1,13 +1,205 @@
 #include "purify/uvw_utilities.h"
 #include "purify/config.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <numeric>
 #include <random>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include "purify/logging.h"
 #include "purify/operators.h"
+#include "purify/wide_field_utilities.h"
+#ifdef PURIFY_OPENMP
+#include <omp.h>
+#endif
 
 namespace purify {
 namespace utilities {
+namespace {
+//! A newline aligned part of a mapped text file, and the row of its first line
+struct text_chunk {
+  const char *begin;
+  const char *end;
+  t_int file;
+  t_int row;
+};
+
+//! Splits [begin, end) into about the given number of parts that end after a newline
+std::vector<text_chunk> split_lines(const char *begin, const char *end, const t_int file,
+                                    const t_int parts) {
+  std::vector<text_chunk> chunks;
+  const std::size_t length = end - begin;
+  const char *chunk_begin = begin;
+  for (t_int i = 1; i <= parts and chunk_begin < end; i++) {
+    const char *chunk_end = (i == parts) ? end : begin + (length * i) / parts;
+    if (chunk_end < chunk_begin) chunk_end = chunk_begin;
+    if (chunk_end < end) {
+      const void *newline = std::memchr(chunk_end, '\n', end - chunk_end);
+      chunk_end = newline ? static_cast<const char *>(newline) + 1 : end;
+    }
+    if (chunk_end > chunk_begin) chunks.push_back(text_chunk{chunk_begin, chunk_end, file, 0});
+    chunk_begin = chunk_end;
+  }
+  return chunks;
+}
+
+bool is_blank(const char *begin, const char *end) {
+  for (const char *c = begin; c < end; c++)
+    if (not std::isspace(static_cast<unsigned char>(*c))) return false;
+  return true;
+}
+
+//! Number of lines of a chunk that are not blank
+t_int count_rows(const text_chunk &chunk) {
+  t_int rows = 0;
+  const char *line = chunk.begin;
+  while (line < chunk.end) {
+    const void *newline = std::memchr(line, '\n', chunk.end - line);
+    const char *line_end = newline ? static_cast<const char *>(newline) : chunk.end;
+    if (not is_blank(line, line_end)) rows++;
+    line = line_end + 1;
+  }
+  return rows;
+}
+
+//! Parses the values of one line, which is terminated by a newline or null character
+void parse_line(const char *line, const char *line_end, const bool w_term, const t_int row,
+                utilities::vis_params &output) {
+  const char *position = line;
+  const auto next = [&position, line, line_end]() {
+    // strtod would also skip the newline, so the blanks before a value are skipped here
+    while (position < line_end and (*position == ' ' or *position == '\t' or *position == ','))
+      position++;
+    char *token_end = const_cast<char *>(position);
+    // strtod reads inf and nan too
+    const t_real value = (position < line_end) ? std::strtod(position, &token_end) : 0;
+    if (token_end == position)
+      throw std::runtime_error("Could not read line: " + std::string(line, line_end));
+    position = token_end;
+    return value;
+  };
+  output.u(row) = next();
+  // found that a reflection is needed for the orientation of the gridded image to be correct
+  output.v(row) = -next();
+  output.w(row) = w_term ? next() : 0.;
+  const t_real real = next();
+  const t_real imag = next();
+  output.vis(row) = t_complex(real, imag);
+  output.weights(row) = 1 / next();
+}
+
+//! Parses the lines of a chunk that are not blank into output, starting at the row of the chunk
+void parse_rows(const text_chunk &chunk, const bool w_term, utilities::vis_params &output) {
+  t_int row = chunk.row;
+  const char *line = chunk.begin;
+  while (line < chunk.end) {
+    const void *newline = std::memchr(line, '\n', chunk.end - line);
+    const char *line_end = newline ? static_cast<const char *>(newline) : chunk.end;
+    if (not is_blank(line, line_end)) {
+      if (newline)
+        parse_line(line, line_end, w_term, row, output);
+      else {
+        // the last line of a file without a newline is copied so that it is null terminated
+        const std::string last_line(line, line_end);
+        parse_line(last_line.c_str(), last_line.c_str() + last_line.size(), w_term, row, output);
+      }
+      row++;
+    }
+    line = line_end + 1;
+  }
+}
+
+//! Start of the first line that starts at or after offset
+std::uint64_t line_start(const char *data, const std::uint64_t length,
+                         const std::uint64_t offset) {
+  if (offset == 0 or offset >= length) return std::min(offset, length);
+  const void *newline = std::memchr(data + offset - 1, '\n', length - offset + 1);
+  return newline ? static_cast<const char *>(newline) - data + 1 : length;
+}
+
+//! Reads visibility text files into one set of visibilities
+//! \details Only the lines of each file that start in the bytes [first, first + count) are read.
+utilities::vis_params read_visibility_files(
+    const std::vector<std::string> &names, const bool w_term, const std::uint64_t first = 0,
+    const std::uint64_t count = std::numeric_limits<std::uint64_t>::max()) {
+#ifdef PURIFY_OPENMP
+  const t_int parts = 4 * omp_get_max_threads();
+#else
+  const t_int parts = 1;
+#endif
+  std::vector<std::shared_ptr<const char>> files;
+  std::vector<text_chunk> chunks;
+  for (t_int i = 0; i < names.size(); i++) {
+    std::uint64_t length = 0;
+    files.push_back(map_file(names.at(i), length));
+    const char *const data = files.back().get();
+    const std::uint64_t last = (count < length - std::min(first, length)) ? first + count : length;
+    const auto file_chunks = split_lines(data + line_start(data, length, first),
+                                         data + line_start(data, length, last), i, parts);
+    chunks.insert(chunks.end(), file_chunks.begin(), file_chunks.end());
+  }
+  std::vector<t_int> rows(chunks.size());
+#pragma omp parallel for schedule(dynamic, 1)
+  for (t_int i = 0; i < chunks.size(); i++) rows[i] = count_rows(chunks[i]);
+  t_int total = 0;
+  for (t_int i = 0; i < chunks.size(); i++) {
+    chunks[i].row = total;
+    total += rows[i];
+  }
+  utilities::vis_params uv_vis;
+  uv_vis.u = Vector<t_real>(total);
+  uv_vis.v = Vector<t_real>(total);
+  uv_vis.w = Vector<t_real>(total);
+  uv_vis.vis = Vector<t_complex>(total);
+  uv_vis.weights = Vector<t_complex>(total);
+  // exceptions can not leave a parallel region, so the first one is thrown after it
+  std::string error = "";
+#pragma omp parallel for schedule(dynamic, 1)
+  for (t_int i = 0; i < chunks.size(); i++) {
+    try {
+      parse_rows(chunks[i], w_term, uv_vis);
+    } catch (const std::runtime_error &e) {
+#pragma omp critical(read_visibility_error)
+      if (error == "") error = names.at(chunks[i].file) + ": " + e.what();
+    }
+  }
+  if (error != "") throw std::runtime_error(error);
+  uv_vis.ra = 0;
+  uv_vis.dec = 0;
+  uv_vis.average_frequency = 0;
+  return uv_vis;
+}
+
+//! Sorts [begin, end) by sorting one chunk per thread and merging the chunks pairwise
+template <class Iterator, class Compare>
+void parallel_sort(const Iterator begin, const Iterator end, const Compare &compare) {
+  const t_int size = end - begin;
+#ifdef PURIFY_OPENMP
+  const t_int chunks = std::max<t_int>(1, std::min<t_int>(omp_get_max_threads(), size / 4096));
+#else
+  const t_int chunks = 1;
+#endif
+  std::vector<t_int> bounds(chunks + 1);
+  for (t_int i = 0; i <= chunks; i++) bounds[i] = (static_cast<std::int64_t>(size) * i) / chunks;
+#pragma omp parallel for
+  for (t_int i = 0; i < chunks; i++)
+    std::sort(begin + bounds[i], begin + bounds[i + 1], compare);
+  for (t_int width = 1; width < chunks; width *= 2) {
+#pragma omp parallel for
+    for (t_int i = 0; i < chunks - width; i += 2 * width)
+      std::inplace_merge(begin + bounds[i], begin + bounds[i + width],
+                         begin + bounds[std::min(i + 2 * width, chunks)], compare);
+  }
+}
+}  // namespace
+
 Matrix<t_real> generate_antennas(const t_uint N, const t_real scale) {
   Matrix<t_real> B = Matrix<t_real>::Zero(N, 3);
   const t_real mean = 0;
@@ -134,10 +326,8 @@ utilities::vis_params random_sample_density(const t_int vis_num, const t_real me
 }
 
 utilities::vis_params read_visibility(const std::vector<std::string> &names, const bool w_term) {
-  utilities::vis_params output = read_visibility(names.at(0), w_term);
-  if (names.size() == 1) return output;
-  for (int i = 1; i < names.size(); i++) output = read_visibility(names.at(i), output);
-  return output;
+  if (names.size() == 0) throw std::runtime_error("No visibility files to read.");
+  return read_visibility_files(names, w_term);
 }
 utilities::vis_params read_visibility(const std::string &vis_name2,
                                       const utilities::vis_params &uv1) {
@@ -170,54 +360,36 @@ t_real streamtoreal(std::ifstream &stream) {
   return std::stod(input);
 }
 
-utilities::vis_params read_visibility(const std::string &vis_name, const bool w_term) {
-  /*
-    Reads an csv file with u, v, visibilities and returns the vectors.
-
-    vis_name:: name of input text file containing [u, v, real(V), imag(V)] (separated by ' ').
-  */
-  std::ifstream vis_file(vis_name);
-  vis_file.precision(13);
-  t_int row = 0;
-  std::string line;
-  // counts size of vis file
-  while (std::getline(vis_file, line)) ++row;
-  Vector<t_real> utemp = Vector<t_real>::Zero(row);
-  Vector<t_real> vtemp = Vector<t_real>::Zero(row);
-  Vector<t_real> wtemp = Vector<t_real>::Zero(row);
-  Vector<t_complex> vistemp = Vector<t_complex>::Zero(row);
-  Vector<t_complex> weightstemp = Vector<t_complex>::Zero(row);
-
-  vis_file.clear();
-  vis_file.seekg(0);
-  // reads in vis file
-  t_real real;
-  t_real imag;
-  t_real entry;
-  for (row = 0; row < vistemp.size(); ++row) {
-    utemp(row) = streamtoreal(vis_file);
-    vtemp(row) = streamtoreal(vis_file);
-    if (w_term) {
-      wtemp(row) = streamtoreal(vis_file);
-    }
-    real = streamtoreal(vis_file);
-    imag = streamtoreal(vis_file);
-    entry = streamtoreal(vis_file);
-    vistemp(row) = t_complex(real, imag);
-    weightstemp(row) = 1 / entry;
+std::shared_ptr<const char> map_file(const std::string &file_name, std::uint64_t &length) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Could not open " + file_name);
+  struct stat buf;
+  if (fstat(fd, &buf) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not read size of " + file_name);
   }
-  utilities::vis_params uv_vis;
-  uv_vis.u = utemp;
-  uv_vis.v = -vtemp;  // found that a reflection is needed for the orientation of the gridded image
-                      // to be correct
-  uv_vis.w = wtemp;
-  uv_vis.vis = vistemp;
-  uv_vis.weights = weightstemp;
-  uv_vis.ra = 0;
-  uv_vis.dec = 0;
-  uv_vis.average_frequency = 0;
+  length = buf.st_size;
+  if (length == 0) {
+    close(fd);
+    return std::shared_ptr<const char>();
+  }
+  void *const data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) throw std::runtime_error("Could not memory map " + file_name);
+  madvise(data, length, MADV_SEQUENTIAL);
+  const std::uint64_t mapped_length = length;
+  return std::shared_ptr<const char>(static_cast<const char *>(data),
+                                     [mapped_length](const char *ptr) {
+                                       munmap(const_cast<char *>(ptr), mapped_length);
+                                     });
+}
 
-  return uv_vis;
+utilities::vis_params read_visibility(const std::string &vis_name, const bool w_term) {
+  return read_visibility_files(std::vector<std::string>{vis_name}, w_term);
+}
+utilities::vis_params read_visibility(const std::string &vis_name, const bool w_term,
+                                      const std::uint64_t first, const std::uint64_t count) {
+  return read_visibility_files(std::vector<std::string>{vis_name}, w_term, first, count);
 }
 
 void write_visibility(const utilities::vis_params &uv_vis, const std::string &file_name,
@@ -329,6 +501,17 @@ utilities::vis_params convert_to_pixels(const utilities::vis_params &uv_vis, con
   return out;
 }
 
+utilities::vis_params convert_to_lambda(const utilities::vis_params &uv_vis, const t_real cell_x,
+                                        const t_real cell_y, const t_real imsizex,
+                                        const t_real imsizey, const t_real oversample_ratio) {
+  if (uv_vis.units == utilities::vis_units::lambda) return uv_vis;
+  auto out = convert_to_pixels(uv_vis, cell_x, cell_y, imsizex, imsizey, oversample_ratio);
+  out.u *= widefield::pixel_to_lambda(cell_x, imsizex, oversample_ratio);
+  out.v *= widefield::pixel_to_lambda(cell_y, imsizey, oversample_ratio);
+  out.units = utilities::vis_units::lambda;
+  return out;
+}
+
 utilities::vis_params conjugate_w(const utilities::vis_params &uv_vis) {
   utilities::vis_params output = uv_vis;
 #pragma omp parallel for
@@ -343,5 +526,252 @@ utilities::vis_params conjugate_w(const utilities::vis_params &uv_vis) {
   }
   return output;
 }
+
+utilities::vis_params merge_duplicates(const utilities::vis_params &uv_vis,
+                                       const t_real tolerance) {
+  if (tolerance < 0) throw std::runtime_error("Tolerance for merging visibilities is negative.");
+  // coordinates are binned into cells of size tolerance, or used directly when exact
+  typedef std::tuple<t_real, t_real, t_real> t_key;
+  std::vector<t_key> keys(uv_vis.size());
+#pragma omp parallel for
+  for (t_int i = 0; i < uv_vis.size(); i++)
+    keys[i] = (tolerance > 0) ? std::make_tuple(std::floor(uv_vis.u(i) / tolerance),
+                                                std::floor(uv_vis.v(i) / tolerance),
+                                                std::floor(uv_vis.w(i) / tolerance))
+                              : std::make_tuple(uv_vis.u(i), uv_vis.v(i), uv_vis.w(i));
+  std::vector<t_uint> order(uv_vis.size());
+  std::iota(order.begin(), order.end(), 0);
+  parallel_sort(order.begin(), order.end(),
+                [&keys](const t_uint a, const t_uint b) { return keys[a] < keys[b]; });
+  std::vector<t_key> sorted_keys(order.size());
+#pragma omp parallel for
+  for (t_int i = 0; i < order.size(); i++) sorted_keys[i] = keys[order[i]];
+  // a visibility that is not yet merged starts a group, and takes every visibility within
+  // tolerance of it, which can only be in its own or a neighbouring cell
+  const t_int reach = (tolerance > 0) ? 1 : 0;
+  std::vector<bool> merged(order.size(), false);
+  std::vector<t_uint> grouped;
+  std::vector<t_uint> starts;
+  grouped.reserve(order.size());
+  for (t_uint i = 0; i < order.size(); i++) {
+    if (merged[i]) continue;
+    const t_uint seed = order[i];
+    merged[i] = true;
+    starts.push_back(grouped.size());
+    grouped.push_back(seed);
+    for (t_int du = -reach; du <= reach; du++)
+      for (t_int dv = -reach; dv <= reach; dv++)
+        for (t_int dw = -reach; dw <= reach; dw++) {
+          const t_key cell = std::make_tuple(std::get<0>(sorted_keys[i]) + du,
+                                             std::get<1>(sorted_keys[i]) + dv,
+                                             std::get<2>(sorted_keys[i]) + dw);
+          const auto range = std::equal_range(sorted_keys.begin(), sorted_keys.end(), cell);
+          for (auto j = range.first - sorted_keys.begin(); j < range.second - sorted_keys.begin();
+               j++) {
+            if (merged[j]) continue;
+            const t_uint index = order[j];
+            const t_real distance_u = uv_vis.u(index) - uv_vis.u(seed);
+            const t_real distance_v = uv_vis.v(index) - uv_vis.v(seed);
+            const t_real distance_w = uv_vis.w(index) - uv_vis.w(seed);
+            if (distance_u * distance_u + distance_v * distance_v + distance_w * distance_w <=
+                tolerance * tolerance) {
+              merged[j] = true;
+              grouped.push_back(index);
+            }
+          }
+        }
+  }
+  starts.push_back(grouped.size());
+  order = std::move(grouped);
+  const t_uint unique = starts.size() - 1;
+  const bool has_time = (uv_vis.time.size() == uv_vis.size());
+  const bool has_baseline = (uv_vis.baseline.size() == uv_vis.size());
+
+  utilities::vis_params output = uv_vis;
+  output.u = Vector<t_real>::Zero(unique);
+  output.v = Vector<t_real>::Zero(unique);
+  output.w = Vector<t_real>::Zero(unique);
+  output.vis = Vector<t_complex>::Zero(unique);
+  output.weights = Vector<t_complex>::Zero(unique);
+  if (has_time) output.time = Vector<t_real>::Zero(unique);
+  if (has_baseline) output.baseline = Vector<t_uint>::Zero(unique);
+#pragma omp parallel for
+  for (t_int k = 0; k < unique; k++) {
+    const t_uint first = order[starts[k]];
+    if (has_time) output.time(k) = uv_vis.time(first);
+    if (has_baseline) output.baseline(k) = uv_vis.baseline(first);
+    // inverse variance weighting keeps the chi squared unchanged up to a constant
+    t_real weight_sum = 0;
+    t_complex vis_sum = 0;
+    t_real u_sum = 0;
+    t_real v_sum = 0;
+    t_real w_sum = 0;
+    for (t_uint j = starts[k]; j < starts[k + 1]; j++) {
+      const t_uint index = order[j];
+      const t_real weight_squared = std::norm(uv_vis.weights(index));
+      weight_sum += weight_squared;
+      vis_sum += weight_squared * uv_vis.vis(index);
+      u_sum += weight_squared * uv_vis.u(index);
+      v_sum += weight_squared * uv_vis.v(index);
+      w_sum += weight_squared * uv_vis.w(index);
+    }
+    if (weight_sum > 0 and starts[k + 1] - starts[k] > 1) {
+      output.u(k) = u_sum / weight_sum;
+      output.v(k) = v_sum / weight_sum;
+      output.w(k) = w_sum / weight_sum;
+      output.vis(k) = vis_sum / weight_sum;
+      output.weights(k) = std::sqrt(weight_sum);
+    } else {
+      output.u(k) = uv_vis.u(first);
+      output.v(k) = uv_vis.v(first);
+      output.w(k) = uv_vis.w(first);
+      output.vis(k) = uv_vis.vis(first);
+      output.weights(k) = uv_vis.weights(first);
+    }
+  }
+  PURIFY_MEDIUM_LOG("Merged {} visibilities into {} unique samples (compression ratio {}).",
+                    uv_vis.size(), unique,
+                    (unique > 0) ? static_cast<t_real>(uv_vis.size()) / unique : 1.);
+  return output;
+}
+
+utilities::vis_params baseline_dependent_averaging(const utilities::vis_params &uv_vis,
+                                                   const t_real cell_x, const t_real cell_y,
+                                                   const t_uint imsizex, const t_uint imsizey,
+                                                   const t_real max_shift) {
+  if (uv_vis.time.size() != uv_vis.size() or uv_vis.baseline.size() != uv_vis.size()) {
+    PURIFY_MEDIUM_LOG("No time or baseline information, skipping baseline dependent averaging.");
+    return uv_vis;
+  }
+  if (uv_vis.units != utilities::vis_units::lambda)
+    throw std::runtime_error("Baseline dependent averaging requires uvw in units of lambda.");
+  if (max_shift <= 0)
+    throw std::runtime_error("Maximum uv shift for baseline dependent averaging is not positive.");
+  const t_real du = max_shift * widefield::pixel_to_lambda(cell_x, imsizex, 1.);
+  const t_real dv = max_shift * widefield::pixel_to_lambda(cell_y, imsizey, 1.);
+  const t_real dw = std::min(du, dv);
+  // |uvw| is fixed for a baseline and channel, so it separates channels of the same baseline
+  const Vector<t_real> radius =
+      (uv_vis.u.array().square() + uv_vis.v.array().square() + uv_vis.w.array().square()).sqrt();
+  typedef std::tuple<t_uint, t_real, t_real> t_key;
+  std::vector<t_key> keys(uv_vis.size());
+#pragma omp parallel for
+  for (t_int i = 0; i < uv_vis.size(); i++)
+    keys[i] = std::make_tuple(uv_vis.baseline(i), std::floor(radius(i) / dw), uv_vis.time(i));
+  std::vector<t_uint> order(uv_vis.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&keys](const t_uint a, const t_uint b) { return keys[a] < keys[b]; });
+  // tracks of each baseline and channel are averaged independently
+  std::vector<t_uint> tracks;
+  for (t_uint i = 0; i < order.size(); i++)
+    if (i == 0 or std::get<0>(keys[order[i]]) != std::get<0>(keys[order[i - 1]]) or
+        std::get<1>(keys[order[i]]) != std::get<1>(keys[order[i - 1]]))
+      tracks.push_back(i);
+  tracks.push_back(order.size());
+  const t_int number_of_tracks = tracks.size() - 1;
+
+  // group[i] is the averaged sample that order[i] contributes to
+  std::vector<t_uint> group(order.size(), 0);
+  std::vector<t_uint> track_groups(number_of_tracks, 0);
+#pragma omp parallel for schedule(dynamic)
+  for (t_int t = 0; t < number_of_tracks; t++) {
+    t_uint start = order[tracks[t]];
+    t_uint count = 0;
+    for (t_uint i = tracks[t]; i < tracks[t + 1]; i++) {
+      const t_uint index = order[i];
+      if (std::abs(uv_vis.u(index) - uv_vis.u(start)) > du or
+          std::abs(uv_vis.v(index) - uv_vis.v(start)) > dv or
+          std::abs(uv_vis.w(index) - uv_vis.w(start)) > dw) {
+        start = index;
+        count++;
+      }
+      group[i] = count;
+    }
+    track_groups[t] = count + 1;
+  }
+  std::vector<t_uint> track_offsets(number_of_tracks + 1, 0);
+  std::partial_sum(track_groups.begin(), track_groups.end(), track_offsets.begin() + 1);
+  const t_uint averaged_size = track_offsets.back();
+
+  utilities::vis_params output = uv_vis;
+  output.u = Vector<t_real>::Zero(averaged_size);
+  output.v = Vector<t_real>::Zero(averaged_size);
+  output.w = Vector<t_real>::Zero(averaged_size);
+  output.time = Vector<t_real>::Zero(averaged_size);
+  output.baseline = Vector<t_uint>::Zero(averaged_size);
+  output.vis = Vector<t_complex>::Zero(averaged_size);
+  output.weights = Vector<t_complex>::Zero(averaged_size);
+  Vector<t_real> weight_sum = Vector<t_real>::Zero(averaged_size);
+  Vector<t_real> counts = Vector<t_real>::Zero(averaged_size);
+#pragma omp parallel for schedule(dynamic)
+  for (t_int t = 0; t < number_of_tracks; t++) {
+    for (t_uint i = tracks[t]; i < tracks[t + 1]; i++) {
+      const t_uint index = order[i];
+      const t_uint k = track_offsets[t] + group[i];
+      // samples are averaged along the track with inverse variance weights, as when merging
+      // duplicates, and with equal weights when all weights of a sample are zero
+      const t_real weight_squared = std::norm(uv_vis.weights(index));
+      weight_sum(k) += weight_squared;
+      counts(k) += 1;
+      output.u(k) += weight_squared * uv_vis.u(index);
+      output.v(k) += weight_squared * uv_vis.v(index);
+      output.w(k) += weight_squared * uv_vis.w(index);
+      output.time(k) += uv_vis.time(index);
+      output.vis(k) += weight_squared * uv_vis.vis(index);
+      output.baseline(k) = uv_vis.baseline(index);
+    }
+    for (t_uint k = track_offsets[t]; k < track_offsets[t + 1]; k++) {
+      output.time(k) /= counts(k);
+      if (weight_sum(k) > 0) {
+        output.u(k) /= weight_sum(k);
+        output.v(k) /= weight_sum(k);
+        output.w(k) /= weight_sum(k);
+        output.vis(k) /= weight_sum(k);
+        output.weights(k) = std::sqrt(weight_sum(k));
+      }
+    }
+  }
+  // tracks with zero weights only are averaged with equal weights
+#pragma omp parallel for schedule(dynamic)
+  for (t_int t = 0; t < number_of_tracks; t++) {
+    for (t_uint i = tracks[t]; i < tracks[t + 1]; i++) {
+      const t_uint k = track_offsets[t] + group[i];
+      if (weight_sum(k) > 0) continue;
+      const t_uint index = order[i];
+      output.u(k) += uv_vis.u(index) / counts(k);
+      output.v(k) += uv_vis.v(index) / counts(k);
+      output.w(k) += uv_vis.w(index) / counts(k);
+      output.vis(k) += uv_vis.vis(index) / counts(k);
+    }
+  }
+  PURIFY_MEDIUM_LOG("Baseline dependent averaging reduced {} visibilities to {} (factor of {}).",
+                    uv_vis.size(), averaged_size,
+                    (averaged_size > 0) ? static_cast<t_real>(uv_vis.size()) / averaged_size
+                                        : 1.);
+  return output;
+}
+
+utilities::vis_params fold_hermitian(const utilities::vis_params &uv_vis, const bool positive_w) {
+  utilities::vis_params folded = uv_vis;
+#pragma omp parallel for
+  for (t_int i = 0; i < folded.size(); i++) {
+    // the sign of w decides first when w >= 0 is kept, so that the fold only acts on the uv
+    // plane where w = 0
+    const bool reflect = (positive_w and uv_vis.w(i) != 0)
+                             ? uv_vis.w(i) < 0
+                             : (uv_vis.v(i) < 0 or (uv_vis.v(i) == 0 and uv_vis.u(i) < 0));
+    if (reflect) {
+      folded.u(i) = -uv_vis.u(i);
+      folded.v(i) = -uv_vis.v(i);
+      folded.w(i) = -uv_vis.w(i);
+      folded.vis(i) = std::conj(uv_vis.vis(i));
+    }
+  }
+  const utilities::vis_params output = merge_duplicates(folded);
+  PURIFY_MEDIUM_LOG("Folded {} visibilities into {} on the Hermitian half plane.", uv_vis.size(),
+                    output.size());
+  return output;
+}
 }  // namespace utilities
 }  // namespace purify
@@ -3,7 +3,9 @@
 
 #include "purify/config.h"
 #include "purify/types.h"
+#include <cstdint>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <type_traits>
 
@@ -189,9 +191,20 @@ utilities::vis_params read_ant_positions_to_coverage(const std::string &pos_name
 }
 //! Reading reals from visibility file (including nan's and inf's)
 t_real streamtoreal(std::ifstream &stream);
+//! Read only memory map of a whole file, which is unmapped when the last copy is destroyed
+//! \details An empty file gives a null pointer and length zero.
+std::shared_ptr<const char> map_file(const std::string &file_name, std::uint64_t &length);
 //! Reads in visibility file
+//! \details The file is memory mapped and split into chunks at line ends that are parsed in
+//! parallel. Each line is u, v, (w,) real(V), imag(V) and the standard deviation, and blank
+//! lines are skipped.
 utilities::vis_params read_visibility(const std::string &vis_name, const bool w_term = false);
+//! Reads the lines of a visibility file that start in the bytes [first, first + count)
+//! \details Reading consecutive byte ranges reads every line of the file exactly once.
+utilities::vis_params read_visibility(const std::string &vis_name, const bool w_term,
+                                      const std::uint64_t first, const std::uint64_t count);
 //! Read visibility files from name of vector
+//! \details The output is allocated once, and the chunks of all files are parsed in parallel.
 utilities::vis_params read_visibility(const std::vector<std::string> &names,
                                       const bool w_term = false);
 //! Reads in two visibility files
@@ -210,11 +223,30 @@ utilities::vis_params set_cell_size(const utilities::vis_params &uv_vis, const t
 utilities::vis_params convert_to_pixels(const utilities::vis_params &uv_vis, const t_real cell_x,
                                         const t_real cell_y, const t_real imsizex,
                                         const t_real imsizey, const t_real oversample_ratio);
+//! Converts u and v coordinates to units of lambda, the inverse of convert_to_pixels
+utilities::vis_params convert_to_lambda(const utilities::vis_params &uv_vis, const t_real cell_x,
+                                        const t_real cell_y, const t_real imsizex,
+                                        const t_real imsizey, const t_real oversample_ratio);
 //! scales the visibilities to units of pixels
 utilities::vis_params uv_scale(const utilities::vis_params &uv_vis, const t_int &ftsizeu,
                                const t_int &ftsizev);
 //! reflects visibilities into the w >= 0 domain
 utilities::vis_params conjugate_w(const utilities::vis_params &uv_vis);
+//! combines visibilities with equal (u, v, w) (within tolerance) using inverse variance weights
+utilities::vis_params merge_duplicates(const utilities::vis_params &uv_vis,
+                                       const t_real tolerance = 0);
+//! averages consecutive samples of each baseline while the (u, v, w) track moves less than
+//! max_shift of a uv cell (1 / field of view), requires time and baseline in units of lambda
+utilities::vis_params baseline_dependent_averaging(const utilities::vis_params &uv_vis,
+                                                   const t_real cell_x, const t_real cell_y,
+                                                   const t_uint imsizex, const t_uint imsizey,
+                                                   const t_real max_shift = 0.1);
+//! reflects visibilities into the half plane v > 0 (or v = 0, u >= 0) and combines conjugate
+//! duplicates, only valid for real valued images
+//! \details With positive_w, visibilities with w != 0 are reflected into w > 0 as conjugate_w
+//! does, and only those with w = 0 are folded onto the half plane.
+utilities::vis_params fold_hermitian(const utilities::vis_params &uv_vis,
+                                     const bool positive_w = false);
 }  // namespace utilities
 }  // namespace purify
 
@@ -4,8 +4,11 @@
 #include "purify/config.h"
 
 #include "purify/types.h"
+#include "purify/load_balancing.h"
 #include "purify/logging.h"
 
+#include <algorithm>
+#include <numeric>
 #include <vector>
 #include <sopt/wavelets.h>
 #include <sopt/wavelets/sara.h>
@@ -13,9 +16,70 @@
 #include <sopt/mpi/communicator.h>
 #include <sopt/mpi/session.h>
 #endif
+#ifdef PURIFY_OPENMP
+#include <omp.h>
+#endif
 namespace purify {
+namespace operators {
+//! Constructs the SARA operator with the wavelet bases applied concurrently by OpenMP threads
+//! \details Same result as the serial SARA operator. Each basis is its own transform, the most
+//! expensive bases are started first and threads pick up the next basis when they finish.
+//! The images of the bases are summed in the order of the bases in the adjoint of the analysis.
+template <class T>
+std::shared_ptr<sopt::LinearTransform<T>> init_sara_openmp(
+    const std::vector<std::tuple<std::string, t_uint>>& wavelets, const t_uint imsizey,
+    const t_uint imsizex) {
+  typedef typename T::Scalar Scalar;
+  const t_int bases = wavelets.size();
+  const t_int N = imsizey * imsizex;
+  std::vector<std::shared_ptr<const sopt::LinearTransform<Vector<Scalar>>>> psi;
+  std::vector<t_real> costs;
+  for (auto const& wavelet : wavelets) {
+    const std::vector<std::tuple<std::string, t_uint>> basis = {wavelet};
+    psi.push_back(std::make_shared<const sopt::LinearTransform<Vector<Scalar>>>(
+        sopt::linear_transform<Scalar>(sopt::wavelets::SARA(basis.begin(), basis.end()),
+                                       imsizey, imsizex)));
+    costs.push_back(
+        load_balancing::wavelet_cost(std::get<0>(wavelet), std::get<1>(wavelet), imsizey, imsizex));
+  }
+  std::vector<t_int> order(bases);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](t_int a, t_int b) { return costs[a] > costs[b]; });
+  const t_real normalisation = 1. / std::sqrt(static_cast<t_real>(std::max(bases, 1)));
+  // coefficients of each basis are a contiguous block of N values
+  auto direct = [=](T& output, const T& coefficients) {
+    assert(coefficients.size() == bases * N);
+    std::vector<Vector<Scalar>> images(bases);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (t_int i = 0; i < bases; i++) {
+      const t_int b = order[i];
+      const Vector<Scalar> block = coefficients.segment(b * N, N);
+      images[b] = *psi[b] * block;
+    }
+    output = T::Zero(N);
+    for (t_int b = 0; b < bases; b++) output += images[b];
+    output *= normalisation;
+  };
+  auto indirect = [=](T& output, const T& image) {
+    assert(image.size() == N);
+    output = T::Zero(bases * N);
+    const Vector<Scalar> input = image;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (t_int i = 0; i < bases; i++) {
+      const t_int b = order[i];
+      const Vector<Scalar> block = psi[b]->adjoint() * input;
+      output.segment(b * N, N) = block * normalisation;
+    }
+  };
+  return std::make_shared<sopt::LinearTransform<T>>(direct, std::array<t_int, 3>{0, 1, N},
+                                                    indirect,
+                                                    std::array<t_int, 3>{0, 1, bases * N});
+}
+}  // namespace operators
+
 namespace factory {
-enum class distributed_wavelet_operator { serial, mpi_sara };
+enum class distributed_wavelet_operator { serial, mpi_sara, openmp_sara };
 //! construct sara wavelet operator
 template <class T>
 std::shared_ptr<sopt::LinearTransform<T> const> wavelet_operator_factory(
@@ -36,11 +100,26 @@ std::shared_ptr<sopt::LinearTransform<T> const> wavelet_operator_factory(
     return std::make_shared<sopt::LinearTransform<T>>(
         sopt::linear_transform<typename T::Scalar>(sara, imsizey, imsizex));
   }
+  case (distributed_wavelet_operator::openmp_sara): {
+#ifdef PURIFY_OPENMP
+    PURIFY_LOW_LOG("Using wavelet operator with {} bases over {} OpenMP threads.", sara.size(),
+                   omp_get_max_threads());
+#else
+    PURIFY_LOW_LOG("Using wavelet operator without OpenMP, the bases are applied in turn.");
+#endif
+    sara_size = sara.size();
+    if (sara.size() == 0)
+      return wavelet_operator_factory<T>(distributed_wavelet_operator::serial, wavelets, imsizey,
+                                         imsizex, sara_size);
+    return operators::init_sara_openmp<T>(wavelets, imsizey, imsizex);
+  }
 #ifdef PURIFY_MPI
   case (distributed_wavelet_operator::mpi_sara): {
     auto const comm = sopt::mpi::Communicator::World();
     PURIFY_LOW_LOG("Using distributed image MPI wavelet operator.");
-    const auto dsara = sopt::wavelets::distribute_sara(sara, comm);
+    const auto local_wavelets =
+        load_balancing::distribute_wavelets(wavelets, imsizey, imsizex, comm);
+    const auto dsara = sopt::wavelets::SARA(local_wavelets.begin(), local_wavelets.end());
     sara_size = dsara.size();
     return std::make_shared<sopt::LinearTransform<T>>(
         sopt::linear_transform<typename T::Scalar>(dsara, imsizey, imsizex, comm));
@@ -36,6 +36,19 @@ Matrix<t_complex> generate_chirp(const t_real w_rate, const t_real cell_x, const
   return generate_chirp([](t_real, t_real) { return 1.; }, w_rate, cell_x, cell_y, x_size, y_size);
 }
 
+Matrix<t_complex> generate_chirp_rows(const t_real w_rate, const t_real cell_x,
+                                      const t_real cell_y, const t_uint x_size,
+                                      const t_uint y_size, const t_uint row_start,
+                                      const t_uint rows) {
+  const t_real nz = y_size * x_size;
+  const t_complex I(0, 1);
+  const auto chirp = [=](const t_real y, const t_real x) {
+    return (std::exp(-2 * constant::pi * I * w_rate * (std::sqrt(1 - x * x - y * y) - 1))) /
+           std::sqrt(1 - x * x - y * y) / nz;
+  };
+  return generate_dde(chirp, cell_x, cell_y, x_size, y_size, 0.1, row_start, rows);
+}
+
 Matrix<t_complex> estimate_sample_density(const Vector<t_real> &u, const Vector<t_real> &v,
                                           const t_real cellx, const t_real celly,
                                           const t_uint imsizex, const t_uint imsizey,
@@ -41,24 +41,32 @@ t_real fov_cosine(t_real const cell, t_uint const imsize);
 //! Generate image of DDE for aw-stacking
 template <class DDE>
 Matrix<t_complex> generate_dde(const DDE &dde, const t_real cell_x, const t_real cell_y,
-                               const t_uint x_size, const t_uint y_size, const t_real stop_gap) {
+                               const t_uint x_size, const t_uint y_size, const t_real stop_gap,
+                               const t_uint row_start, const t_uint rows) {
   assert(stop_gap <= 1);
+  assert(row_start + rows <= y_size);
   const t_real L = fov_cosine(cell_x, x_size);
   const t_real M = fov_cosine(cell_y, y_size);
 
   const t_real delt_x = L / x_size;
   const t_real delt_y = M / y_size;
-  Image<t_complex> output = Image<t_complex>::Zero(y_size, x_size);
+  Image<t_complex> output = Image<t_complex>::Zero(rows, x_size);
 
   for (t_int l = 0; l < x_size; ++l)
-    for (t_int m = 0; m < y_size; ++m) {
+    for (t_int m = 0; m < rows; ++m) {
       const t_real x = (l - x_size * 0.5) * delt_x;
-      const t_real y = (m - y_size * 0.5) * delt_y;
+      const t_real y = (static_cast<t_real>(row_start + m) - y_size * 0.5) * delt_y;
       output(m, l) = ((x * x + y * y) < 1 - stop_gap) ? dde(y, x) : 0.;
     }
 
   return output;
 };
+//! Generate image of DDE for aw-stacking
+template <class DDE>
+Matrix<t_complex> generate_dde(const DDE &dde, const t_real cell_x, const t_real cell_y,
+                               const t_uint x_size, const t_uint y_size, const t_real stop_gap) {
+  return generate_dde(dde, cell_x, cell_y, x_size, y_size, stop_gap, 0, y_size);
+};
 //! generates image of chirp and DDE
 template <class DDE>
 Matrix<t_complex> generate_chirp(const DDE &dde, const t_real w_rate, const t_real cell_x,
@@ -76,6 +84,11 @@ Matrix<t_complex> generate_chirp(const DDE &dde, const t_real w_rate, const t_re
 //! Generates image of chirp
 Matrix<t_complex> generate_chirp(const t_real w_rate, const t_real cell_x, const t_real cell_y,
                                  const t_uint x_size, const t_uint y_size);
+//! Generates rows [row_start, row_start + rows) of the image of chirp
+Matrix<t_complex> generate_chirp_rows(const t_real w_rate, const t_real cell_x,
+                                      const t_real cell_y, const t_uint x_size,
+                                      const t_uint y_size, const t_uint row_start,
+                                      const t_uint rows);
 }  // namespace widefield
 }  // namespace purify
 #endif
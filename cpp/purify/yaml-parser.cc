@@ -13,6 +13,7 @@
 #include <typeinfo>
 #include <boost/filesystem.hpp>
 #include <yaml-cpp/yaml.h>
+#include "purify/distribute.h"
 #include "purify/read_measurements.h"
 
 namespace purify {
@@ -186,8 +187,44 @@ void YamlParser::parseAndSetMeasureOperators(const YAML::Node& measureOperatorsN
   this->wprojection_ = get<bool>(measureOperatorsNode, {"wide-field", "wprojection"});
   this->mpi_wstacking_ = get<bool>(measureOperatorsNode, {"wide-field", "mpi_wstacking"});
   this->mpi_all_to_all_ = get<bool>(measureOperatorsNode, {"wide-field", "mpi_all_to_all"});
+  if (measureOperatorsNode["mpi_grid_slabs"])
+    this->mpi_grid_slabs_ = get<bool>(measureOperatorsNode, {"mpi_grid_slabs"});
+  if (measureOperatorsNode["mpi_shared_memory"])
+    this->mpi_shared_memory_ = get<bool>(measureOperatorsNode, {"mpi_shared_memory"});
+  if (measureOperatorsNode["mpi_node_reduction"])
+    this->mpi_node_reduction_ = get<bool>(measureOperatorsNode, {"mpi_node_reduction"});
+  if (measureOperatorsNode["mpi_distribution_plan"])
+    this->mpi_distribution_plan_ =
+        get<std::string>(measureOperatorsNode, {"mpi_distribution_plan"});
+  if (distribute::plan_from_string.count(this->mpi_distribution_plan_) == 0)
+    throw std::runtime_error("Distribution plan \"" + this->mpi_distribution_plan_ +
+                             "\" not recognised. Check your config file.");
+  if (measureOperatorsNode["mpi_grid_footprint"])
+    this->mpi_grid_footprint_ = get<bool>(measureOperatorsNode, {"mpi_grid_footprint"});
+  if (measureOperatorsNode["mpi_load_balancing"]) {
+    this->load_balancing_iterations_ =
+        get<t_int>(measureOperatorsNode, {"mpi_load_balancing", "iterations"});
+    this->load_balancing_budget_ =
+        get<t_real>(measureOperatorsNode, {"mpi_load_balancing", "migration_budget"});
+  }
+  if (measureOperatorsNode["wide-field"]["mpi_all_to_all_pipelined"])
+    this->mpi_all_to_all_pipelined_ =
+        get<bool>(measureOperatorsNode, {"wide-field", "mpi_all_to_all_pipelined"});
   this->kmeans_iters_ = get<t_int>(measureOperatorsNode, {"wide-field", "kmeans_iterations"});
+  if (measureOperatorsNode["wide-field"]["kmeans_optimal"])
+    this->kmeans_optimal_ = get<bool>(measureOperatorsNode, {"wide-field", "kmeans_optimal"});
   this->conjugate_w_ = get<bool>(measureOperatorsNode, {"wide-field", "conjugate_w"});
+  if (measureOperatorsNode["hermitian_fold"])
+    this->hermitian_fold_ = get<bool>(measureOperatorsNode, {"hermitian_fold"});
+  if (measureOperatorsNode["duplicates"]) {
+    this->merge_duplicates_ = get<bool>(measureOperatorsNode, {"duplicates", "merge"});
+    this->merge_tolerance_ = get<t_real>(measureOperatorsNode, {"duplicates", "tolerance"});
+  }
+  if (measureOperatorsNode["baseline_averaging"]) {
+    this->baseline_averaging_ = get<bool>(measureOperatorsNode, {"baseline_averaging", "apply"});
+    this->baseline_averaging_shift_ =
+        get<t_real>(measureOperatorsNode, {"baseline_averaging", "max_uv_shift"});
+  }
 }
 
 void YamlParser::parseAndSetSARA(const YAML::Node& SARANode) {
@@ -196,6 +233,8 @@ void YamlParser::parseAndSetSARA(const YAML::Node& SARANode) {
   this->wavelet_levels_ = get<t_int>(SARANode, {"wavelet_levels"});
   this->realValueConstraint_ = get<bool>(SARANode, {"realValueConstraint"});
   this->positiveValueConstraint_ = get<bool>(SARANode, {"positiveValueConstraint"});
+  if (SARANode["openmp_wavelets"])
+    this->openmp_wavelets_ = get<bool>(SARANode, {"openmp_wavelets"});
 }
 
 void YamlParser::parseAndSetAlgorithmOptions(const YAML::Node& algorithmOptionsNode) {
@@ -222,6 +261,8 @@ void YamlParser::parseAndSetAlgorithmOptions(const YAML::Node& algorithmOptionsN
         get<t_real>(algorithmOptionsNode, {"fb", "regularisation_parameter"});
     this->dualFBVarianceConvergence_ =
         get<t_real>(algorithmOptionsNode, {"fb", "dualFBVarianceConvergence"});
+    if (algorithmOptionsNode["fb"]["psf_normal_operator"])
+      this->psf_normal_operator_ = get<bool>(algorithmOptionsNode, {"fb", "psf_normal_operator"});
     if (this->algorithm_ == "fb_joint_map") {
       this->jmap_iters_ =
           get<t_uint>(algorithmOptionsNode, {"fb", "joint_map_estimation", "iters"});
@@ -112,10 +112,24 @@ class YamlParser {
   YAML_MACRO(bool, wprojection, false)
   YAML_MACRO(bool, mpi_wstacking, true)
   YAML_MACRO(bool, mpi_all_to_all, true)
+  YAML_MACRO(bool, mpi_all_to_all_pipelined, false)
+  YAML_MACRO(bool, mpi_grid_slabs, false)
+  YAML_MACRO(bool, mpi_shared_memory, false)
+  YAML_MACRO(bool, mpi_node_reduction, false)
+  YAML_MACRO(std::string, mpi_distribution_plan, "radial")
+  YAML_MACRO(bool, mpi_grid_footprint, false)
+  YAML_MACRO(t_int, load_balancing_iterations, 0)
+  YAML_MACRO(t_real, load_balancing_budget, 0.1)
   YAML_MACRO(bool, conjugate_w, true)
+  YAML_MACRO(bool, hermitian_fold, false)
+  YAML_MACRO(bool, merge_duplicates, false)
+  YAML_MACRO(t_real, merge_tolerance, 0)
+  YAML_MACRO(bool, baseline_averaging, false)
+  YAML_MACRO(t_real, baseline_averaging_shift, 0.1)
   YAML_MACRO(bool, gpu, false)
   YAML_MACRO(t_int, precondition_iters, 0)
   YAML_MACRO(t_int, kmeans_iters, 10)
+  YAML_MACRO(bool, kmeans_optimal, false)
   YAML_MACRO(t_real, measurements_sigma, 1)
   YAML_MACRO(t_real, signal_to_noise, 30)
   YAML_MACRO(t_int, number_of_measurements, 1e5)
@@ -124,6 +138,7 @@ class YamlParser {
   YAML_MACRO(t_real, dualFBVarianceConvergence, 0)
   YAML_MACRO(t_real, epsilonConvergenceScaling, 0)
   YAML_MACRO(std::vector<std::string>, wavelet_basis, {})
+  YAML_MACRO(bool, openmp_wavelets, false)
   YAML_MACRO(t_int, update_iters, 0)
   YAML_MACRO(t_real, update_tolerance, 0)
   YAML_MACRO(std::string, output_prefix, "")
@@ -134,6 +149,7 @@ class YamlParser {
   YAML_MACRO(std::string, kernel, "")
   YAML_MACRO(t_real, regularisation_parameter, 0)
   YAML_MACRO(t_real, stepsize, 1)
+  YAML_MACRO(bool, psf_normal_operator, false)
   YAML_MACRO(t_uint, jmap_iters, 100)
   YAML_MACRO(t_real, jmap_relVarianceConvergence, 0)
   YAML_MACRO(t_real, jmap_objVarianceConvergence, 0)
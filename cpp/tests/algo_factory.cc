@@ -11,6 +11,7 @@
 
 #include "purify/algorithm_factory.h"
 #include "purify/measurement_operator_factory.h"
+#include "purify/psf_operator.h"
 #include "purify/wavelet_operator_factory.h"
 #include <sopt/power_method.h>
 
@@ -186,6 +187,61 @@ TEST_CASE("fb_factory") {
   CHECK(residual_image.real().isApprox(residual.real(), 1e-4));
 }
 
+TEST_CASE("fb_factory psf normal operator") {
+  const std::string &test_dir = "expected/fb/";
+  const std::string &input_data_path = notinstalled::data_filename(test_dir + "input_data.vis");
+  auto uv_data = utilities::read_visibility(input_data_path, false);
+  uv_data.units = utilities::vis_units::radians;
+  REQUIRE(uv_data.size() == 13107);
+
+  t_uint const imsizey = 128;
+  t_uint const imsizex = 128;
+
+  Vector<t_complex> const init = Vector<t_complex>::Ones(imsizex * imsizey);
+  auto const measurements_transform = factory::measurement_operator_factory<Vector<t_complex>>(
+      factory::distributed_measurement_operator::serial, uv_data, imsizey, imsizex, 1, 1, 2,
+      kernels::kernel_from_string.at("kb"), 4, 4);
+  const t_real op_norm = std::get<0>(
+      sopt::algorithm::power_method<Vector<t_complex>>(*measurements_transform, 1000, 1e-5, init));
+  // Φ†Φ as a convolution with the PSF, the measurements become the dirty image
+  auto const normal_operator = measurementoperator::init_psf_normal_operator_2d<Vector<t_complex>>(
+      uv_data, imsizey, imsizex, 1, 1, 2, kernels::kernel_from_string.at("kb"), 4, 4);
+  auto const gradient_operator =
+      measurementoperator::init_psf_gradient_operator_2d<Vector<t_complex>>(normal_operator,
+                                                                            imsizey, imsizex);
+  const t_real psf_op_norm = std::sqrt(std::get<0>(
+      sopt::algorithm::power_method<Vector<t_complex>>(*normal_operator, 1000, 1e-5, init)));
+  CHECK(psf_op_norm == Approx(op_norm).epsilon(1e-2));
+  utilities::vis_params dirty_data = uv_data;
+  dirty_data.vis = measurements_transform->adjoint() * uv_data.vis;
+
+  std::vector<std::tuple<std::string, t_uint>> const sara{std::make_tuple("Dirac", 3u),
+                                                          std::make_tuple("DB4", 3u)};
+  auto const wavelets = factory::wavelet_operator_factory<Vector<t_complex>>(
+      factory::distributed_wavelet_operator::serial, sara, imsizey, imsizex);
+  t_real const sigma = 0.016820222945913496 * std::sqrt(2);  // see test_parameters file
+  t_real const beta = sigma * sigma;
+  t_real const gamma = 0.0001;
+  auto const fb = factory::fb_factory<sopt::algorithm::ImagingForwardBackward<t_complex>>(
+      factory::algo_distribution::serial, measurements_transform, wavelets, uv_data, sigma, beta,
+      gamma, imsizey, imsizex, sara.size(), 1000, true, true, false, 1e-4, 1e-3, 50, op_norm);
+  auto const psf_fb = factory::fb_factory<sopt::algorithm::ImagingForwardBackward<t_complex>>(
+      factory::algo_distribution::serial, gradient_operator, wavelets, dirty_data, sigma, beta,
+      gamma, imsizey, imsizex, sara.size(), 1000, true, true, false, 1e-4, 1e-3, 50, psf_op_norm);
+
+  auto const diagnostic = (*fb)();
+  auto const psf_diagnostic = (*psf_fb)();
+  // both minimise the same objective, so they reach the same fixed point
+  CAPTURE(diagnostic.niters);
+  CAPTURE(psf_diagnostic.niters);
+  CHECK(psf_diagnostic.x.isApprox(diagnostic.x, 1e-2));
+  // the visibility residual of the PSF solution is as small as the standard one
+  const t_real residual_norm = (*measurements_transform * diagnostic.x - uv_data.vis).norm();
+  const t_real psf_residual_norm =
+      (*measurements_transform * psf_diagnostic.x - uv_data.vis).norm();
+  CHECK(psf_residual_norm == Approx(residual_norm).epsilon(1e-2));
+}
+
 TEST_CASE("joint_map_factory") {
   const std::string &test_dir = "expected/joint_map/";
   const std::string &input_data_path = notinstalled::data_filename(test_dir + "input_data.vis");
@@ -189,3 +189,23 @@ TEST_CASE("Direction") {
   CHECK(std::abs(direction[0] - 0.934273294000000031900299291010014712810516357421875) < 1e-8);
   CHECK(std::abs(direction[1] + 0.68069387400000003207622967238421551883220672607421875) < 1e-8);
 }
+
+TEST_CASE("Row range") {
+  auto const ms = purify::casa::MeasurementSet(test_file);
+  auto const rows = purify::casa::measurementset_rows(test_file);
+  CHECK(ms.row_range(0, rows / 2).table().nrow() == rows / 2);
+  CHECK(ms.row_range(rows / 2, rows).table().nrow() == rows - rows / 2);
+  CHECK(ms.row_range(0, 0).table().nrow() == 0);
+  auto const all = purify::casa::read_measurementset(test_file);
+  auto const first = purify::casa::read_measurementset(test_file, purify::stokes::I, 0, rows / 2);
+  auto const second = purify::casa::read_measurementset(test_file, purify::stokes::I, rows / 2,
+                                                        rows - rows / 2);
+  CHECK(first.size() + second.size() == all.size());
+  CHECK(std::abs(first.vis.sum() + second.vis.sum() - all.vis.sum()) <
+        1e-8 * all.vis.cwiseAbs().sum());
+  CHECK(std::abs(first.ra - all.ra) < 1e-8);
+  auto const none = purify::casa::read_measurementset(test_file, purify::stokes::I, rows, 0);
+  CHECK(none.size() == 0);
+  CHECK(std::abs(none.ra - all.ra) < 1e-8);
+  CHECK(none.average_frequency == Approx(all.average_frequency));
+}
@@ -1,5 +1,6 @@
 #include "purify/distribute.h"
 #include "purify/types.h"
+#include <numeric>
 #include "catch.hpp"
 #include "purify/directories.h"
 #include "purify/utilities.h"
@@ -53,3 +54,61 @@ TEST_CASE("Distribute") {
     CHECK(groups_distance[i] < number_of_groups);
   }
 }
+TEST_CASE("Bisection") {
+  auto const uv_data = utilities::read_visibility(vla_filename("at166B.3C129.c0.vis"));
+  t_int const number_of_groups = 6;
+  t_int const number_of_vis = uv_data.u.size();
+  std::vector<t_int> const groups = distribute::distribute_measurements(
+      uv_data.u, uv_data.v, uv_data.w, number_of_groups, distribute::plan::bisection);
+  REQUIRE(groups.size() == number_of_vis);
+  std::vector<t_int> sizes(number_of_groups, 0);
+  for (auto const group : groups) {
+    REQUIRE(group >= 0);
+    REQUIRE(group < number_of_groups);
+    sizes[group]++;
+  }
+  // same cost for every visibility, so each group gets the same number of visibilities
+  for (auto const size : sizes) CHECK(std::abs(size - number_of_vis / number_of_groups) <= 1);
+  SECTION("Cost") {
+    Vector<t_real> cost = Vector<t_real>::Ones(number_of_vis);
+    cost.segment(0, number_of_vis / 2) *= 3;
+    std::vector<t_int> const weighted_groups = distribute::bisection_distribution(
+        uv_data.u, uv_data.v, uv_data.w, number_of_groups, cost, 1.);
+    std::vector<t_real> costs(number_of_groups, 0);
+    for (t_int i = 0; i < number_of_vis; i++) costs[weighted_groups[i]] += cost(i);
+    for (auto const c : costs) CHECK(std::abs(c - cost.sum() / number_of_groups) <= 6);
+  }
+  SECTION("w-support cost") {
+    Vector<t_real> w(3);
+    w << 0, 10, 1e6;
+    Vector<t_real> const cost = distribute::w_support_cost(w, 1., 4, 30);
+    CHECK(cost(0) == Approx(16));
+    CHECK(cost(1) == Approx(20 * 20));
+    CHECK(cost(2) == Approx(30 * 30));
+  }
+  SECTION("Grid footprint") {
+    // uv coordinates in pixels of a 256 x 256 grid
+    t_int const ftsize = 256;
+    t_real const scale = 0.5 * (ftsize - 8) / std::max(uv_data.u.cwiseAbs().maxCoeff(),
+                                                       uv_data.v.cwiseAbs().maxCoeff());
+    Vector<t_real> const u = uv_data.u * scale;
+    Vector<t_real> const v = uv_data.v * scale;
+    std::vector<t_int> touched, shared, touched_none, shared_none;
+    std::tie(touched, shared) =
+        distribute::grid_footprint(u, v, groups, number_of_groups, ftsize, ftsize, 4, 4);
+    std::tie(touched_none, shared_none) = distribute::grid_footprint(
+        u, v,
+        distribute::distribute_measurements(uv_data.u, uv_data.v, uv_data.w, number_of_groups,
+                                            distribute::plan::none),
+        number_of_groups, ftsize, ftsize, 4, 4);
+    for (t_int n = 0; n < number_of_groups; n++) {
+      CHECK(shared[n] <= touched[n]);
+      CHECK(touched[n] > 0);
+    }
+    // compact regions share fewer cells than groups in the order of the file
+    CHECK(std::accumulate(shared.begin(), shared.end(), 0) <
+          std::accumulate(shared_none.begin(), shared_none.end(), 0));
+    CHECK(std::accumulate(touched.begin(), touched.end(), 0) <
+          std::accumulate(touched_none.begin(), touched_none.end(), 0));
+  }
+}
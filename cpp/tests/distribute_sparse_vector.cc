@@ -1,7 +1,9 @@
+#include <numeric>
 #include <random>
 #include <set>
 #include <purify/AllToAllSparseVector.h>
 #include <purify/DistributeSparseVector.h>
+#include <purify/NeighbourhoodExchange.h>
 #include "catch.hpp"
 #include <sopt/mpi/communicator.h>
 using namespace purify;
@@ -123,6 +125,88 @@ TEST_CASE("All to All Sparse Vector") {
       }
     }
   }
+
+  SECTION("Pipelined Scatter") {
+    auto const &sizes = distributor.recv_grid_sizes();
+    Vector<t_int> output = Vector<t_int>::Zero(2);
+    distributor.recv_grid_pipelined(
+        grid, [&output, &sizes](const t_int node, const Eigen::Ref<const Vector<t_int>> &block) {
+          output.segment(std::accumulate(sizes.begin(), sizes.begin() + node, 0), block.size()) =
+              block;
+        });
+    CHECK(output(0) == grid(world.rank()));
+    CHECK(output(1) == grid(world.size() + 1));
+  }
+
+  SECTION("Pipelined Gather") {
+    auto const &sizes = distributor.recv_grid_sizes();
+    Vector<t_int> output;
+    distributor.send_grid_pipelined(
+        [&sizes](const t_int node) -> Vector<t_int> { return Vector<t_int>::Ones(sizes[node]); },
+        output);
+    CHECK(output.size() == grid.size());
+    if (world.is_root()) {
+      for (decltype(world.size()) i(0); i < world.size(); ++i) CHECK(output(i) == 1);
+      CHECK(output(world.size()) == 0);
+      CHECK(output(world.size() + 1) == 1);
+    } else {
+      for (t_int i = 0; i < output.size(); i++)
+        CHECK(output(i) == ((i == world.size() + 1) ? 1 : 0));
+    }
+  }
+}
+
+TEST_CASE("Neighbourhood exchange") {
+  auto const world = sopt::mpi::Communicator::World();
+  CAPTURE(world.rank());
+  // each node sends rank + 1 elements to the next node in a ring
+  const t_int next = (world.rank() + 1) % world.size();
+  const t_int previous = (world.rank() + world.size() - 1) % world.size();
+  std::vector<t_int> send_sizes(world.size(), 0);
+  std::vector<t_int> recv_sizes(world.size(), 0);
+  send_sizes[next] = world.rank() + 1;
+  recv_sizes[previous] = previous + 1;
+  const NeighbourhoodExchange exchange(send_sizes, recv_sizes, world);
+  CHECK(exchange.neighbours().size() == ((world.size() > 2) ? 2 : 1));
+
+  const Vector<t_int> local = Vector<t_int>::Constant(world.rank() + 1, world.rank());
+  const Vector<t_int> received = exchange(local);
+  REQUIRE(received.size() == previous + 1);
+  CHECK((received.array() == previous).all());
+  const Vector<t_int> returned = exchange.adjoint(received);
+  REQUIRE(returned.size() == local.size());
+  CHECK(returned == local);
+}
+
+TEST_CASE("Index mapping datatypes") {
+  auto const world = sopt::mpi::Communicator::World();
+  const std::vector<t_int> indices = {1, 2, 3, 7, 8, 10, 11, 12};
+  const IndexMapping<t_int> mapping(indices, 16);
+  const Vector<t_int> data = Vector<t_int>::LinSpaced(16, 0, 15);
+  // elements selected by each datatype, in order
+  const auto selected = [&data, &world](const MPI_Datatype type) {
+    if (type == MPI_DATATYPE_NULL) return std::vector<t_int>();
+    int bytes;
+    MPI_Type_size(type, &bytes);
+    std::vector<t_int> result(bytes / sizeof(t_int));
+    int position = 0;
+    MPI_Pack(data.data(), 1, type, result.data(), bytes, &position, *world);
+    return result;
+  };
+  const std::vector<t_int> first_sizes = {3, 5};
+  const std::vector<t_int> second_sizes = {5, 0, 3};
+  const auto first = mapping.mpi_types<t_int>(first_sizes);
+  const auto second = mapping.mpi_types<t_int>(second_sizes);
+  REQUIRE(first.size() == 2);
+  REQUIRE(second.size() == 3);
+  CHECK(selected(first[0]) == std::vector<t_int>({1, 2, 3}));
+  CHECK(selected(first[1]) == std::vector<t_int>({7, 8, 10, 11, 12}));
+  CHECK(selected(second[0]) == std::vector<t_int>({1, 2, 3, 7, 8}));
+  CHECK(second[1] == MPI_DATATYPE_NULL);
+  CHECK(selected(second[2]) == std::vector<t_int>({10, 11, 12}));
+  // the datatypes of the first sizes are still the ones returned
+  CHECK(mapping.mpi_types<t_int>(first_sizes) == first);
+  CHECK_THROWS(mapping.mpi_types<t_int>(std::vector<t_int>{3, 4}));
 }
 
 TEST_CASE("recv_sizes") {
@@ -1,5 +1,6 @@
 #include "purify/config.h"
 #include "purify/types.h"
+#include <algorithm>
 #include <numeric>
 #include <random>
 #include "catch.hpp"
@@ -63,6 +64,28 @@ TEST_CASE("Index mapping operator") {
   }
 }
 
+TEST_CASE("Runs of consecutive indices") {
+  std::vector<t_int> const indices{11, 12, 13, 17, 18, 12, 19};
+  Vector<t_int> input(10);
+  std::iota(input.data(), input.data() + input.size(), 10);
+  auto const mapper = IndexMapping<t_int>(indices, input.size(), 10);
+  CHECK(mapper.runs() == 4);
+  CHECK(mapper.rows() == indices.size());
+
+  Vector<t_int> output;
+  mapper(input, output);
+  REQUIRE(output.size() == indices.size());
+  for (t_int i = 0; i < output.size(); i++) CHECK(output(i) == indices[i]);
+
+  Vector<t_int> adjoint;
+  mapper.adjoint(output, adjoint);
+  REQUIRE(adjoint.size() == input.size());
+  for (t_int i = 0; i < adjoint.size(); i++) {
+    const auto count = std::count(indices.begin(), indices.end(), i + 10);
+    CHECK(adjoint(i) == count * (i + 10));
+  }
+}
+
 TEST_CASE("Non empty outer vectors") {
   Sparse<t_int> matrix(4, 4);
   std::vector<Eigen::Triplet<t_int>> const triplets = {{0, 0, 1}, {0, 3, 1}, {2, 3, 1}};
@@ -109,3 +132,42 @@ TEST_CASE("Vector-shrinked matrix multiplication") {
   CHECK(utilities::sparse_multiply_matrix(sparse, input) == compressed * comp_input);
   CHECK(utilities::sparse_multiply_matrix(compressed, comp_input) == compressed * comp_input);
 }
+
+TEST_CASE("Split columns of sparse matrix") {
+  auto const N = 10;
+  Matrix<t_int> matrix = (Image<uint8_t>::Random(N, N) < uint8_t(64))
+                             .matrix()
+                             .select(Matrix<uint8_t>::Random(N, N), Matrix<uint8_t>::Zero(N, N))
+                             .cast<t_int>();
+  matrix.row(3).fill(0);
+  matrix.block(5, 0, 1, 4).fill(0);
+  matrix(5, 4) = 1;
+  Sparse<t_int> const sparse = matrix.sparseView();
+  std::vector<t_int> const widths = {4, 0, 6};
+  auto const blocks = split_columns(sparse, widths);
+  REQUIRE(blocks.size() == widths.size());
+  CHECK(std::get<0>(blocks[1]).empty());
+  // the blocks only hold the rows with nonzeros
+  CHECK(std::find(std::get<0>(blocks[0]).begin(), std::get<0>(blocks[0]).end(), 5) ==
+        std::get<0>(blocks[0]).end());
+  CHECK(std::find(std::get<0>(blocks[2]).begin(), std::get<0>(blocks[2]).end(), 5) !=
+        std::get<0>(blocks[2]).end());
+  t_int start = 0;
+  t_int nonzeros = 0;
+  for (std::size_t b = 0; b < blocks.size(); b++) {
+    std::vector<t_int> const &rows = std::get<0>(blocks[b]);
+    Sparse<t_int> const &block = std::get<1>(blocks[b]);
+    CHECK(block.rows() == rows.size());
+    CHECK(block.cols() == widths[b]);
+    CHECK(std::find(rows.begin(), rows.end(), 3) == rows.end());
+    Matrix<t_int> expected = matrix.block(0, start, N, widths[b]);
+    for (t_int k = 0; k < rows.size(); k++) {
+      CHECK(Matrix<t_int>(block.row(k)) == expected.row(rows[k]));
+      expected.row(rows[k]).fill(0);
+    }
+    CHECK(expected == Matrix<t_int>::Zero(N, widths[b]));
+    nonzeros += block.nonZeros();
+    start += widths[b];
+  }
+  CHECK(nonzeros == sparse.nonZeros());
+}
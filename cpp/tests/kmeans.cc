@@ -5,6 +5,7 @@
 #include "purify/distribute.h"
 #include "purify/mpi_utilities.h"
 #include "purify/utilities.h"
+#include "purify/wide_field_utilities.h"
 
 #include <sopt/mpi/communicator.h>
 
@@ -97,3 +98,68 @@ TEST_CASE("distribute w") {
   CHECK(std::get<1>(sorted) == std::get<1>(data));
   CHECK(w_stacks == std::get<2>(data));
 }
+TEST_CASE("optimal 1D clustering") {
+  auto const world = sopt::mpi::Communicator::World();
+  t_int const number_of_groups = world.size() + 2;
+  t_int const N = 1e4;
+  const Vector<t_real> w = world.broadcast<Vector<t_real>>(Vector<t_real>::Random(N) * 100);
+  const auto serial = distribute::kmeans_optimal(w, number_of_groups);
+  const std::vector<t_int> serial_index = std::get<0>(serial);
+  const std::vector<t_real> serial_means = std::get<1>(serial);
+  REQUIRE(serial_index.size() == N);
+  REQUIRE(serial_means.size() == number_of_groups);
+  // each w is in the group of the nearest mean, apart from the width of a bin
+  const t_real bin_width = (w.maxCoeff() - w.minCoeff()) / 4096;
+  for (t_int i = 0; i < N; i++)
+    for (t_int g = 0; g < number_of_groups; g++)
+      CHECK(std::abs(w(i) - serial_means.at(serial_index.at(i))) <=
+            std::abs(w(i) - serial_means.at(g)) + bin_width);
+  // the clusters are at least as good as the ones from k-means
+  const auto kmeans = distribute::kmeans_algo(w, number_of_groups, 100);
+  t_real optimal_cost = 0;
+  t_real kmeans_cost = 0;
+  for (t_int i = 0; i < N; i++) {
+    optimal_cost += std::pow(w(i) - serial_means.at(serial_index.at(i)), 2);
+    kmeans_cost += std::pow(w(i) - std::get<1>(kmeans).at(std::get<0>(kmeans).at(i)), 2);
+  }
+  CHECK(optimal_cost <= kmeans_cost * 1.01);
+  // the same clusters when w is spread over the nodes
+  t_int const start = world.rank() * (N / world.size());
+  t_int const length = (world.rank() == world.size() - 1) ? N - start : N / world.size();
+  const auto mpi = distribute::kmeans_optimal(w.segment(start, length), number_of_groups, world);
+  REQUIRE(std::get<0>(mpi).size() == length);
+  for (t_int j = 0; j < length; j++) REQUIRE(std::get<0>(mpi).at(j) == serial_index.at(start + j));
+  for (t_int g = 0; g < number_of_groups; g++)
+    CHECK(std::get<1>(mpi).at(g) == Approx(serial_means.at(g)));
+}
+TEST_CASE("w support balance") {
+  const t_int min_support = 4;
+  const t_int max_support = 100;
+  const t_real du = 1;
+  auto const comm = sopt::mpi::Communicator::World();
+  // nodes start with different numbers of visibilities
+  const auto params =
+      utilities::random_sample_density(500 * (comm.rank() + 1), 0, constant::pi / 3, 100);
+  const std::vector<t_int> image_index(params.size(), 0);
+  const std::vector<t_real> w_stacks(1, 0.);
+  const auto cost = [](t_int support) -> t_real { return support * support + 10; };
+  const std::vector<t_int> groups = distribute::w_support(params.w, image_index, w_stacks, du,
+                                                          min_support, max_support, 0, comm, cost);
+  REQUIRE(groups.size() == params.size());
+  Vector<t_real> coeffs = Vector<t_real>::Zero(comm.size());
+  t_real max_cost = 0;
+  for (t_int i = 0; i < params.size(); i++) {
+    REQUIRE(groups[i] >= 0);
+    REQUIRE(groups[i] < comm.size());
+    // visibilities stay in order of the nodes
+    if (i > 0) CHECK(groups[i] >= groups[i - 1]);
+    const t_real c =
+        cost(widefield::w_support(std::abs(params.w(i)), du, min_support, max_support));
+    coeffs(groups[i]) += c;
+    max_cost = std::max(max_cost, c);
+  }
+  coeffs = comm.all_sum_all<Vector<t_real>>(coeffs);
+  max_cost = comm.all_reduce<t_real>(max_cost, MPI_MAX);
+  const t_real average = coeffs.sum() / comm.size();
+  for (t_int n = 0; n < comm.size(); n++) CHECK(std::abs(coeffs(n) - average) <= max_cost);
+}
@@ -0,0 +1,71 @@
+#include "purify/config.h"
+#include "purify/types.h"
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include "catch.hpp"
+#include "purify/load_balancing.h"
+
+using namespace purify;
+
+TEST_CASE("Balanced sizes") {
+  const std::vector<t_int> sizes = {1000, 1000, 1000, 1000};
+  SECTION("Equal times") {
+    CHECK(load_balancing::balanced_sizes(sizes, {1., 1., 1., 1.}, 1.) == sizes);
+  }
+  SECTION("Node twice as slow") {
+    const auto targets = load_balancing::balanced_sizes(sizes, {2., 1., 1., 1.}, 1.);
+    CHECK(std::accumulate(targets.begin(), targets.end(), 0) == 4000);
+    // rates 2, 1, 1, 1 ms per visibility
+    CHECK(targets[0] == Approx(4000. / 7.).margin(1));
+    for (t_int n = 1; n < 4; n++) CHECK(targets[n] == Approx(8000. / 7.).margin(1));
+  }
+  SECTION("Migration budget") {
+    const auto targets = load_balancing::balanced_sizes(sizes, {2., 1., 1., 1.}, 0.01);
+    CHECK(std::accumulate(targets.begin(), targets.end(), 0) == 4000);
+    CHECK(targets[0] == 960);
+  }
+  SECTION("Node without visibilities") {
+    const auto targets = load_balancing::balanced_sizes({1000, 0}, {1., 0.}, 1.);
+    CHECK(targets == std::vector<t_int>({500, 500}));
+  }
+  SECTION("No budget") {
+    CHECK(load_balancing::balanced_sizes(sizes, {2., 1., 1., 1.}, 0) == sizes);
+  }
+}
+
+TEST_CASE("Greedy assignment") {
+  CHECK(load_balancing::greedy_assignment({1., 2., 3., 4.}, 2) == std::vector<t_int>({0, 1, 1, 0}));
+  // more nodes than tasks
+  CHECK(load_balancing::greedy_assignment({1., 2.}, 3) == std::vector<t_int>({1, 0}));
+  CHECK(load_balancing::greedy_assignment({}, 2).empty());
+  CHECK_THROWS(load_balancing::greedy_assignment({1.}, 0));
+}
+
+TEST_CASE("Wavelet cost") {
+  const t_uint imsize = 256;
+  CHECK(load_balancing::wavelet_cost("Dirac", 4, imsize, imsize) == Approx(2. * imsize * imsize));
+  CHECK(load_balancing::wavelet_cost("DB1", 4, imsize, imsize) <
+        load_balancing::wavelet_cost("DB8", 4, imsize, imsize));
+  CHECK(load_balancing::wavelet_cost("DB8", 1, imsize, imsize) <
+        load_balancing::wavelet_cost("DB8", 4, imsize, imsize));
+  CHECK_THROWS(load_balancing::wavelet_cost("Haar", 4, imsize, imsize));
+  SECTION("Nine bases on four nodes") {
+    std::vector<t_real> costs = {load_balancing::wavelet_cost("Dirac", 4, imsize, imsize)};
+    for (t_int k = 1; k < 9; k++)
+      costs.push_back(load_balancing::wavelet_cost("DB" + std::to_string(k), 4, imsize, imsize));
+    const t_int nodes = 4;
+    const auto assignment = load_balancing::greedy_assignment(costs, nodes);
+    std::vector<t_real> greedy(nodes, 0);
+    std::vector<t_real> round_robin(nodes, 0);
+    for (t_int i = 0; i < costs.size(); i++) {
+      greedy[assignment[i]] += costs[i];
+      round_robin[i % nodes] += costs[i];
+    }
+    const t_real average = std::accumulate(costs.begin(), costs.end(), 0.) / nodes;
+    const t_real makespan = *std::max_element(greedy.begin(), greedy.end());
+    CHECK(makespan < *std::max_element(round_robin.begin(), round_robin.end()));
+    // within 4/3 of the optimum, and no basis is more expensive than the average here
+    CHECK(makespan <= 4. / 3. * std::max(average, costs.back()));
+  }
+}
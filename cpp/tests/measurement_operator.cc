@@ -1,12 +1,15 @@
 #include <iomanip>
 #include "catch.hpp"
 
+#include "purify/batch_operators.h"
 #include "purify/directories.h"
 #include "purify/kernels.h"
 #include "purify/operators.h"
 #include "purify/pfitsio.h"
+#include "purify/psf_operator.h"
 #include "purify/test_data.h"
 #include "purify/utilities.h"
+#include "purify/uvw_utilities.h"
 #include "purify/wproj_operators.h"
 #include <sopt/power_method.h>
 
@@ -312,3 +315,145 @@ TEST_CASE("normed operator") {
     }
   }
 }
+
+TEST_CASE("hermitian fold") {
+  const t_int imsizex = 128;
+  const t_int imsizey = 128;
+  const t_uint M = 200;
+  const t_uint duplicates = 20;
+  const t_real oversample_ratio = 2;
+  const kernels::kernel kernel = kernels::kernel::kb;
+  const t_uint J = 6;
+  // half of the first coordinates are measured a second time at the conjugate position
+  Vector<t_real> u = Vector<t_real>::Random(M + duplicates) * imsizex / 2;
+  Vector<t_real> v = Vector<t_real>::Random(M + duplicates) * imsizey / 2;
+  u.tail(duplicates) = -u.head(duplicates);
+  v.tail(duplicates) = -v.head(duplicates);
+  const Vector<t_real> w = Vector<t_real>::Zero(M + duplicates);
+  const Vector<t_complex> weights = Vector<t_complex>::Ones(M + duplicates);
+  const auto measure_op = measurementoperator::init_degrid_operator_2d<Vector<t_complex>>(
+      u, v, w, weights, imsizey, imsizex, oversample_ratio, kernel, J, J);
+  const Vector<t_complex> x = Vector<t_real>::Random(imsizex * imsizey).cast<t_complex>();
+  const Vector<t_complex> x_true = Vector<t_real>::Random(imsizex * imsizey).cast<t_complex>();
+
+  utilities::vis_params uv_data(u, v, w, (*measure_op * x_true).eval(), weights);
+  const utilities::vis_params folded = utilities::fold_hermitian(uv_data);
+  REQUIRE(folded.size() == M);
+  CHECK(folded.v.minCoeff() >= 0);
+  const auto folded_op = measurementoperator::init_degrid_operator_2d<Vector<t_complex>>(
+      folded.u, folded.v, folded.w, folded.weights, imsizey, imsizex, oversample_ratio, kernel, J,
+      J);
+  SECTION("degrid") {
+    const Vector<t_complex> y_folded = *folded_op * x_true;
+    CHECK(y_folded.isApprox(folded.vis.cwiseProduct(folded.weights), 1e-4));
+  }
+  SECTION("gradient") {
+    const Vector<t_complex> gradient =
+        measure_op->adjoint() * (*measure_op * x - uv_data.vis.cwiseProduct(uv_data.weights));
+    const Vector<t_complex> folded_gradient =
+        folded_op->adjoint() * (*folded_op * x - folded.vis.cwiseProduct(folded.weights));
+    CHECK(gradient.real().isApprox(folded_gradient.real(), 1e-4));
+  }
+}
+
+TEST_CASE("psf normal operator") {
+  const t_uint imsizex = 64;
+  const t_uint imsizey = 64;
+  const t_real oversample_ratio = 2;
+  const kernels::kernel kernel = kernels::kernel::kb;
+  const t_uint J = 6;
+  auto uv_data = utilities::random_sample_density(500, 0, constant::pi / 3);
+  uv_data.units = utilities::vis_units::radians;
+  uv_data.weights = Vector<t_complex>::Random(uv_data.size()).cwiseAbs().cast<t_complex>();
+  const auto measure_op = measurementoperator::init_degrid_operator_2d<Vector<t_complex>>(
+      uv_data, imsizey, imsizex, 1, 1, oversample_ratio, kernel, J, J);
+  const auto normal_op = measurementoperator::init_psf_normal_operator_2d<Vector<t_complex>>(
+      uv_data, imsizey, imsizex, 1, 1, oversample_ratio, kernel, J, J);
+  const Vector<t_complex> x = Vector<t_complex>::Random(imsizex * imsizey);
+  const Vector<t_complex> expected = measure_op->adjoint() * (*measure_op * x);
+  const Vector<t_complex> normal = *normal_op * x;
+  CHECK(normal.isApprox(expected, 1e-3));
+  SECTION("gradient") {
+    const Vector<t_complex> y = *measure_op * Vector<t_complex>::Random(imsizex * imsizey);
+    const Vector<t_complex> dirty = measure_op->adjoint() * y;
+    const auto gradient_op =
+        measurementoperator::init_psf_gradient_operator_2d<Vector<t_complex>>(
+            normal_op, imsizey, imsizex);
+    const Vector<t_complex> gradient = gradient_op->adjoint() * (*gradient_op * x - dirty);
+    CHECK(gradient.isApprox(measure_op->adjoint() * (*measure_op * x - y), 1e-3));
+  }
+}
+
+TEST_CASE("batched degrid operator") {
+  const t_uint imsizex = 64;
+  const t_uint imsizey = 64;
+  const t_uint M = 100;
+  const t_real oversample_ratio = 2;
+  const kernels::kernel kernel = kernels::kernel::kb;
+  const t_uint J = 4;
+  const Vector<t_real> u = Vector<t_real>::Random(M) * imsizex / 2;
+  const Vector<t_real> v = Vector<t_real>::Random(M) * imsizey / 2;
+  const Vector<t_real> w = Vector<t_real>::Zero(M);
+  const Vector<t_complex> weights = Vector<t_complex>::Random(M);
+  sopt::OperatorFunction<Vector<t_complex>> direct, indirect;
+  std::tie(direct, indirect) = operators::base_degrid_operator_2d<Vector<t_complex>>(
+      u, v, w, weights, imsizey, imsizex, oversample_ratio, kernel, J, J,
+      operators::fftw_plan::estimate, false, 1, 1, false);
+  sopt::OperatorFunction<Vector<t_complex>> direct_shared, indirect_shared;
+  sopt::OperatorFunction<Matrix<t_complex>> direct_batch, indirect_batch;
+  std::tie(direct_shared, indirect_shared, direct_batch, indirect_batch) =
+      operators::base_degrid_operator_2d_with_batch<Vector<t_complex>>(
+          u, v, w, weights, imsizey, imsizex, oversample_ratio, kernel, J, J,
+          operators::fftw_plan::estimate);
+  // the FFT is planned for each number of columns
+  const std::vector<t_uint> batches = {3, 1, 3};
+  SECTION("degrid") {
+    for (const t_uint batch : batches) {
+      const Matrix<t_complex> images = Matrix<t_complex>::Random(imsizex * imsizey, batch);
+      Matrix<t_complex> vis;
+      direct_batch(vis, images);
+      REQUIRE(vis.rows() == M);
+      REQUIRE(vis.cols() == batch);
+      for (t_uint k = 0; k < batch; k++) {
+        Vector<t_complex> expected;
+        direct(expected, images.col(k));
+        CHECK(vis.col(k).isApprox(expected, 1e-12));
+        direct_shared(expected, images.col(k));
+        CHECK(vis.col(k).isApprox(expected, 1e-12));
+      }
+    }
+  }
+  SECTION("grid") {
+    for (const t_uint batch : batches) {
+      const Matrix<t_complex> vis = Matrix<t_complex>::Random(M, batch);
+      Matrix<t_complex> images;
+      indirect_batch(images, vis);
+      REQUIRE(images.rows() == imsizex * imsizey);
+      REQUIRE(images.cols() == batch);
+      for (t_uint k = 0; k < batch; k++) {
+        Vector<t_complex> expected;
+        indirect(expected, vis.col(k));
+        CHECK(images.col(k).isApprox(expected, 1e-12));
+        indirect_shared(expected, vis.col(k));
+        CHECK(images.col(k).isApprox(expected, 1e-12));
+      }
+    }
+  }
+  SECTION("columns") {
+    const auto measure_op = std::make_shared<sopt::LinearTransform<Vector<t_complex>> const>(
+        direct, std::array<t_int, 3>{0, 1, static_cast<t_int>(M)}, indirect,
+        std::array<t_int, 3>{0, 1, static_cast<t_int>(imsizex * imsizey)});
+    sopt::OperatorFunction<Matrix<t_complex>> direct_columns, indirect_columns;
+    std::tie(direct_columns, indirect_columns) =
+        operators::init_batch_from_columns<Vector<t_complex>>(measure_op);
+    const Matrix<t_complex> images = Matrix<t_complex>::Random(imsizex * imsizey, 2);
+    Matrix<t_complex> expected, result;
+    direct_batch(expected, images);
+    direct_columns(result, images);
+    CHECK(result.isApprox(expected, 1e-12));
+    const Matrix<t_complex> vis = Matrix<t_complex>::Random(M, 2);
+    indirect_batch(expected, vis);
+    indirect_columns(result, vis);
+    CHECK(result.isApprox(expected, 1e-12));
+  }
+}
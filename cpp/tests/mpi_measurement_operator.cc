@@ -5,6 +5,8 @@
 #include "purify/logging.h"
 #include "purify/mpi_utilities.h"
 #include "purify/operators.h"
+#include "purify/shared_memory_operators.h"
+#include "purify/slab_operators.h"
 #include "purify/utilities.h"
 #include "purify/wproj_operators.h"
 #include <sopt/mpi/communicator.h>
@@ -148,6 +150,181 @@ TEST_CASE("Serial vs Distributed Fourier Grid Operator") {
   }
 }
 
+TEST_CASE("Serial vs Slab Distributed Fourier Grid Operator") {
+  auto const world = sopt::mpi::Communicator::World();
+
+  auto const N = 1000;
+  auto uv_serial = utilities::random_sample_density(N, 0, constant::pi / 3);
+  uv_serial.u = world.broadcast(uv_serial.u);
+  uv_serial.v = world.broadcast(uv_serial.v);
+  uv_serial.w = world.broadcast(uv_serial.w);
+  uv_serial.units = utilities::vis_units::radians;
+  uv_serial.vis = world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(uv_serial.u.size()));
+  uv_serial.weights =
+      world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(uv_serial.u.size()));
+
+  utilities::vis_params uv_mpi;
+  if (world.is_root()) {
+    auto const order =
+        distribute::distribute_measurements(uv_serial, world, distribute::plan::radial);
+    uv_mpi = utilities::regroup_and_scatter(uv_serial, order, world);
+  } else
+    uv_mpi = utilities::scatter_visibilities(world);
+
+  auto const over_sample = 2;
+  auto const width = 128;
+  auto const height = 96;
+  const auto op_serial = purify::measurementoperator::init_degrid_operator_2d<Vector<t_complex>>(
+      uv_serial.u, uv_serial.v, uv_serial.w, uv_serial.weights, height, width, over_sample);
+  const auto op = purify::measurementoperator::init_degrid_operator_2d_slabs<Vector<t_complex>>(
+      world, uv_mpi.u, uv_mpi.v, uv_mpi.w, uv_mpi.weights, height, width, over_sample);
+
+  SECTION("Degridding") {
+    Vector<t_complex> const image =
+        world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(width * height));
+
+    auto uv_degrid = uv_serial;
+    if (world.is_root()) {
+      uv_degrid.vis = *op_serial * image;
+      auto const order =
+          distribute::distribute_measurements(uv_degrid, world, distribute::plan::radial);
+      uv_degrid = utilities::regroup_and_scatter(uv_degrid, order, world);
+    } else
+      uv_degrid = utilities::scatter_visibilities(world);
+    Vector<t_complex> const degridded = *op * image;
+    REQUIRE(degridded.size() == uv_degrid.vis.size());
+    REQUIRE(degridded.isApprox(uv_degrid.vis, 1e-4));
+  }
+  SECTION("Gridding") {
+    Vector<t_complex> const gridded = op->adjoint() * uv_mpi.vis;
+    Vector<t_complex> const gridded_serial = op_serial->adjoint() * uv_serial.vis;
+    REQUIRE(gridded.size() == gridded_serial.size());
+    REQUIRE(gridded.isApprox(gridded_serial, 1e-4));
+  }
+}
+
+TEST_CASE("Serial vs Slab Distributed Image and Fourier Grid Operator") {
+  auto const world = sopt::mpi::Communicator::World();
+
+  auto const N = 1000;
+  auto uv_serial = utilities::random_sample_density(N, 0, constant::pi / 3);
+  uv_serial.u = world.broadcast(uv_serial.u);
+  uv_serial.v = world.broadcast(uv_serial.v);
+  uv_serial.w = world.broadcast(uv_serial.w);
+  uv_serial.units = utilities::vis_units::radians;
+  uv_serial.vis = world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(uv_serial.u.size()));
+  uv_serial.weights =
+      world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(uv_serial.u.size()));
+
+  utilities::vis_params uv_mpi;
+  if (world.is_root()) {
+    auto const order =
+        distribute::distribute_measurements(uv_serial, world, distribute::plan::radial);
+    uv_mpi = utilities::regroup_and_scatter(uv_serial, order, world);
+  } else
+    uv_mpi = utilities::scatter_visibilities(world);
+
+  auto const over_sample = 2;
+  auto const width = 128;
+  auto const height = 96;
+  const auto op_serial = purify::measurementoperator::init_degrid_operator_2d<Vector<t_complex>>(
+      uv_serial.u, uv_serial.v, uv_serial.w, uv_serial.weights, height, width, over_sample);
+  const auto op =
+      purify::measurementoperator::init_degrid_operator_2d_image_slabs<Vector<t_complex>>(
+          world, uv_mpi.u, uv_mpi.v, uv_mpi.w, uv_mpi.weights, height, width, over_sample);
+
+  SECTION("Degridding") {
+    Vector<t_complex> const image =
+        world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(width * height));
+
+    auto uv_degrid = uv_serial;
+    if (world.is_root()) {
+      uv_degrid.vis = *op_serial * image;
+      auto const order =
+          distribute::distribute_measurements(uv_degrid, world, distribute::plan::radial);
+      uv_degrid = utilities::regroup_and_scatter(uv_degrid, order, world);
+    } else
+      uv_degrid = utilities::scatter_visibilities(world);
+    Vector<t_complex> const degridded =
+        *op * operators::image_slab<Vector<t_complex>>(world, image, height, width);
+    REQUIRE(degridded.size() == uv_degrid.vis.size());
+    REQUIRE(degridded.isApprox(uv_degrid.vis, 1e-4));
+  }
+  SECTION("Gridding") {
+    Vector<t_complex> const slab = op->adjoint() * uv_mpi.vis;
+    auto const rows = operators::slab_starts(height, world.size());
+    REQUIRE(slab.size() == (rows[world.rank() + 1] - rows[world.rank()]) * width);
+    Vector<t_complex> const gridded =
+        operators::gather_image_slabs<Vector<t_complex>>(world, slab, height, width);
+    Vector<t_complex> const gridded_serial = op_serial->adjoint() * uv_serial.vis;
+    REQUIRE(gridded.size() == gridded_serial.size());
+    REQUIRE(gridded.isApprox(gridded_serial, 1e-4));
+  }
+}
+
+TEST_CASE("Serial vs Node Shared Memory Fourier Grid Operator") {
+  auto const world = sopt::mpi::Communicator::World();
+
+  auto const N = 1000;
+  auto uv_serial = utilities::random_sample_density(N, 0, constant::pi / 3);
+  uv_serial.u = world.broadcast(uv_serial.u);
+  uv_serial.v = world.broadcast(uv_serial.v);
+  uv_serial.w = world.broadcast(uv_serial.w);
+  uv_serial.units = utilities::vis_units::radians;
+  uv_serial.vis = world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(uv_serial.u.size()));
+  uv_serial.weights =
+      world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(uv_serial.u.size()));
+
+  utilities::vis_params uv_mpi;
+  if (world.is_root()) {
+    auto const order =
+        distribute::distribute_measurements(uv_serial, world, distribute::plan::radial);
+    uv_mpi = utilities::regroup_and_scatter(uv_serial, order, world);
+  } else
+    uv_mpi = utilities::scatter_visibilities(world);
+
+  auto const over_sample = 2;
+  auto const width = 128;
+  auto const height = 96;
+  const auto op_serial = purify::measurementoperator::init_degrid_operator_2d<Vector<t_complex>>(
+      uv_serial.u, uv_serial.v, uv_serial.w, uv_serial.weights, height, width, over_sample);
+  const auto op =
+      purify::measurementoperator::init_degrid_operator_2d_shared_memory<Vector<t_complex>>(
+          world, uv_mpi.u, uv_mpi.v, uv_mpi.w, uv_mpi.weights, height, width, over_sample);
+
+  SECTION("Degridding") {
+    Vector<t_complex> const image =
+        world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(width * height));
+
+    auto uv_degrid = uv_serial;
+    if (world.is_root()) {
+      uv_degrid.vis = *op_serial * image;
+      auto const order =
+          distribute::distribute_measurements(uv_degrid, world, distribute::plan::radial);
+      uv_degrid = utilities::regroup_and_scatter(uv_degrid, order, world);
+    } else
+      uv_degrid = utilities::scatter_visibilities(world);
+    Vector<t_complex> const degridded = *op * image;
+    REQUIRE(degridded.size() == uv_degrid.vis.size());
+    REQUIRE(degridded.isApprox(uv_degrid.vis, 1e-4));
+  }
+  SECTION("Gridding") {
+    Vector<t_complex> const gridded = op->adjoint() * uv_mpi.vis;
+    Vector<t_complex> const gridded_serial = op_serial->adjoint() * uv_serial.vis;
+    REQUIRE(gridded.size() == gridded_serial.size());
+    REQUIRE(gridded.isApprox(gridded_serial, 1e-4));
+  }
+  SECTION("Repeated application") {
+    // the shared grid and image are reused between applications
+    Vector<t_complex> const image =
+        world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(width * height));
+    Vector<t_complex> const first = *op * image;
+    Vector<t_complex> const gridded = op->adjoint() * uv_mpi.vis;
+    REQUIRE((*op * image).isApprox(first, 1e-12));
+    REQUIRE((op->adjoint() * uv_mpi.vis).isApprox(gridded, 1e-12));
+  }
+}
+
 TEST_CASE("Serial vs Distributed Fourier Grid Operator weighted") {
   // sopt::logging::set_level("debug");
   // purify::logging::set_level("debug");
@@ -294,6 +471,26 @@ TEST_CASE("Serial vs All to All Fourier Grid Operator weighted") {
     REQUIRE(gridded.size() == gridded_serial.size());
     REQUIRE(gridded.isApprox(gridded_serial, 1e-4));
   }
+  SECTION("Pipelined") {
+    const auto op_blocking =
+        purify::measurementoperator::init_degrid_operator_2d_all_to_all<Vector<t_complex>>(
+            world, image_index, w_stacks, uv_mpi.u, uv_mpi.v, uv_mpi.w, uv_mpi.weights, height,
+            width, over_sample);
+    const auto op_pipelined =
+        purify::measurementoperator::init_degrid_operator_2d_all_to_all<Vector<t_complex>>(
+            world, image_index, w_stacks, uv_mpi.u, uv_mpi.v, uv_mpi.w, uv_mpi.weights, height,
+            width, over_sample, kernel, J, J, false, 1, 1, true);
+    Vector<t_complex> const image =
+        world.broadcast<Vector<t_complex>>(Vector<t_complex>::Random(width * height));
+    Vector<t_complex> const degridded = *op_pipelined * image;
+    REQUIRE(degridded.size() == uv_mpi.size());
+    CHECK(degridded.isApprox(*op_blocking * image, 1e-12));
+    // the blocks are added in a fixed order, whatever order they arrive in
+    CHECK(degridded == *op_pipelined * image);
+    Vector<t_complex> const gridded = op_pipelined->adjoint() * uv_mpi.vis;
+    REQUIRE(gridded.size() == width * height);
+    CHECK(gridded.isApprox(op_blocking->adjoint() * uv_mpi.vis, 1e-12));
+  }
 }
 
 TEST_CASE("Standard vs All to All stacking") {
@@ -18,6 +18,12 @@ TEST_CASE("uvfits") {
       const auto uvfits = read_measurements::read_measurements(filename + ".uvfits", comm);
       CAPTURE(comm.rank());
       CHECK(comm.all_sum_all(uvfits.size()) == 245886);
+      // every node reads part of the file, the same visibilities end up distributed
+      const auto serial = read_measurements::read_measurements(filename + ".uvfits");
+      CHECK(std::abs(comm.all_sum_all(uvfits.vis.sum()) - serial.vis.sum()) <
+            1e-8 * serial.vis.cwiseAbs().sum());
+      CHECK(std::abs(comm.all_sum_all(uvfits.u.sum()) - serial.u.sum()) <
+            1e-8 * serial.u.cwiseAbs().sum());
     }
     SECTION("vis") {
       const auto vis =
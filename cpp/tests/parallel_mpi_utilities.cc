@@ -1,5 +1,11 @@
 #include "catch.hpp"
+#include "purify/NodeAwareReduction.h"
+#include "purify/SharedArray.h"
+#include "purify/distribute.h"
+#include "purify/load_balancing.h"
 #include "purify/mpi_utilities.h"
+#include "purify/random_update_factory.h"
+#include "purify/wide_field_utilities.h"
 
 using namespace purify;
 
@@ -31,3 +37,351 @@ TEST_CASE("Distribution of visibility data") {
   } else
     CHECK(actual.u.size() == 0);
 }
+
+TEST_CASE("Node aware all sum all") {
+  auto const world = sopt::mpi::Communicator::World();
+  CHECK(not NodeAwareReduction::shared_memory_default());
+  CHECK(not NodeAwareReduction(world).hierarchical());
+  NodeAwareReduction const reduction(world, true);
+  CHECK(reduction.nodes() >= 1);
+  CHECK(reduction.nodes() <= world.size());
+  for (t_int const N : {0, 1, 7, 1024}) {
+    Vector<t_complex> const input = Vector<t_complex>::Random(N) * (world.rank() + 1);
+    Vector<t_complex> const expected = world.all_sum_all<Vector<t_complex>>(input);
+    Vector<t_complex> const actual = reduction.all_sum_all(input);
+    REQUIRE(actual.size() == N);
+    CHECK(actual.isApprox(expected, 1e-12));
+  }
+  // back to back reductions reuse the shared window without a barrier in between
+  for (t_int i = 0; i < 10; i++) {
+    Vector<t_real> const input = Vector<t_real>::Constant(7, world.rank() + i);
+    CHECK(reduction.all_sum_all(input).isApprox(
+        Vector<t_real>::Constant(7, world.size() * (world.size() - 1) * 0.5 + i * world.size())));
+  }
+  // the shared window is reused for smaller vectors
+  Vector<t_real> const input = Vector<t_real>::Constant(5, world.rank());
+  CHECK(reduction.all_sum_all(input).isApprox(
+      Vector<t_real>::Constant(5, world.size() * (world.size() - 1) * 0.5)));
+}
+
+TEST_CASE("Node shared array") {
+  auto const world = sopt::mpi::Communicator::World();
+  SharedArray<t_real> const array(node_communicator(world), 11);
+  array.zero();
+  CHECK(array.vector().isApprox(Vector<t_real>::Zero(11)));
+  array.add(Vector<t_real>::Constant(11, 2));
+  CHECK(array.vector().isApprox(Vector<t_real>::Constant(11, 2 * array.ranks())));
+  array.sync();
+  array.zero();
+  // every rank of the node adds one to the even elements
+  std::vector<t_int> indices;
+  for (t_int i = 0; i < array.size(); i += 2) indices.push_back(i);
+  array.add(indices, Vector<t_real>::Ones(indices.size()));
+  for (t_int i = 0; i < array.size(); i++)
+    CHECK(array.data()[i] == ((i % 2 == 0) ? array.ranks() : 0));
+  array.sync();
+}
+
+TEST_CASE("Parallel distribution of visibilities") {
+  auto const world = sopt::mpi::Communicator::World();
+  // nodes start with different numbers of visibilities
+  auto const N = 100 * (world.rank() + 1);
+  utilities::vis_params params;
+  params.u = Vector<t_real>::Random(N);
+  params.v = Vector<t_real>::Random(N);
+  params.w = Vector<t_real>::Random(N);
+  params.vis = Vector<t_complex>::Random(N);
+  params.weights = Vector<t_complex>::Random(N);
+  auto const total = world.all_sum_all<t_int>(N);
+  for (auto const plan : {distribute::plan::none, distribute::plan::equal,
+                          distribute::plan::radial, distribute::plan::w_term}) {
+    auto const groups = distribute::distribute_measurements_parallel(params, world, plan);
+    REQUIRE(groups.size() == N);
+    Vector<t_int> sizes = Vector<t_int>::Zero(world.size());
+    for (auto const group : groups) {
+      REQUIRE(group >= 0);
+      REQUIRE(group < world.size());
+      sizes(group)++;
+    }
+    sizes = world.all_sum_all<Vector<t_int>>(sizes);
+    CHECK(sizes.sum() == total);
+    CHECK(sizes.maxCoeff() - sizes.minCoeff() <= 1);
+    if (plan == distribute::plan::w_term) {
+      // nodes hold increasing ranges of w, up to the width of a bin
+      Vector<t_real> w_max = Vector<t_real>::Constant(world.size(), -2);
+      Vector<t_real> w_min = Vector<t_real>::Constant(world.size(), 2);
+      for (t_int i = 0; i < N; i++) {
+        w_max(groups[i]) = std::max(w_max(groups[i]), params.w(i));
+        w_min(groups[i]) = std::min(w_min(groups[i]), params.w(i));
+      }
+      for (t_int node = 0; node < world.size(); node++) {
+        w_max(node) = world.all_reduce<t_real>(w_max(node), MPI_MAX);
+        w_min(node) = world.all_reduce<t_real>(w_min(node), MPI_MIN);
+      }
+      for (t_int node = 1; node < world.size(); node++)
+        CHECK(w_min(node) >= w_max(node - 1) - 2. / 65536 - 1e-12);
+    }
+  }
+}
+
+TEST_CASE("Parallel bisection of visibilities") {
+  auto const world = sopt::mpi::Communicator::World();
+  auto const N = 100 * (world.rank() + 1);
+  utilities::vis_params params;
+  params.u = Vector<t_real>::Random(N) * 100;
+  params.v = Vector<t_real>::Random(N) * 100;
+  params.w = Vector<t_real>::Random(N);
+  params.vis = Vector<t_complex>::Random(N);
+  params.weights = Vector<t_complex>::Random(N);
+  auto const total = world.all_sum_all<t_int>(N);
+  auto const groups =
+      distribute::distribute_measurements_parallel(params, world, distribute::plan::bisection);
+  REQUIRE(groups.size() == N);
+  Vector<t_int> sizes = Vector<t_int>::Zero(world.size());
+  for (auto const group : groups) {
+    REQUIRE(group >= 0);
+    REQUIRE(group < world.size());
+    sizes(group)++;
+  }
+  sizes = world.all_sum_all<Vector<t_int>>(sizes);
+  CHECK(sizes.sum() == total);
+  // cuts are placed on bins, which hold very few visibilities
+  CHECK(sizes.maxCoeff() - sizes.minCoeff() <= 4 + total / 100);
+  // cells are only shared along the cuts, unlike nodes that hold visibilities from everywhere
+  auto const bisected = utilities::regroup_and_all_to_all(params, groups, world);
+  auto const unordered = utilities::regroup_and_all_to_all(
+      params, distribute::distribute_measurements_parallel(params, world, distribute::plan::none),
+      world);
+  t_int touched, shared, touched_unordered, shared_unordered;
+  std::tie(touched, shared) =
+      distribute::grid_footprint(bisected.u, bisected.v, world, 256, 256, 4, 4);
+  std::tie(touched_unordered, shared_unordered) =
+      distribute::grid_footprint(unordered.u, unordered.v, world, 256, 256, 4, 4);
+  CHECK(shared <= touched);
+  CHECK(world.all_sum_all(shared) <= world.all_sum_all(shared_unordered));
+  if (world.size() > 1) CHECK(world.all_sum_all(touched) < world.all_sum_all(touched_unordered));
+}
+
+TEST_CASE("Load balancing from gridding time") {
+  auto const world = sopt::mpi::Communicator::World();
+  // nodes start with different numbers of visibilities
+  auto const N = 1000 * (world.rank() + 1);
+  utilities::vis_params params;
+  params.u = Vector<t_real>::Random(N) * 10;
+  params.v = Vector<t_real>::Random(N) * 10;
+  params.w = Vector<t_real>::Random(N);
+  params.vis = Vector<t_complex>::Random(N);
+  params.weights = Vector<t_complex>::Ones(N);
+  params.units = utilities::vis_units::pixels;
+  auto const total = world.all_sum_all<t_int>(N);
+  const t_real budget = 0.1;
+  auto const balanced = load_balancing::rebalance(params, world, 1, 1, 64, 64, 2,
+                                                  kernels::kernel::kb, 4, 4, 3, budget);
+  CHECK(world.all_sum_all<t_int>(balanced.size()) == total);
+  CHECK(std::abs(world.all_sum_all(balanced.vis.sum()) - world.all_sum_all(params.vis.sum())) <
+        1e-8 * total);
+  // no more than the budget moved
+  const t_int moved = std::max<t_int>(0, N - static_cast<t_int>(balanced.size()));
+  CHECK(world.all_sum_all(moved) <= budget * total + world.size());
+}
+
+TEST_CASE("Load balancing keeps the distribution plan") {
+  auto const world = sopt::mpi::Communicator::World();
+  auto const N = 1000 * (world.rank() + 1);
+  utilities::vis_params params;
+  params.u = Vector<t_real>::Random(N) * 10;
+  params.v = Vector<t_real>::Random(N) * 10;
+  params.w = Vector<t_real>::Random(N);
+  params.vis = Vector<t_complex>::Random(N);
+  params.weights = Vector<t_complex>::Ones(N);
+  params.units = utilities::vis_units::pixels;
+  auto const total = world.all_sum_all<t_int>(N);
+  const auto plan = distribute::plan::radial;
+  params = utilities::regroup_and_all_to_all(
+      params, distribute::distribute_measurements_parallel(params, world, plan), world);
+  // time records the node each visibility started on
+  params.time = Vector<t_real>::Constant(params.size(), world.rank());
+  const t_real budget = 0.1;
+  auto const balanced = load_balancing::rebalance(params, world, 1, 1, 64, 64, 2,
+                                                  kernels::kernel::kb, 4, 4, 3, budget, plan);
+  CHECK(world.all_sum_all<t_int>(balanced.size()) == total);
+  const t_int moved = (balanced.time.array() != static_cast<t_real>(world.rank())).count();
+  CHECK(world.all_sum_all(moved) <= budget * total);
+  // the nodes still hold consecutive rings of the uv plane, up to the width of a bin of the plan
+  const Vector<t_real> radius = (balanced.u.array().square() + balanced.v.array().square()).sqrt();
+  Vector<t_real> min_radius = Vector<t_real>::Zero(world.size());
+  Vector<t_real> max_radius = Vector<t_real>::Zero(world.size());
+  Vector<t_int> sizes = Vector<t_int>::Zero(world.size());
+  if (balanced.size() > 0) {
+    min_radius(world.rank()) = radius.minCoeff();
+    max_radius(world.rank()) = radius.maxCoeff();
+    sizes(world.rank()) = balanced.size();
+  }
+  min_radius = world.all_sum_all<Vector<t_real>>(min_radius);
+  max_radius = world.all_sum_all<Vector<t_real>>(max_radius);
+  sizes = world.all_sum_all<Vector<t_int>>(sizes);
+  for (t_int n = 0; n < world.size(); n++)
+    for (t_int m = n + 1; m < world.size(); m++)
+      if (sizes(n) > 0 and sizes(m) > 0) CHECK(max_radius(n) <= min_radius(m) + 1e-3);
+}
+
+TEST_CASE("Packed all to all of visibilities") {
+  auto const world = sopt::mpi::Communicator::World();
+  auto const N = 10 + 3 * world.rank();
+  utilities::vis_params params;
+  // u encodes the sending node and the position on that node
+  params.u = Vector<t_real>::LinSpaced(N, 0, N - 1).array() + 1000 * world.rank();
+  params.v = 2 * params.u;
+  params.w = 3 * params.u;
+  params.vis = params.u.cast<t_complex>() * t_complex(1, 2);
+  params.weights = 2 * params.vis;
+  params.time = 5 * params.u;
+  params.baseline = params.u.cast<t_uint>();
+  params.ra = 1.5;
+  params.units = utilities::vis_units::radians;
+  std::vector<t_int> groups(N), index(N);
+  for (t_int i = 0; i < N; i++) {
+    groups[i] = (7 * i + world.rank()) % world.size();
+    index[i] = i;
+  }
+
+  SECTION("Records and header arrive intact") {
+    utilities::vis_params result;
+    std::vector<t_int> result_index;
+    std::tie(result, result_index) =
+        utilities::regroup_and_all_to_all(params, index, groups, world);
+    CHECK(world.all_sum_all<t_int>(result.size()) == world.all_sum_all<t_int>(N));
+    CHECK(result.ra == Approx(1.5));
+    CHECK(result.units == utilities::vis_units::radians);
+    REQUIRE(result.time.size() == result.size());
+    REQUIRE(result.baseline.size() == result.size());
+    REQUIRE(result_index.size() == result.size());
+    for (t_int i = 0; i < result.size(); i++) {
+      const t_int sender = std::floor(result.u(i) / 1000 + 0.5);
+      const t_int position = result.u(i) - 1000 * sender;
+      CHECK((7 * position + sender) % world.size() == world.rank());
+      CHECK(result_index[i] == position);
+      CHECK(result.v(i) == Approx(2 * result.u(i)));
+      CHECK(result.w(i) == Approx(3 * result.u(i)));
+      CHECK(std::abs(result.vis(i) - t_complex(result.u(i), 2 * result.u(i))) < 1e-12);
+      CHECK(std::abs(result.weights(i) - 2. * result.vis(i)) < 1e-12);
+      CHECK(result.time(i) == Approx(5 * result.u(i)));
+      CHECK(result.baseline(i) == static_cast<t_uint>(result.u(i)));
+    }
+  }
+  SECTION("Time is dropped if a node does not have it") {
+    if (world.is_root()) params.time = Vector<t_real>::Zero(0);
+    auto const result = utilities::regroup_and_all_to_all(params, groups, world);
+    CHECK(result.time.size() == 0);
+    CHECK(result.baseline.size() == result.size());
+  }
+}
+
+TEST_CASE("Baseline dependent averaging on all nodes") {
+  auto const world = sopt::mpi::Communicator::World();
+  const t_uint baselines = 7;
+  const t_uint samples = 40;
+  const t_real cell = 10;
+  const t_uint imsize = 256;
+  const t_real du = widefield::pixel_to_lambda(cell, imsize, 1.);
+  // the same tracks on all nodes, of which each node holds every world.size()-th sample
+  utilities::vis_params all;
+  all.u = Vector<t_real>::Zero(baselines * samples);
+  all.v = Vector<t_real>::Zero(baselines * samples);
+  all.w = Vector<t_real>::Zero(baselines * samples);
+  all.time = Vector<t_real>::Zero(baselines * samples);
+  all.baseline = Vector<t_uint>::Zero(baselines * samples);
+  all.vis = Vector<t_complex>::Zero(baselines * samples);
+  all.weights = Vector<t_complex>::Zero(baselines * samples);
+  for (t_uint b = 0; b < baselines; b++)
+    for (t_uint i = 0; i < samples; i++) {
+      const t_uint k = b * samples + i;
+      const t_real radius = (50.05 + 150 * b) * du;
+      all.u(k) = radius * std::cos(1e-4 * (b + 1) * i);
+      all.v(k) = radius * std::sin(1e-4 * (b + 1) * i);
+      all.time(k) = i;
+      all.baseline(k) = b;
+      all.vis(k) = t_complex(std::cos(k), std::sin(3. * k));
+      all.weights(k) = 1 + (k % 3);
+    }
+  std::vector<t_int> local;
+  for (t_int k = world.rank(); k < all.size(); k += world.size()) local.push_back(k);
+  utilities::vis_params params = all;
+  params.u = Vector<t_real>(local.size());
+  params.v = Vector<t_real>(local.size());
+  params.w = Vector<t_real>(local.size());
+  params.time = Vector<t_real>(local.size());
+  params.baseline = Vector<t_uint>(local.size());
+  params.vis = Vector<t_complex>(local.size());
+  params.weights = Vector<t_complex>(local.size());
+  for (t_int i = 0; i < local.size(); i++) {
+    params.u(i) = all.u(local[i]);
+    params.v(i) = all.v(local[i]);
+    params.w(i) = all.w(local[i]);
+    params.time(i) = all.time(local[i]);
+    params.baseline(i) = all.baseline(local[i]);
+    params.vis(i) = all.vis(local[i]);
+    params.weights(i) = all.weights(local[i]);
+  }
+
+  const auto serial = utilities::baseline_dependent_averaging(all, cell, cell, imsize, imsize);
+  const auto averaged = utilities::baseline_dependent_averaging(
+      params, world, cell, cell, imsize, imsize, distribute::plan::radial);
+  CHECK(world.all_sum_all<t_int>(averaged.size()) == serial.size());
+  CHECK(std::abs(world.all_sum_all(averaged.vis.sum()) - serial.vis.sum()) < 1e-8);
+  CHECK(std::abs(world.all_sum_all(averaged.u.sum()) - serial.u.sum()) <
+        1e-8 * serial.u.cwiseAbs().sum());
+  CHECK(std::abs(world.all_sum_all(averaged.weights.sum()) - serial.weights.sum()) < 1e-8);
+  // the averaged visibilities follow the plan, which balances them, and not the baselines
+  const t_int size = averaged.size();
+  CHECK(world.all_reduce<t_int>(size, MPI_MAX) - world.all_reduce<t_int>(size, MPI_MIN) <= 1);
+}
+
+TEST_CASE("Random updates without communication") {
+  auto const world = sopt::mpi::Communicator::World();
+  const t_int update_size = std::max<t_int>(world.size() / 2, 1);
+  SECTION("Selection") {
+    const auto selection = random_updater::random_selection(42, 7, 10, 4);
+    CHECK(selection == random_updater::random_selection(42, 7, 10, 4));
+    CHECK(selection.size() == 4);
+    auto sorted = selection;
+    std::sort(sorted.begin(), sorted.end());
+    CHECK(std::unique(sorted.begin(), sorted.end()) == sorted.end());
+    CHECK(sorted.front() >= 0);
+    CHECK(sorted.back() < 10);
+    CHECK_THROWS(random_updater::random_selection(42, 7, 3, 4));
+    // only the selected entries are drawn, so a large total is cheap
+    const auto large = random_updater::random_selection(42, 7, 1 << 30, 4);
+    CHECK(large.size() == 4);
+    CHECK(*std::min_element(large.begin(), large.end()) >= 0);
+  }
+  SECTION("Same processes update on every node") {
+    auto const update = std::make_shared<bool>(false);
+    auto const updater =
+        random_updater::random_updater(world, world.size(), update_size, update, "test");
+    Vector<t_int> selected = Vector<t_int>::Zero(world.size());
+    for (t_int i = 0; i < 50; i++) {
+      const bool updating = updater();
+      CHECK(updating == *update);
+      CHECK(world.all_sum_all<t_int>(updating) == update_size);
+      if (updating) selected(world.rank())++;
+    }
+    // every process is selected at some point
+    selected = world.all_sum_all<Vector<t_int>>(selected);
+    if (world.size() > 1) CHECK(selected.minCoeff() > 0);
+  }
+  SECTION("Fixed seed") {
+    // zero is a seed like any other
+    for (const std::uint64_t seed : {0, 42}) {
+      auto const update = std::make_shared<bool>(false);
+      auto const updater =
+          random_updater::random_updater(world, world.size(), update_size, update, "test", seed);
+      for (t_int i = 0; i < 10; i++) {
+        const auto expected =
+            random_updater::random_selection(seed, i, world.size(), update_size);
+        CHECK(updater() == (std::find(expected.begin(), expected.end(),
+                                      static_cast<t_int>(world.rank())) != expected.end()));
+      }
+    }
+  }
+}
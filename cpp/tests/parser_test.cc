@@ -73,6 +73,7 @@ TEST_CASE("Yaml parser and setting variables test") {
                                                   "DB5",   "DB6", "DB7", "DB8"};
     REQUIRE(yaml_parser.wavelet_basis() == expected_wavelets);
     REQUIRE(yaml_parser.wavelet_levels() == 4);
+    REQUIRE(yaml_parser.openmp_wavelets() == false);
     REQUIRE(yaml_parser.algorithm() == "primaldual");
   }
   SECTION("Check the AlgorithmOptions node variables") {
@@ -3,9 +3,13 @@
 #include "catch.hpp"
 #include "purify/logging.h"
 
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include "purify/binary_visibilities.h"
 #include "purify/directories.h"
 #include "purify/read_measurements.h"
+#include "purify/uvfits.h"
 
 using namespace purify;
 using namespace purify::notinstalled;
@@ -38,6 +42,11 @@ TEST_CASE("uvfits") {
       const auto uvfits = read_measurements::read_measurements(
           std::vector<std::string>{filename + ".uvfits", filename + ".uvfits"});
       CHECK(uvfits.size() == 245886 * 2);
+      const auto single = read_measurements::read_measurements(filename + ".uvfits");
+      CHECK(uvfits.u.tail(single.size()) == single.u);
+      CHECK(uvfits.vis.head(single.size()) == single.vis);
+      CHECK(uvfits.time.size() == uvfits.size());
+      CHECK(uvfits.baseline.size() == uvfits.size());
     }
     SECTION("vis") {
       const auto vis = read_measurements::read_measurements(
@@ -74,3 +83,121 @@ TEST_CASE("uvfits") {
     }
   }
 }
+
+TEST_CASE("binary") {
+  const std::string filename = atca_filename("0332-391");
+  const auto uvfits = read_measurements::read_measurements(filename + ".uvfits");
+  const std::string binary = output_filename("0332-391.bvis");
+  utilities::write_binary_visibility(uvfits, binary);
+  CHECK(utilities::binary_visibility_size(binary) == uvfits.size());
+  SECTION("one") {
+    const auto measurements = read_measurements::read_measurements(binary, true);
+    REQUIRE(measurements.size() == uvfits.size());
+    CHECK(measurements.u == uvfits.u);
+    CHECK(measurements.v == uvfits.v);
+    CHECK(measurements.w == uvfits.w);
+    CHECK(measurements.vis == uvfits.vis);
+    CHECK(measurements.weights == uvfits.weights);
+    CHECK(measurements.time == uvfits.time);
+    CHECK(measurements.baseline == uvfits.baseline);
+    CHECK(measurements.frequencies == uvfits.frequencies);
+    CHECK(measurements.units == uvfits.units);
+    CHECK(measurements.ra == uvfits.ra);
+    CHECK(measurements.dec == uvfits.dec);
+  }
+  SECTION("segment") {
+    const auto measurements = utilities::read_binary_visibility(binary, 1000, 500);
+    REQUIRE(measurements.size() == 500);
+    CHECK(measurements.u == uvfits.u.segment(1000, 500));
+    CHECK(measurements.vis == uvfits.vis.segment(1000, 500));
+    CHECK_THROWS(utilities::read_binary_visibility(binary, uvfits.size() - 1, 2));
+  }
+  SECTION("two") {
+    const auto measurements =
+        read_measurements::read_measurements(std::vector<std::string>{binary, binary});
+    REQUIRE(measurements.size() == 2 * uvfits.size());
+    CHECK(measurements.weights.tail(uvfits.size()) == uvfits.weights);
+  }
+  SECTION("not binary") {
+    CHECK_THROWS(utilities::read_binary_visibility(filename + ".uvfits"));
+  }
+  SECTION("w term") {
+    // w is only kept when the w term is asked for, as for .vis files
+    const auto measurements = read_measurements::read_measurements(binary);
+    CHECK(measurements.w.isZero(0));
+    CHECK(measurements.u == uvfits.u);
+  }
+  SECTION("units") {
+    // the units of the header are kept, whatever units are asked for
+    auto radians = uvfits;
+    radians.units = utilities::vis_units::radians;
+    utilities::write_binary_visibility(radians, binary);
+    const auto measurements =
+        read_measurements::read_measurements(binary, true, stokes::I, utilities::vis_units::lambda);
+    CHECK(measurements.units == utilities::vis_units::radians);
+  }
+  SECTION("columns of different lengths") {
+    auto broken = uvfits;
+    broken.weights = Vector<t_complex>::Ones(uvfits.size() - 1);
+    CHECK_THROWS(utilities::write_binary_visibility(broken, output_filename("broken.bvis")));
+    broken = uvfits;
+    broken.time = Vector<t_real>::Zero(1);
+    CHECK_THROWS(utilities::write_binary_visibility(broken, output_filename("broken.bvis")));
+  }
+  SECTION("different pointing or frequency") {
+    const std::string other = output_filename("0332-391_other.bvis");
+    auto moved = uvfits;
+    moved.ra += 1e-3;
+    utilities::write_binary_visibility(moved, other);
+    CHECK_THROWS(utilities::read_binary_visibility(std::vector<std::string>{binary, other}));
+    moved = uvfits;
+    moved.average_frequency *= 2;
+    utilities::write_binary_visibility(moved, other);
+    CHECK_THROWS(utilities::read_binary_visibility(std::vector<std::string>{binary, other}));
+  }
+  SECTION("corrupt header") {
+    const std::string corrupt = output_filename("0332-391_corrupt.bvis");
+    const auto write_header_field = [&corrupt](const std::streamoff offset,
+                                               const std::int32_t value) {
+      std::fstream file(corrupt, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(offset);
+      file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    // the version follows the 8 bytes of the magic string, and the units are at byte 20
+    utilities::write_binary_visibility(uvfits, corrupt);
+    write_header_field(8, 2);
+    CHECK_THROWS(utilities::binary_visibility_size(corrupt));
+    CHECK_THROWS(utilities::read_binary_visibility(corrupt));
+    utilities::write_binary_visibility(uvfits, corrupt);
+    write_header_field(20, 7);
+    CHECK_THROWS(utilities::binary_visibility_size(corrupt));
+    CHECK_THROWS(utilities::read_binary_visibility(corrupt, 0, 10));
+  }
+}
+
+TEST_CASE("uvfits streaming") {
+  const std::string filename = atca_filename("0332-391");
+  const auto uvfits = pfitsio::read_uvfits(filename + ".uvfits");
+  CHECK(uvfits.size() == 245886);
+  // buffers of a few groups, so that many blocks are read in the background
+  const auto blocks = pfitsio::read_uvfits(filename + ".uvfits", true, stokes::I, 0, -1, 10000);
+  REQUIRE(blocks.size() == uvfits.size());
+  CHECK(blocks.u == uvfits.u);
+  CHECK(blocks.v == uvfits.v);
+  CHECK(blocks.w == uvfits.w);
+  CHECK(blocks.vis == uvfits.vis);
+  CHECK(blocks.weights == uvfits.weights);
+  CHECK(blocks.time == uvfits.time);
+  CHECK(blocks.baseline == uvfits.baseline);
+  CHECK(blocks.frequencies == uvfits.frequencies);
+  const auto groups = pfitsio::read_uvfits_groups(filename + ".uvfits");
+  const auto first =
+      pfitsio::read_uvfits(filename + ".uvfits", true, stokes::I, 0, groups / 2, 10000);
+  const auto second = pfitsio::read_uvfits(filename + ".uvfits", true, stokes::I, groups / 2, -1);
+  REQUIRE(first.size() + second.size() == uvfits.size());
+  // each range is ordered by channel on its own
+  CHECK(std::abs(first.vis.sum() + second.vis.sum() - uvfits.vis.sum()) <
+        1e-8 * std::abs(uvfits.vis.sum()));
+  CHECK(std::abs(first.u.sum() + second.u.sum() - uvfits.u.sum()) <
+        1e-8 * std::abs(uvfits.u.sum()));
+}
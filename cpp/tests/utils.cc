@@ -1,8 +1,11 @@
+#include <cmath>
+#include <fstream>
 #include <random>
 #include "catch.hpp"
 #include "purify/directories.h"
 #include "purify/utilities.h"
 #include "purify/uvw_utilities.h"
+#include "purify/wide_field_utilities.h"
 
 using namespace purify;
 using namespace purify::notinstalled;
@@ -108,6 +111,49 @@ TEST_CASE("utilities [read_write_vis]", "[read_write_vis]") {
   CHECK(new_random_uv_data.vis.isApprox(random_uv_data.vis, 1e-8));
   CHECK(new_random_uv_data.weights.isApprox(random_uv_data.weights, 1e-8));
 }
+TEST_CASE("read_vis_text") {
+  const std::string vis_file = output_filename("test_text.vis");
+  SECTION("special values and blank lines") {
+    {
+      std::ofstream out(vis_file);
+      out << "1 2 3 4 0.5\n\n-1.5e3 nan inf -inf 2\n  3 4 5 6 1";
+    }
+    const auto uv_data = utilities::read_visibility(vis_file);
+    REQUIRE(uv_data.size() == 3);
+    CHECK(uv_data.u(1) == Approx(-1500));
+    CHECK(std::isnan(uv_data.v(1)));
+    CHECK(std::isinf(uv_data.vis(1).real()));
+    CHECK(uv_data.vis(1).imag() < 0);
+    CHECK(uv_data.v(2) == Approx(-4));
+    CHECK(uv_data.weights(0).real() == Approx(2));
+    CHECK(uv_data.vis(2) == t_complex(5, 6));
+  }
+  SECTION("missing value") {
+    {
+      std::ofstream out(vis_file);
+      out << "1 2 3 4\n5 6 7 8 9\n";
+    }
+    CHECK_THROWS(utilities::read_visibility(vis_file));
+  }
+  SECTION("byte ranges") {
+    {
+      std::ofstream out(vis_file);
+      out << "1 2 3 4 0.5\n\n5 6 7 8 1\n9 10 11 12 2\n13 14 15 16 3\n";
+    }
+    const auto whole = utilities::read_visibility(vis_file);
+    for (std::uint64_t step : {1, 4, 11, 20, 100}) {
+      CAPTURE(step);
+      std::vector<t_real> u;
+      for (std::uint64_t first = 0; first < 100; first += step) {
+        const auto part = utilities::read_visibility(vis_file, false, first, step);
+        for (t_int i = 0; i < part.size(); i++) u.push_back(part.u(i));
+      }
+      REQUIRE(u.size() == whole.size());
+      for (t_int i = 0; i < whole.size(); i++) CHECK(u.at(i) == Approx(whole.u(i)));
+    }
+    CHECK(utilities::read_visibility(vis_file, false, 3, 0).size() == 0);
+  }
+}
 TEST_CASE("read_mutiple_vis") {
   std::string vis_file = vla_filename("at166B.3C129.c0.vis");
   SECTION("one file") {
@@ -414,3 +460,174 @@ TEST_CASE("conjugate symmetry") {
     }
   }
 }
+
+TEST_CASE("fold hermitian") {
+  t_uint const number_of_vis = 100;
+  auto uv_data = utilities::random_sample_density(2 * number_of_vis, 0, 1000, 100);
+  // half of the measurements have no w term, and each is measured again at the conjugate position
+  uv_data.w.tail(number_of_vis).setZero();
+  uv_data.vis = Vector<t_complex>::Random(2 * number_of_vis);
+  utilities::vis_params repeated_data = uv_data;
+  repeated_data.u = (Vector<t_real>(4 * number_of_vis) << uv_data.u, -uv_data.u).finished();
+  repeated_data.v = (Vector<t_real>(4 * number_of_vis) << uv_data.v, -uv_data.v).finished();
+  repeated_data.w = (Vector<t_real>(4 * number_of_vis) << uv_data.w, -uv_data.w).finished();
+  repeated_data.vis =
+      (Vector<t_complex>(4 * number_of_vis) << uv_data.vis, uv_data.vis.conjugate()).finished();
+  repeated_data.weights = Vector<t_complex>::Ones(4 * number_of_vis);
+  SECTION("half plane") {
+    const auto folded = utilities::fold_hermitian(repeated_data);
+    REQUIRE(folded.size() == 2 * number_of_vis);
+    CHECK(folded.v.minCoeff() >= 0);
+  }
+  SECTION("positive w") {
+    const auto folded = utilities::fold_hermitian(repeated_data, true);
+    REQUIRE(folded.size() == 2 * number_of_vis);
+    CHECK(folded.w.minCoeff() >= 0);
+    for (t_uint i = 0; i < folded.size(); i++) {
+      if (folded.w(i) == 0) CHECK(folded.v(i) >= 0);
+      CHECK(folded.weights(i).real() == Approx(std::sqrt(2.)));
+    }
+  }
+}
+
+TEST_CASE("merge duplicates") {
+  t_uint const number_of_vis = 100;
+  t_uint const repeats = 3;
+  const auto uv_data = utilities::random_sample_density(number_of_vis, 0, 1000, 100);
+  utilities::vis_params repeated_data;
+  repeated_data.u = uv_data.u.replicate(repeats, 1);
+  repeated_data.v = uv_data.v.replicate(repeats, 1);
+  repeated_data.w = uv_data.w.replicate(repeats, 1);
+  repeated_data.vis = Vector<t_complex>::Random(number_of_vis * repeats);
+  repeated_data.weights = Vector<t_complex>::Ones(number_of_vis * repeats);
+  SECTION("exact") {
+    const auto merged_data = utilities::merge_duplicates(repeated_data);
+    REQUIRE(merged_data.size() == number_of_vis);
+    CHECK(merged_data.weights.isApprox(
+        Vector<t_complex>::Constant(number_of_vis, std::sqrt(static_cast<t_real>(repeats)))));
+    for (t_uint i = 0; i < merged_data.size(); i++) {
+      t_complex expected = 0;
+      t_uint matches = 0;
+      for (t_uint j = 0; j < repeated_data.size(); j++)
+        if (repeated_data.u(j) == merged_data.u(i) and repeated_data.v(j) == merged_data.v(i) and
+            repeated_data.w(j) == merged_data.w(i)) {
+          expected += repeated_data.vis(j);
+          matches++;
+        }
+      REQUIRE(matches == repeats);
+      CHECK(std::abs(merged_data.vis(i) - expected / static_cast<t_real>(repeats)) < 1e-12);
+    }
+  }
+  SECTION("tolerance") {
+    repeated_data.u.tail(number_of_vis) += Vector<t_real>::Constant(number_of_vis, 1e-9);
+    CHECK(utilities::merge_duplicates(repeated_data).size() == 2 * number_of_vis);
+    const auto merged_data = utilities::merge_duplicates(repeated_data, 1e-3);
+    REQUIRE(merged_data.size() == number_of_vis);
+    CHECK(merged_data.weights.isApprox(
+        Vector<t_complex>::Constant(number_of_vis, std::sqrt(static_cast<t_real>(repeats)))));
+    for (t_uint i = 0; i < merged_data.size(); i++) {
+      t_complex expected = 0;
+      t_uint matches = 0;
+      for (t_uint j = 0; j < repeated_data.size(); j++)
+        if (std::abs(repeated_data.u(j) - merged_data.u(i)) < 1e-6 and
+            std::abs(repeated_data.v(j) - merged_data.v(i)) < 1e-9 and
+            std::abs(repeated_data.w(j) - merged_data.w(i)) < 1e-9) {
+          expected += repeated_data.vis(j);
+          matches++;
+        }
+      REQUIRE(matches == repeats);
+      CHECK(std::abs(merged_data.vis(i) - expected / static_cast<t_real>(repeats)) < 1e-12);
+    }
+    CHECK_THROWS(utilities::merge_duplicates(repeated_data, -1));
+  }
+  SECTION("distance") {
+    // the first two are closer than the tolerance but lie either side of a multiple of it, the
+    // third is further than the tolerance from the first
+    utilities::vis_params close_data;
+    close_data.u = Vector<t_real>(3);
+    close_data.u << 0.99e-3, 1.01e-3, 2.1e-3;
+    close_data.v = Vector<t_real>::Zero(3);
+    close_data.w = Vector<t_real>::Zero(3);
+    close_data.vis = Vector<t_complex>(3);
+    close_data.vis << t_complex(1, 0), t_complex(0, 1), t_complex(2, 2);
+    close_data.weights = Vector<t_complex>(3);
+    close_data.weights << 1., 2., 1.;
+    const auto merged_data = utilities::merge_duplicates(close_data, 1e-3);
+    REQUIRE(merged_data.size() == 2);
+    CHECK(merged_data.u(0) == Approx((0.99e-3 + 4 * 1.01e-3) / 5));
+    CHECK(std::abs(merged_data.vis(0) - t_complex(1, 4) / 5.) < 1e-12);
+    CHECK(std::abs(merged_data.weights(0) - std::sqrt(5.)) < 1e-12);
+    CHECK(merged_data.u(1) == Approx(2.1e-3));
+    CHECK(merged_data.vis(1) == t_complex(2, 2));
+  }
+}
+
+TEST_CASE("baseline dependent averaging") {
+  const t_uint samples = 10;
+  const t_real cell = 10;
+  const t_uint imsize = 256;
+  const t_real du = widefield::pixel_to_lambda(cell, imsize, 1.);
+  utilities::vis_params uv_data;
+  uv_data.u = Vector<t_real>::Zero(2 * samples);
+  uv_data.v = Vector<t_real>::Zero(2 * samples);
+  uv_data.w = Vector<t_real>::Zero(2 * samples);
+  uv_data.time = Vector<t_real>::Zero(2 * samples);
+  uv_data.baseline = Vector<t_uint>::Zero(2 * samples);
+  uv_data.vis = Vector<t_complex>::Random(2 * samples);
+  uv_data.weights = Vector<t_complex>::Ones(2 * samples);
+  for (t_uint i = 0; i < samples; i++) {
+    // a short baseline that moves slowly and a long baseline that moves quickly
+    uv_data.u(i) = 50.05 * du * std::cos(1e-4 * i);
+    uv_data.v(i) = 50.05 * du * std::sin(1e-4 * i);
+    uv_data.u(samples + i) = 1000.05 * du * std::cos(1e-3 * i);
+    uv_data.v(samples + i) = 1000.05 * du * std::sin(1e-3 * i);
+    uv_data.time(i) = i;
+    uv_data.time(samples + i) = i;
+    uv_data.baseline(samples + i) = 1;
+  }
+  const auto averaged =
+      utilities::baseline_dependent_averaging(uv_data, cell, cell, imsize, imsize);
+  REQUIRE(averaged.size() == samples + 1);
+  REQUIRE(averaged.time.size() == averaged.size());
+  REQUIRE(averaged.baseline.size() == averaged.size());
+  CHECK(averaged.baseline(0) == 0);
+  CHECK(std::abs(averaged.vis(0) - uv_data.vis.head(samples).mean()) < 1e-12);
+  CHECK(std::abs(averaged.weights(0) - std::sqrt(static_cast<t_real>(samples))) < 1e-12);
+  CHECK(averaged.u(0) == Approx(uv_data.u.head(samples).mean()));
+  CHECK(averaged.vis.tail(samples).isApprox(uv_data.vis.tail(samples)));
+
+  SECTION("coordinates are weighted like the visibilities") {
+    utilities::vis_params weighted = uv_data;
+    weighted.weights.head(samples) =
+        Vector<t_real>::LinSpaced(samples, 1, samples).cast<t_complex>();
+    const Vector<t_real> weight_squared = weighted.weights.head(samples).cwiseAbs2();
+    const t_real total = weight_squared.sum();
+    const auto result =
+        utilities::baseline_dependent_averaging(weighted, cell, cell, imsize, imsize);
+    REQUIRE(result.size() == samples + 1);
+    CHECK(result.u(0) == Approx(weight_squared.dot(weighted.u.head(samples)) / total));
+    CHECK(result.v(0) == Approx(weight_squared.dot(weighted.v.head(samples)) / total));
+    const t_complex vis = weight_squared.cast<t_complex>().dot(weighted.vis.head(samples)) / total;
+    CHECK(std::abs(result.vis(0) - vis) < 1e-12);
+  }
+
+  SECTION("radians are converted to lambda first") {
+    const t_real oversample_ratio = 2;
+    utilities::vis_params radians =
+        utilities::convert_to_pixels(uv_data, cell, cell, imsize, imsize, oversample_ratio);
+    radians.u *= constant::pi / std::floor(imsize * oversample_ratio);
+    radians.v *= constant::pi / std::floor(imsize * oversample_ratio);
+    radians.units = utilities::vis_units::radians;
+    const auto lambda =
+        utilities::convert_to_lambda(radians, cell, cell, imsize, imsize, oversample_ratio);
+    CHECK(lambda.units == utilities::vis_units::lambda);
+    CHECK(lambda.u.isApprox(uv_data.u, 1e-12));
+    CHECK(lambda.v.isApprox(uv_data.v, 1e-12));
+    const auto result = utilities::baseline_dependent_averaging(lambda, cell, cell, imsize, imsize);
+    REQUIRE(result.size() == averaged.size());
+    CHECK(result.u.isApprox(averaged.u, 1e-12));
+  }
+
+  uv_data.units = utilities::vis_units::pixels;
+  CHECK_THROWS(utilities::baseline_dependent_averaging(uv_data, cell, cell, imsize, imsize));
+}
@@ -30,3 +30,26 @@ TEST_CASE("Wavelet Factory Operator") {
     REQUIRE((op->adjoint() * input).isApprox(factory_op->adjoint() * input));
   }
 }
+
+TEST_CASE("OpenMP Wavelet Factory Operator") {
+  const std::vector<std::tuple<std::string, t_uint>> wavelets{
+      std::make_tuple("Dirac", 3u), std::make_tuple("DB1", 3u), std::make_tuple("DB2", 3u),
+      std::make_tuple("DB3", 3u),   std::make_tuple("DB4", 3u), std::make_tuple("DB5", 3u),
+      std::make_tuple("DB6", 3u),   std::make_tuple("DB7", 3u), std::make_tuple("DB8", 3u)};
+  auto const imsizey = 128;
+  auto const imsizex = 64;
+  t_uint sara_size = 0;
+  auto const serial_op = factory::wavelet_operator_factory<Vector<t_complex>>(
+      factory::distributed_wavelet_operator::serial, wavelets, imsizey, imsizex);
+  auto const openmp_op = factory::wavelet_operator_factory<Vector<t_complex>>(
+      factory::distributed_wavelet_operator::openmp_sara, wavelets, imsizey, imsizex, sara_size);
+  CHECK(sara_size == wavelets.size());
+  SECTION("forward") {
+    const Vector<t_complex> input = Vector<t_complex>::Random(wavelets.size() * imsizex * imsizey);
+    CHECK((*serial_op * input).isApprox(*openmp_op * input));
+  }
+  SECTION("backward") {
+    const Vector<t_complex> input = Vector<t_complex>::Random(imsizex * imsizey);
+    CHECK((serial_op->adjoint() * input).isApprox(openmp_op->adjoint() * input));
+  }
+}